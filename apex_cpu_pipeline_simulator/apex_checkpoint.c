@@ -0,0 +1,534 @@
+/*
+ * apex_checkpoint.c
+ * Saves the complete state of an APEX cpu to a file and restores it, so a
+ * long warm up can be simulated once and resumed for every design point
+ *
+ * Checkpoint layout (native byte order, all integers as in memory):
+ *   header      magic, version, sizes of the saved records, fingerprint of
+ *               the code memory and the structure sizes of the config
+ *   cpu         pc, clock, counters, flags, mri, stats
+ *   latches     every CPU_Stage latch of the pipeline, the fetch buffer and
+ *               the latches of the functional units
+ *   registers   prf (including CCR), arf, rnt, free physical list, branch
+ *               rename checkpoints
+ *   queues      iq, lsq and rob entries with their head/tail pointers
+ *   predictor   btb, direction predictor tables and global history, store
+ *               set identifier table, stride prefetcher table
+ *   caches      lines and replacement state of every cache level in use
+ *   dram        banks, data buses and the request queue of the controller
+ *   tlbs        DTLB and L2 TLB entries as cache lines, the page walks
+ *   memory      data memory as runs of non zero words, ended by an empty run
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+
+#define APEX_CHECKPOINT_MAGIC 0x54504B4358455041ULL /* "APEXCKPT" */
+
+/* Bump whenever anything written below changes */
+#define APEX_CHECKPOINT_VERSION 19
+
+typedef struct checkpoint_header
+{
+    unsigned long long magic;
+    int version;
+    int stage_size;
+    int rob_entry_size;
+    int iq_entry_size;
+    int lsq_entry_size;
+    int prf_entry_size;
+    unsigned int code_fingerprint;
+    int code_memory_size;
+    int rob_size;
+    int issue_queue_size;
+    int lsq_size;
+    int physical_registers_size;
+    int branch_checkpoints;
+    int branch_predictor;
+    int btb_size;
+    int predictor_table_size;
+    int history_length;
+    int ras_size;
+    int ssit_size;
+    int cache_size[NUM_CACHE_LEVELS];
+    int cache_assoc[NUM_CACHE_LEVELS];
+    int cache_line_size[NUM_CACHE_LEVELS];
+    int fetch_buffer_size;
+    int prefetch_table_size;
+    int dram_channels;
+    int dram_banks;
+    int dtlb_entries;
+    int dtlb_assoc;
+    int l2_tlb_entries;
+    int l2_tlb_assoc;
+    int page_size;
+    int page_walkers;
+    int fu_units[NUM_FU_CLASSES];
+    int fu_stages[NUM_FU_CLASSES];  /* Stages of each unit of a class */
+    int data_memory_size;
+} checkpoint_header;
+
+/* A pipeline latch of APEX_CPU, the front end groups span several CPU_Stage */
+typedef struct checkpoint_latch
+{
+    size_t offset;
+    size_t size;
+} checkpoint_latch;
+
+#define CHECKPOINT_LATCH(member) \
+    { offsetof(APEX_CPU, member), sizeof(((APEX_CPU *)0)->member) }
+
+/* Every pipeline latch in APEX_CPU, in the order they are saved */
+static const checkpoint_latch checkpoint_latches[] = {
+    CHECKPOINT_LATCH(fetch),
+    CHECKPOINT_LATCH(decode_rename),
+    CHECKPOINT_LATCH(rename_dispatch),
+    CHECKPOINT_LATCH(queue_entry),
+    CHECKPOINT_LATCH(process_iq),
+    CHECKPOINT_LATCH(rob_commit_writeback),
+    CHECKPOINT_LATCH(rob_commit),
+    CHECKPOINT_LATCH(writeback),
+};
+
+#define NUM_CHECKPOINT_LATCHES (int)(sizeof(checkpoint_latches) / sizeof(checkpoint_latches[0]))
+
+/* Reads or writes one checkpoint file, the first I/O error sticks */
+typedef struct checkpoint_stream
+{
+    FILE *fp;
+    int saving;
+    int error;
+} checkpoint_stream;
+
+static void
+ckpt_write(checkpoint_stream *s, const void *ptr, size_t size)
+{
+    if (!s->error && size && fwrite(ptr, size, 1, s->fp) != 1)
+    {
+        s->error = TRUE;
+    }
+}
+
+static void
+ckpt_read(checkpoint_stream *s, void *ptr, size_t size)
+{
+    if (!s->error && size && fread(ptr, size, 1, s->fp) != 1)
+    {
+        s->error = TRUE;
+    }
+}
+
+/* Writes or reads ptr depending on the direction of the stream */
+static void
+ckpt_io(checkpoint_stream *s, void *ptr, size_t size)
+{
+    if (s->saving)
+    {
+        ckpt_write(s, ptr, size);
+    }
+    else
+    {
+        ckpt_read(s, ptr, size);
+    }
+}
+
+/* FNV-1a over the decoded program, so a checkpoint is only resumed on the
+ * program it was taken from */
+static unsigned int
+code_fingerprint(const APEX_Instruction *code_memory, int code_memory_size)
+{
+    unsigned int hash = 2166136261u;
+    int fields[5];
+    int i, j;
+
+    for (i = 0; i < code_memory_size; ++i)
+    {
+        fields[0] = code_memory[i].opcode;
+        fields[1] = code_memory[i].rd;
+        fields[2] = code_memory[i].rs1;
+        fields[3] = code_memory[i].rs2;
+        fields[4] = code_memory[i].imm;
+        for (j = 0; j < (int)sizeof(fields); ++j)
+        {
+            hash = (hash ^ ((const unsigned char *)fields)[j]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void
+fill_header(checkpoint_header *header, const APEX_Instruction *code_memory,
+            int code_memory_size, const APEX_Config *config)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = APEX_CHECKPOINT_MAGIC;
+    header->version = APEX_CHECKPOINT_VERSION;
+    header->stage_size = sizeof(CPU_Stage);
+    header->rob_entry_size = sizeof(reorder_buffer_entry);
+    header->iq_entry_size = sizeof(issue_queue_entry);
+    header->lsq_entry_size = sizeof(load_store_queue_entry);
+    header->prf_entry_size = sizeof(physical_register_content);
+    header->code_fingerprint = code_fingerprint(code_memory, code_memory_size);
+    header->code_memory_size = code_memory_size;
+    header->rob_size = config->rob_size;
+    header->issue_queue_size = config->issue_queue_size;
+    header->lsq_size = config->lsq_size;
+    header->physical_registers_size = config->physical_registers_size;
+    header->branch_checkpoints = config->branch_checkpoints;
+    header->branch_predictor = config->branch_predictor;
+    header->btb_size = config->btb_size;
+    header->predictor_table_size = config->predictor_table_size;
+    header->history_length = config->history_length;
+    header->ras_size = config->ras_size;
+    header->ssit_size = config->ssit_size;
+    header->cache_size[CACHE_L1D] = config->l1d_size;
+    header->cache_assoc[CACHE_L1D] = config->l1d_assoc;
+    header->cache_line_size[CACHE_L1D] = config->l1d_line_size;
+    header->cache_size[CACHE_L2] = config->l2_size;
+    header->cache_assoc[CACHE_L2] = config->l2_assoc;
+    header->cache_line_size[CACHE_L2] = config->l2_line_size;
+    header->cache_size[CACHE_L1I] = config->l1i_size;
+    header->cache_assoc[CACHE_L1I] = config->l1i_assoc;
+    header->cache_line_size[CACHE_L1I] = config->l1i_line_size;
+    header->fetch_buffer_size = config->fetch_buffer_size;
+    header->prefetch_table_size = config->prefetch_table_size;
+    header->dram_channels = config->dram_channels;
+    header->dram_banks = config->dram_banks;
+    header->dtlb_entries = config->dtlb_entries;
+    header->dtlb_assoc = config->dtlb_assoc;
+    header->l2_tlb_entries = config->l2_tlb_entries;
+    header->l2_tlb_assoc = config->l2_tlb_assoc;
+    header->page_size = config->page_size;
+    header->page_walkers = config->page_walkers;
+    header->fu_units[INT_FU] = config->int_units;
+    header->fu_units[MUL_FU] = config->mul_units;
+    header->fu_units[BRANCH_FU] = config->branch_units;
+    header->fu_units[MEM_FU] = config->mem_units;
+    header->fu_stages[INT_FU] = config->int_pipelined ? config->int_latency : 1;
+    header->fu_stages[MUL_FU] = config->mul_pipelined ? config->mul_latency : 1;
+    header->fu_stages[BRANCH_FU] = config->branch_pipelined ? config->branch_latency : 1;
+    header->fu_stages[MEM_FU] = config->memory_mshrs;
+    header->data_memory_size = config->data_memory_size;
+}
+
+/* Reports why a checkpoint cannot be resumed by this cpu, NULL if it can */
+static const char *
+header_mismatch(const checkpoint_header *saved, const checkpoint_header *expected)
+{
+    if (saved->magic != expected->magic)
+    {
+        return "not an APEX checkpoint";
+    }
+    if (saved->version != expected->version || saved->stage_size != expected->stage_size ||
+        saved->rob_entry_size != expected->rob_entry_size ||
+        saved->iq_entry_size != expected->iq_entry_size ||
+        saved->lsq_entry_size != expected->lsq_entry_size ||
+        saved->prf_entry_size != expected->prf_entry_size)
+    {
+        return "written by a different simulator version";
+    }
+    if (saved->code_fingerprint != expected->code_fingerprint ||
+        saved->code_memory_size != expected->code_memory_size)
+    {
+        return "taken from a different program";
+    }
+    if (saved->rob_size != expected->rob_size ||
+        saved->issue_queue_size != expected->issue_queue_size ||
+        saved->lsq_size != expected->lsq_size ||
+        saved->physical_registers_size != expected->physical_registers_size ||
+        saved->branch_checkpoints != expected->branch_checkpoints ||
+        saved->branch_predictor != expected->branch_predictor ||
+        saved->btb_size != expected->btb_size ||
+        saved->predictor_table_size != expected->predictor_table_size ||
+        saved->history_length != expected->history_length ||
+        saved->ras_size != expected->ras_size ||
+        saved->ssit_size != expected->ssit_size ||
+        memcmp(saved->cache_size, expected->cache_size, sizeof(saved->cache_size)) ||
+        memcmp(saved->cache_assoc, expected->cache_assoc, sizeof(saved->cache_assoc)) ||
+        memcmp(saved->cache_line_size, expected->cache_line_size, sizeof(saved->cache_line_size)) ||
+        saved->fetch_buffer_size != expected->fetch_buffer_size ||
+        saved->prefetch_table_size != expected->prefetch_table_size ||
+        saved->dram_channels != expected->dram_channels ||
+        saved->dram_banks != expected->dram_banks ||
+        saved->dtlb_entries != expected->dtlb_entries ||
+        saved->dtlb_assoc != expected->dtlb_assoc ||
+        saved->l2_tlb_entries != expected->l2_tlb_entries ||
+        saved->l2_tlb_assoc != expected->l2_tlb_assoc ||
+        saved->page_size != expected->page_size ||
+        saved->page_walkers != expected->page_walkers ||
+        memcmp(saved->fu_units, expected->fu_units, sizeof(saved->fu_units)) ||
+        memcmp(saved->fu_stages, expected->fu_stages, sizeof(saved->fu_stages)) ||
+        saved->data_memory_size != expected->data_memory_size)
+    {
+        return "taken with different structure sizes";
+    }
+    return NULL;
+}
+
+/* Lines and replacement state of a cache, or of a TLB */
+static void
+transfer_cache(checkpoint_stream *s, cache *c)
+{
+    ckpt_io(s, c->lines, (size_t)c->num_sets * c->assoc * sizeof(cache_line));
+    ckpt_io(s, c->plru, c->num_sets * sizeof(unsigned long long));
+    ckpt_io(s, &c->seed, sizeof(c->seed));
+    ckpt_io(s, &c->accesses, sizeof(c->accesses));
+}
+
+/* Everything after the header, the same walk serves save and load */
+static void
+transfer_state(checkpoint_stream *s, APEX_CPU *cpu)
+{
+    int i;
+
+    ckpt_io(s, &cpu->pc, sizeof(cpu->pc));
+    ckpt_io(s, &cpu->clock, sizeof(cpu->clock));
+    ckpt_io(s, &cpu->insn_completed, sizeof(cpu->insn_completed));
+    ckpt_io(s, &cpu->status, sizeof(cpu->status));
+    ckpt_io(s, &cpu->zero_flag, sizeof(cpu->zero_flag));
+    ckpt_io(s, &cpu->positive_flag, sizeof(cpu->positive_flag));
+    ckpt_io(s, &cpu->fetch_from_next_cycle, sizeof(cpu->fetch_from_next_cycle));
+    ckpt_io(s, cpu->mri, sizeof(cpu->mri));
+    ckpt_io(s, &cpu->stats, sizeof(cpu->stats));
+
+    for (i = 0; i < NUM_CHECKPOINT_LATCHES; ++i)
+    {
+        ckpt_io(s, (char *)cpu + checkpoint_latches[i].offset, checkpoint_latches[i].size);
+    }
+    ckpt_io(s, cpu->fetch_buffer, cpu->config.fetch_buffer_size * sizeof(CPU_Stage));
+    ckpt_io(s, &cpu->fetch_buffer_head, sizeof(cpu->fetch_buffer_head));
+    ckpt_io(s, &cpu->fetch_buffer_count, sizeof(cpu->fetch_buffer_count));
+    ckpt_io(s, &cpu->fetch_line, sizeof(cpu->fetch_line));
+    ckpt_io(s, &cpu->fetch_line_ready, sizeof(cpu->fetch_line_ready));
+    ckpt_io(s, &cpu->fetch_line_request, sizeof(cpu->fetch_line_request));
+    for (i = 0; i < cpu->fu_pool_size; ++i)
+    {
+        functional_unit *fu = &cpu->fu_pool[i];
+
+        ckpt_io(s, fu->stages, fu->num_stages * sizeof(CPU_Stage));
+        ckpt_io(s, &fu->fwd, sizeof(fu->fwd));
+        ckpt_io(s, &fu->writeback, sizeof(fu->writeback));
+    }
+
+    ckpt_io(s, cpu->prf.physical_register,
+            (cpu->prf.size + 1) * sizeof(physical_register_content));
+    ckpt_io(s, &cpu->arf, sizeof(cpu->arf));
+    ckpt_io(s, &cpu->rnt, sizeof(cpu->rnt));
+    ckpt_io(s, cpu->checkpoints.checkpoints,
+            cpu->checkpoints.size * sizeof(rename_checkpoint));
+
+    ckpt_io(s, &cpu->free_prf_q.head, sizeof(cpu->free_prf_q.head));
+    ckpt_io(s, &cpu->free_prf_q.tail, sizeof(cpu->free_prf_q.tail));
+    ckpt_io(s, &cpu->free_prf_q.is_empty, sizeof(cpu->free_prf_q.is_empty));
+    ckpt_io(s, &cpu->free_prf_q.pops, sizeof(cpu->free_prf_q.pops));
+    ckpt_io(s, cpu->free_prf_q.free_physical_registers, cpu->free_prf_q.size * sizeof(int));
+
+    ckpt_io(s, cpu->iq.issue_queue, cpu->iq.size * sizeof(issue_queue_entry));
+
+    ckpt_io(s, &cpu->lsq.head, sizeof(cpu->lsq.head));
+    ckpt_io(s, &cpu->lsq.tail, sizeof(cpu->lsq.tail));
+    ckpt_io(s, &cpu->lsq.is_full, sizeof(cpu->lsq.is_full));
+    ckpt_io(s, cpu->lsq.load_store_queue, cpu->lsq.size * sizeof(load_store_queue_entry));
+
+    ckpt_io(s, &cpu->rob.head, sizeof(cpu->rob.head));
+    ckpt_io(s, &cpu->rob.tail, sizeof(cpu->rob.tail));
+    ckpt_io(s, &cpu->rob.is_full, sizeof(cpu->rob.is_full));
+    ckpt_io(s, cpu->rob.reorder_buffer_queue, cpu->rob.size * sizeof(reorder_buffer_entry));
+
+    ckpt_io(s, cpu->bp.btb, cpu->bp.btb_size * sizeof(btb_entry));
+    ckpt_io(s, cpu->bp.counters, cpu->bp.table_size);
+    for (i = 0; i < TAGE_TABLES; ++i)
+    {
+        if (cpu->bp.tagged[i])
+        {
+            ckpt_io(s, cpu->bp.tagged[i], cpu->bp.table_size * sizeof(tage_entry));
+        }
+    }
+    ckpt_io(s, &cpu->bp.history, sizeof(cpu->bp.history));
+    ckpt_io(s, cpu->bp.ras, cpu->bp.ras_size * sizeof(int));
+    ckpt_io(s, &cpu->bp.ras_top, sizeof(cpu->bp.ras_top));
+    ckpt_io(s, &cpu->bp.ras_count, sizeof(cpu->bp.ras_count));
+
+    ckpt_io(s, cpu->ssp.ssit, cpu->ssp.ssit_size * sizeof(int));
+    ckpt_io(s, &cpu->ssp.next_set, sizeof(cpu->ssp.next_set));
+    ckpt_io(s, cpu->pf.table, cpu->pf.table_size * sizeof(stride_entry));
+
+    for (i = 0; i < NUM_CACHE_LEVELS; ++i)
+    {
+        transfer_cache(s, &cpu->caches[i]);
+    }
+
+    ckpt_io(s, cpu->dram.bank_state, (size_t)cpu->dram.channels * cpu->dram.banks * sizeof(dram_bank));
+    ckpt_io(s, cpu->dram.bus_ready, cpu->dram.channels * sizeof(int));
+    ckpt_io(s, &cpu->dram.next_id, sizeof(cpu->dram.next_id));
+    ckpt_io(s, &cpu->dram.count, sizeof(cpu->dram.count));
+    if (!s->saving && !s->error && (cpu->dram.count < 0 || dram_reserve(&cpu->dram, cpu->dram.count)))
+    {
+        s->error = TRUE;
+        return;
+    }
+    ckpt_io(s, cpu->dram.queue, cpu->dram.count * sizeof(dram_request));
+
+    transfer_cache(s, &cpu->mmu.dtlb);
+    transfer_cache(s, &cpu->mmu.l2_tlb);
+    ckpt_io(s, cpu->mmu.walks, cpu->mmu.num_walkers * sizeof(page_walk));
+}
+
+/* Data memory is mostly zero, so only runs of non zero words are stored as
+ * (start, length, words), an empty run ends the list */
+static void
+save_data_memory(checkpoint_stream *s, const APEX_CPU *cpu)
+{
+    int start = 0, length;
+
+    while (start < cpu->data_memory_size)
+    {
+        if (!cpu->data_memory[start])
+        {
+            start++;
+            continue;
+        }
+        for (length = 0; start + length < cpu->data_memory_size &&
+                         cpu->data_memory[start + length]; ++length);
+
+        ckpt_write(s, &start, sizeof(start));
+        ckpt_write(s, &length, sizeof(length));
+        ckpt_write(s, &cpu->data_memory[start], length * sizeof(int));
+        start += length;
+    }
+    start = length = 0;
+    ckpt_write(s, &start, sizeof(start));
+    ckpt_write(s, &length, sizeof(length));
+}
+
+static void
+load_data_memory(checkpoint_stream *s, APEX_CPU *cpu)
+{
+    int start, length;
+
+    while (!s->error)
+    {
+        ckpt_read(s, &start, sizeof(start));
+        ckpt_read(s, &length, sizeof(length));
+        if (s->error || length == 0)
+        {
+            break;
+        }
+        if (start < 0 || length < 0 || length > cpu->data_memory_size - start)
+        {
+            s->error = TRUE;
+            break;
+        }
+        ckpt_read(s, &cpu->data_memory[start], length * sizeof(int));
+    }
+}
+
+/*
+ * Writes the complete simulation state of cpu to filename
+ *
+ * Returns 0 on success, -1 with a message on stderr otherwise. Trace output,
+ * verbosity and the step hook are settings of the host, not state, and are
+ * not saved.
+ */
+int
+APEX_cpu_save(const APEX_CPU *cpu, const char *filename)
+{
+    checkpoint_header header;
+    checkpoint_stream s;
+
+    s.fp = fopen(filename, "wb");
+    s.saving = TRUE;
+    s.error = FALSE;
+    if (!s.fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create checkpoint %s\n", filename);
+        return -1;
+    }
+
+    fill_header(&header, cpu->code_memory, cpu->code_memory_size, &cpu->config);
+    ckpt_write(&s, &header, sizeof(header));
+    transfer_state(&s, (APEX_CPU *)cpu);
+    save_data_memory(&s, cpu);
+
+    if (fclose(s.fp) || s.error)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write checkpoint %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Creates a cpu as APEX_cpu_create does and resumes it from a checkpoint
+ *
+ * The program and the structure sizes in config must match the ones the
+ * checkpoint was taken with, other parameters (memory_latency, max_cycles)
+ * may differ. A cpu stopped by the cycle limit or the step hook continues
+ * running. Returns NULL with a message on stderr on failure.
+ */
+APEX_CPU *
+APEX_cpu_load(const char *filename, const APEX_Instruction *code_memory,
+              int code_memory_size, const APEX_Config *config)
+{
+    checkpoint_header saved, expected;
+    checkpoint_stream s;
+    const char *mismatch;
+    APEX_CPU *cpu;
+
+    cpu = APEX_cpu_create(code_memory, code_memory_size, config);
+    if (!cpu)
+    {
+        return NULL;
+    }
+
+    s.fp = fopen(filename, "rb");
+    s.saving = FALSE;
+    s.error = FALSE;
+    if (!s.fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open checkpoint %s\n", filename);
+        APEX_cpu_stop(cpu);
+        return NULL;
+    }
+
+    fill_header(&expected, code_memory, code_memory_size, &cpu->config);
+    ckpt_read(&s, &saved, sizeof(saved));
+    mismatch = s.error ? "truncated" : header_mismatch(&saved, &expected);
+    if (mismatch)
+    {
+        fprintf(stderr, "APEX_Error: Checkpoint %s is %s\n", filename, mismatch);
+        fclose(s.fp);
+        APEX_cpu_stop(cpu);
+        return NULL;
+    }
+
+    transfer_state(&s, cpu);
+    load_data_memory(&s, cpu);
+    fclose(s.fp);
+
+    if (s.error)
+    {
+        fprintf(stderr, "APEX_Error: Checkpoint %s is corrupt\n", filename);
+        APEX_cpu_stop(cpu);
+        return NULL;
+    }
+
+    /* Occupancy, wakeup and select state are derived from the entries, not saved */
+    issue_queue_rebuild(&cpu->iq);
+    lsq_rebuild(&cpu->lsq);
+    reorder_buffer_rebuild(&cpu->rob);
+    free_physical_registers_rebuild(&cpu->free_prf_q);
+    rename_checkpoint_rebuild(&cpu->checkpoints);
+
+    if (cpu->status != APEX_STATUS_HALTED)
+    {
+        cpu->status = APEX_STATUS_RUNNING;
+    }
+    return cpu;
+}
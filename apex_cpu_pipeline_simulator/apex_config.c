@@ -0,0 +1,406 @@
+/*
+ * apex_config.c
+ * Contains functions to build the runtime microarchitecture configuration
+ * from defaults, key=value files and command line assignments
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_config.h"
+
+#define CONFIG_INT 0
+#define CONFIG_LONG 1
+
+/* Largest accepted structure size */
+#define MAX_STRUCTURE_SIZE (1 << 24)
+
+/* Description of one configurable key */
+typedef struct config_key
+{
+    const char *name;
+    size_t offset;
+    int type;
+    long min_value;
+    long max_value;
+} config_key;
+
+/* The reorder buffer is reported full one entry early, so it needs two */
+static const config_key config_keys[] = {
+    {"rob_size", offsetof(APEX_Config, rob_size), CONFIG_INT, 2, MAX_STRUCTURE_SIZE},
+    {"issue_queue_size", offsetof(APEX_Config, issue_queue_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"lsq_size", offsetof(APEX_Config, lsq_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"physical_registers_size", offsetof(APEX_Config, physical_registers_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"data_memory_size", offsetof(APEX_Config, data_memory_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"memory_latency", offsetof(APEX_Config, memory_latency), CONFIG_INT, 1, INT_MAX},
+    {"branch_checkpoints", offsetof(APEX_Config, branch_checkpoints), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"branch_predictor", offsetof(APEX_Config, branch_predictor), CONFIG_INT, BP_NONE, BP_TAGE},
+    {"btb_size", offsetof(APEX_Config, btb_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"predictor_table_size", offsetof(APEX_Config, predictor_table_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"history_length", offsetof(APEX_Config, history_length), CONFIG_INT, 1, 64},
+    {"ras_size", offsetof(APEX_Config, ras_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"machine_width", offsetof(APEX_Config, machine_width), CONFIG_INT, 1, MAX_MACHINE_WIDTH},
+    {"fetch_width", offsetof(APEX_Config, fetch_width), CONFIG_INT, 0, MAX_MACHINE_WIDTH},
+    {"dispatch_width", offsetof(APEX_Config, dispatch_width), CONFIG_INT, 0, MAX_MACHINE_WIDTH},
+    {"issue_width", offsetof(APEX_Config, issue_width), CONFIG_INT, 0, MAX_STRUCTURE_SIZE},
+    {"commit_width", offsetof(APEX_Config, commit_width), CONFIG_INT, 0, MAX_MACHINE_WIDTH},
+    {"int_units", offsetof(APEX_Config, int_units), CONFIG_INT, 1, MAX_FU_UNITS},
+    {"int_latency", offsetof(APEX_Config, int_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"int_pipelined", offsetof(APEX_Config, int_pipelined), CONFIG_INT, 0, 1},
+    {"mul_units", offsetof(APEX_Config, mul_units), CONFIG_INT, 1, MAX_FU_UNITS},
+    {"mul_latency", offsetof(APEX_Config, mul_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"mul_pipelined", offsetof(APEX_Config, mul_pipelined), CONFIG_INT, 0, 1},
+    {"mul_opcodes", offsetof(APEX_Config, mul_opcodes), CONFIG_INT, 0, INT_MAX},
+    {"branch_units", offsetof(APEX_Config, branch_units), CONFIG_INT, 1, MAX_FU_UNITS},
+    {"branch_latency", offsetof(APEX_Config, branch_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"branch_pipelined", offsetof(APEX_Config, branch_pipelined), CONFIG_INT, 0, 1},
+    {"mem_units", offsetof(APEX_Config, mem_units), CONFIG_INT, 1, MAX_FU_UNITS},
+    {"memory_mshrs", offsetof(APEX_Config, memory_mshrs), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"memory_dependence", offsetof(APEX_Config, memory_dependence), CONFIG_INT, MD_WAIT, MD_SPECULATE},
+    {"ssit_size", offsetof(APEX_Config, ssit_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l1d_size", offsetof(APEX_Config, l1d_size), CONFIG_INT, 0, MAX_STRUCTURE_SIZE},
+    {"l1d_assoc", offsetof(APEX_Config, l1d_assoc), CONFIG_INT, 1, MAX_CACHE_ASSOC},
+    {"l1d_line_size", offsetof(APEX_Config, l1d_line_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l1d_latency", offsetof(APEX_Config, l1d_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l1d_replacement", offsetof(APEX_Config, l1d_replacement), CONFIG_INT, CACHE_LRU, CACHE_RANDOM},
+    {"l2_size", offsetof(APEX_Config, l2_size), CONFIG_INT, 0, MAX_STRUCTURE_SIZE},
+    {"l2_assoc", offsetof(APEX_Config, l2_assoc), CONFIG_INT, 1, MAX_CACHE_ASSOC},
+    {"l2_line_size", offsetof(APEX_Config, l2_line_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l2_latency", offsetof(APEX_Config, l2_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l2_replacement", offsetof(APEX_Config, l2_replacement), CONFIG_INT, CACHE_LRU, CACHE_RANDOM},
+    {"l1i_size", offsetof(APEX_Config, l1i_size), CONFIG_INT, 0, MAX_STRUCTURE_SIZE},
+    {"l1i_assoc", offsetof(APEX_Config, l1i_assoc), CONFIG_INT, 1, MAX_CACHE_ASSOC},
+    {"l1i_line_size", offsetof(APEX_Config, l1i_line_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l1i_latency", offsetof(APEX_Config, l1i_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"l1i_replacement", offsetof(APEX_Config, l1i_replacement), CONFIG_INT, CACHE_LRU, CACHE_RANDOM},
+    {"cache_write_back", offsetof(APEX_Config, cache_write_back), CONFIG_INT, 0, 1},
+    {"fetch_buffer_size", offsetof(APEX_Config, fetch_buffer_size), CONFIG_INT, 0, MAX_STRUCTURE_SIZE},
+    {"prefetcher", offsetof(APEX_Config, prefetcher), CONFIG_INT, PF_NONE, PF_STRIDE},
+    {"prefetch_degree", offsetof(APEX_Config, prefetch_degree), CONFIG_INT, 1, MAX_PREFETCH_DEGREE},
+    {"prefetch_distance", offsetof(APEX_Config, prefetch_distance), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"prefetch_table_size", offsetof(APEX_Config, prefetch_table_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_channels", offsetof(APEX_Config, dram_channels), CONFIG_INT, 0, MAX_DRAM_CHANNELS},
+    {"dram_banks", offsetof(APEX_Config, dram_banks), CONFIG_INT, 1, MAX_DRAM_BANKS},
+    {"dram_row_size", offsetof(APEX_Config, dram_row_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_row_hit_latency", offsetof(APEX_Config, dram_row_hit_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_row_miss_latency", offsetof(APEX_Config, dram_row_miss_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_row_conflict_latency", offsetof(APEX_Config, dram_row_conflict_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_burst_cycles", offsetof(APEX_Config, dram_burst_cycles), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_queue_size", offsetof(APEX_Config, dram_queue_size), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"dram_page_policy", offsetof(APEX_Config, dram_page_policy), CONFIG_INT, DRAM_OPEN_PAGE, DRAM_CLOSE_PAGE},
+    {"dtlb_entries", offsetof(APEX_Config, dtlb_entries), CONFIG_INT, 0, MAX_TLB_ENTRIES},
+    {"dtlb_assoc", offsetof(APEX_Config, dtlb_assoc), CONFIG_INT, 1, MAX_CACHE_ASSOC},
+    {"l2_tlb_entries", offsetof(APEX_Config, l2_tlb_entries), CONFIG_INT, 0, MAX_TLB_ENTRIES},
+    {"l2_tlb_assoc", offsetof(APEX_Config, l2_tlb_assoc), CONFIG_INT, 1, MAX_CACHE_ASSOC},
+    {"l2_tlb_latency", offsetof(APEX_Config, l2_tlb_latency), CONFIG_INT, 1, MAX_STRUCTURE_SIZE},
+    {"page_size", offsetof(APEX_Config, page_size), CONFIG_INT, PAGE_4K, PAGE_2M},
+    {"page_table_levels", offsetof(APEX_Config, page_table_levels), CONFIG_INT, 2, MAX_PAGE_TABLE_LEVELS},
+    {"page_walkers", offsetof(APEX_Config, page_walkers), CONFIG_INT, 1, MAX_PAGE_WALKERS},
+    {"max_cycles", offsetof(APEX_Config, max_cycles), CONFIG_LONG, 0, LONG_MAX},
+    {"skip_idle_cycles", offsetof(APEX_Config, skip_idle_cycles), CONFIG_INT, 0, 1},
+};
+
+#define NUM_CONFIG_KEYS (sizeof(config_keys) / sizeof(config_keys[0]))
+
+/* Fills config with the compile time defaults from apex_macros.h */
+void
+APEX_config_init(APEX_Config *config)
+{
+    config->rob_size = DEFAULT_ROB_SIZE;
+    config->issue_queue_size = DEFAULT_ISSUE_QUEUE_SIZE;
+    config->lsq_size = DEFAULT_LSQ_SIZE;
+    config->physical_registers_size = DEFAULT_PHYSICAL_REGISTERS_SIZE;
+    config->data_memory_size = DEFAULT_DATA_MEMORY_SIZE;
+    config->memory_latency = DEFAULT_MEMORY_LATENCY;
+    config->branch_checkpoints = DEFAULT_BRANCH_CHECKPOINTS;
+    config->branch_predictor = DEFAULT_BRANCH_PREDICTOR;
+    config->btb_size = DEFAULT_BTB_SIZE;
+    config->predictor_table_size = DEFAULT_PREDICTOR_TABLE_SIZE;
+    config->history_length = DEFAULT_HISTORY_LENGTH;
+    config->ras_size = DEFAULT_RAS_SIZE;
+    config->machine_width = DEFAULT_MACHINE_WIDTH;
+    config->fetch_width = 0;
+    config->dispatch_width = 0;
+    config->issue_width = 0;
+    config->commit_width = 0;
+    config->int_units = DEFAULT_INT_UNITS;
+    config->int_latency = DEFAULT_INT_LATENCY;
+    config->int_pipelined = 1;
+    config->mul_units = DEFAULT_MUL_UNITS;
+    config->mul_latency = DEFAULT_MUL_LATENCY;
+    config->mul_pipelined = 1;
+    config->mul_opcodes = DEFAULT_MUL_OPCODES;
+    config->branch_units = DEFAULT_BRANCH_UNITS;
+    config->branch_latency = DEFAULT_BRANCH_LATENCY;
+    config->branch_pipelined = 1;
+    config->mem_units = DEFAULT_MEM_UNITS;
+    config->memory_mshrs = DEFAULT_MEMORY_MSHRS;
+    config->memory_dependence = DEFAULT_MEMORY_DEPENDENCE;
+    config->ssit_size = DEFAULT_SSIT_SIZE;
+    config->l1d_size = DEFAULT_L1D_SIZE;
+    config->l1d_assoc = DEFAULT_L1D_ASSOC;
+    config->l1d_line_size = DEFAULT_L1D_LINE_SIZE;
+    config->l1d_latency = DEFAULT_L1D_LATENCY;
+    config->l1d_replacement = DEFAULT_CACHE_REPLACEMENT;
+    config->l2_size = DEFAULT_L2_SIZE;
+    config->l2_assoc = DEFAULT_L2_ASSOC;
+    config->l2_line_size = DEFAULT_L2_LINE_SIZE;
+    config->l2_latency = DEFAULT_L2_LATENCY;
+    config->l2_replacement = DEFAULT_CACHE_REPLACEMENT;
+    config->l1i_size = DEFAULT_L1I_SIZE;
+    config->l1i_assoc = DEFAULT_L1I_ASSOC;
+    config->l1i_line_size = DEFAULT_L1I_LINE_SIZE;
+    config->l1i_latency = DEFAULT_L1I_LATENCY;
+    config->l1i_replacement = DEFAULT_CACHE_REPLACEMENT;
+    config->cache_write_back = DEFAULT_CACHE_WRITE_BACK;
+    config->fetch_buffer_size = DEFAULT_FETCH_BUFFER_SIZE;
+    config->prefetcher = DEFAULT_PREFETCHER;
+    config->prefetch_degree = DEFAULT_PREFETCH_DEGREE;
+    config->prefetch_distance = DEFAULT_PREFETCH_DISTANCE;
+    config->prefetch_table_size = DEFAULT_PREFETCH_TABLE_SIZE;
+    config->dram_channels = DEFAULT_DRAM_CHANNELS;
+    config->dram_banks = DEFAULT_DRAM_BANKS;
+    config->dram_row_size = DEFAULT_DRAM_ROW_SIZE;
+    config->dram_row_hit_latency = DEFAULT_DRAM_ROW_HIT_LATENCY;
+    config->dram_row_miss_latency = DEFAULT_DRAM_ROW_MISS_LATENCY;
+    config->dram_row_conflict_latency = DEFAULT_DRAM_ROW_CONFLICT_LATENCY;
+    config->dram_burst_cycles = DEFAULT_DRAM_BURST_CYCLES;
+    config->dram_queue_size = DEFAULT_DRAM_QUEUE_SIZE;
+    config->dram_page_policy = DEFAULT_DRAM_PAGE_POLICY;
+    config->dtlb_entries = DEFAULT_DTLB_ENTRIES;
+    config->dtlb_assoc = DEFAULT_DTLB_ASSOC;
+    config->l2_tlb_entries = DEFAULT_L2_TLB_ENTRIES;
+    config->l2_tlb_assoc = DEFAULT_L2_TLB_ASSOC;
+    config->l2_tlb_latency = DEFAULT_L2_TLB_LATENCY;
+    config->page_size = DEFAULT_PAGE_SIZE;
+    config->page_table_levels = DEFAULT_PAGE_TABLE_LEVELS;
+    config->page_walkers = DEFAULT_PAGE_WALKERS;
+    config->max_cycles = 0;
+    config->skip_idle_cycles = DEFAULT_SKIP_IDLE_CYCLES;
+}
+
+/* Reads the value of a key as a long, whatever its storage type */
+static long
+get_key_value(const APEX_Config *config, const config_key *key)
+{
+    const char *field = (const char *)config + key->offset;
+
+    if (key->type == CONFIG_LONG)
+    {
+        return *(const long *)field;
+    }
+    return *(const int *)field;
+}
+
+/*
+ * Sets one configuration key from its string value
+ *
+ * Returns 0 on success, -1 for an unknown key or an invalid value
+ */
+int
+APEX_config_set(APEX_Config *config, const char *key, const char *value)
+{
+    size_t i;
+    char *end;
+    long parsed;
+
+    for (i = 0; i < NUM_CONFIG_KEYS; ++i)
+    {
+        if (strcmp(key, config_keys[i].name) == 0)
+        {
+            errno = 0;
+            parsed = strtol(value, &end, 0);
+            if (errno || end == value || *end != '\0' ||
+                parsed < config_keys[i].min_value || parsed > config_keys[i].max_value)
+            {
+                fprintf(stderr, "APEX_Error: Invalid value %s for %s\n", value, key);
+                return -1;
+            }
+            if (config_keys[i].type == CONFIG_LONG)
+            {
+                *(long *)((char *)config + config_keys[i].offset) = parsed;
+            }
+            else
+            {
+                *(int *)((char *)config + config_keys[i].offset) = (int)parsed;
+            }
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "APEX_Error: Unknown configuration key %s\n", key);
+    return -1;
+}
+
+/* Strips leading and trailing white space in place */
+static char *
+trim(char *str)
+{
+    char *end;
+
+    while (*str == ' ' || *str == '\t')
+    {
+        str++;
+    }
+    end = str + strlen(str);
+    while (end > str && strchr(" \t\r\n", end[-1]))
+    {
+        end--;
+    }
+    *end = '\0';
+    return str;
+}
+
+/*
+ * Applies one "key=value" assignment, as given on the command line or as a
+ * line of a configuration file
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+APEX_config_parse_assignment(APEX_Config *config, const char *assignment)
+{
+    char buffer[256];
+    char *equals;
+
+    if (strlen(assignment) >= sizeof(buffer))
+    {
+        fprintf(stderr, "APEX_Error: Configuration line too long\n");
+        return -1;
+    }
+    strcpy(buffer, assignment);
+
+    equals = strchr(buffer, '=');
+    if (!equals)
+    {
+        fprintf(stderr, "APEX_Error: Expected key=value, got %s\n", assignment);
+        return -1;
+    }
+    *equals = '\0';
+
+    return APEX_config_set(config, trim(buffer), trim(equals + 1));
+}
+
+/*
+ * Loads a configuration file of key=value lines, blank lines and lines
+ * starting with '#' are ignored
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+APEX_config_load(APEX_Config *config, const char *filename)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t len = 0;
+    char *content;
+    int status = 0;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open configuration file %s\n", filename);
+        return -1;
+    }
+
+    while (status == 0 && getline(&line, &len, fp) != -1)
+    {
+        content = trim(line);
+        if (content[0] == '\0' || content[0] == '#')
+        {
+            continue;
+        }
+        status = APEX_config_parse_assignment(config, content);
+    }
+
+    free(line);
+    fclose(fp);
+    return status;
+}
+
+/* Checks the geometry of the cache whose keys start with name, when present:
+ * its sets must hold a whole number of lines and tree PLRU needs a power of
+ * two of them per set */
+static int
+check_cache(const char *name, int size, int assoc, int line_size, int replacement)
+{
+    if (!size)
+    {
+        return 0;
+    }
+    if (size % (line_size * assoc))
+    {
+        fprintf(stderr, "APEX_Error: Invalid value %d for %s_size, not a multiple of "
+                        "%s_line_size*%s_assoc (%d)\n",
+                size, name, name, name, line_size * assoc);
+        return -1;
+    }
+    if (replacement == CACHE_PLRU && (assoc & (assoc - 1)))
+    {
+        fprintf(stderr, "APEX_Error: Invalid value %d for %s_assoc, PLRU replacement "
+                        "needs a power of two\n", assoc, name);
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks that a TLB of entries holds whole sets of assoc entries */
+static int
+check_tlb(const char *name, int entries, int assoc)
+{
+    if (entries % assoc)
+    {
+        fprintf(stderr, "APEX_Error: Invalid value %d for %s_entries, not a multiple of "
+                        "%s_assoc (%d)\n", entries, name, name, assoc);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Checks the keys that constrain each other, APEX_config_set already checked
+ * the range of each key on its own
+ *
+ * Returns 0 if the configuration is consistent, -1 after reporting the first
+ * conflict
+ */
+int
+APEX_config_check(const APEX_Config *config)
+{
+    if (check_cache("l1d", config->l1d_size, config->l1d_assoc, config->l1d_line_size,
+                    config->l1d_replacement) ||
+        check_cache("l2", config->l2_size, config->l2_assoc, config->l2_line_size,
+                    config->l2_replacement) ||
+        check_cache("l1i", config->l1i_size, config->l1i_assoc, config->l1i_line_size,
+                    config->l1i_replacement))
+    {
+        return -1;
+    }
+    /* The second level TLB is left out along with translation */
+    if (config->dtlb_entries &&
+        (check_tlb("dtlb", config->dtlb_entries, config->dtlb_assoc) ||
+         check_tlb("l2_tlb", config->l2_tlb_entries, config->l2_tlb_assoc)))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* Prints the configuration in the same key=value format it is loaded from */
+void
+APEX_config_print(const APEX_Config *config, FILE *fp)
+{
+    size_t i;
+
+    for (i = 0; i < NUM_CONFIG_KEYS; ++i)
+    {
+        fprintf(fp, "%s=%ld\n", config_keys[i].name,
+                get_key_value(config, &config_keys[i]));
+    }
+}
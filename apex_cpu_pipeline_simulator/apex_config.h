@@ -0,0 +1,106 @@
+/*
+ * apex_config.h
+ * Contains the runtime microarchitecture configuration of the APEX cpu
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CONFIG_H_
+#define _APEX_CONFIG_H_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+/* Sizes of the microarchitectural structures, one instance per simulation */
+typedef struct APEX_Config
+{
+    int rob_size;                /* Reorder buffer entries */
+    int issue_queue_size;        /* Issue queue entries */
+    int lsq_size;                /* Load store queue entries */
+    int physical_registers_size; /* Physical registers (excluding CCR) */
+    int data_memory_size;        /* Data memory words */
+    int memory_latency;          /* Cycles a load or store spends in memory */
+    int branch_checkpoints;      /* Rename checkpoints, branches in flight at once */
+    int branch_predictor;        /* One of BP_* */
+    int btb_size;                /* Branch target buffer entries */
+    int predictor_table_size;    /* Counters per direction predictor table */
+    int history_length;          /* Global history bits of gshare and TAGE */
+    int ras_size;                /* Return address stack entries */
+    int machine_width;           /* Default width of every in order stage */
+    int fetch_width;             /* Instructions fetched a cycle, 0 for machine_width */
+    int dispatch_width;          /* Instructions renamed and dispatched a cycle,
+                                  * 0 for machine_width */
+    int issue_width;             /* Instructions issued a cycle over all
+                                  * functional units, 0 for one per unit */
+    int commit_width;            /* Instructions retired a cycle, 0 for machine_width */
+    int int_units;               /* Integer units */
+    int int_latency;             /* Cycles an instruction spends in an integer unit */
+    int int_pipelined;           /* An integer unit starts an instruction every
+                                  * cycle (1) or only once it is empty (0) */
+    int mul_units;               /* Multiply units */
+    int mul_latency;
+    int mul_pipelined;
+    int mul_opcodes;             /* Opcodes executed by the multiply units instead
+                                  * of the integer units, bit n for opcode n */
+    int branch_units;            /* Branch units */
+    int branch_latency;
+    int branch_pipelined;
+    int mem_units;               /* Memory units, fed in order by the LSQ */
+    int memory_mshrs;            /* Accesses a memory unit keeps in flight at once */
+    int memory_dependence;       /* One of MD_* */
+    int ssit_size;               /* Store set identifier table entries */
+    int l1d_size;                /* L1 data cache words, 0 for none */
+    int l1d_assoc;               /* Lines per set */
+    int l1d_line_size;           /* Words per line */
+    int l1d_latency;             /* Cycles of a hit */
+    int l1d_replacement;         /* One of CACHE_* */
+    int l2_size;                 /* L2 cache words, 0 for none */
+    int l2_assoc;
+    int l2_line_size;
+    int l2_latency;
+    int l2_replacement;
+    int l1i_size;                /* L1 instruction cache instructions, 0 for none */
+    int l1i_assoc;
+    int l1i_line_size;           /* Instructions per line */
+    int l1i_latency;             /* Cycles of a hit, the fetch cycle included */
+    int l1i_replacement;
+    int cache_write_back;        /* Stores write back and allocate on a miss (1)
+                                  * or write through without allocating (0) */
+    int fetch_buffer_size;       /* Fetched instructions held between fetch and
+                                  * decode besides the decode group */
+    int prefetcher;              /* One of PF_* */
+    int prefetch_degree;         /* Lines prefetched per load */
+    int prefetch_distance;       /* Lines or strides ahead of the load */
+    int prefetch_table_size;     /* Stride prefetcher entries */
+    int dram_channels;           /* DRAM channels, 0 for a flat memory_latency */
+    int dram_banks;              /* Banks per channel */
+    int dram_row_size;           /* Words per row */
+    int dram_row_hit_latency;    /* Cycles to the data when the row is open */
+    int dram_row_miss_latency;   /* ... when the bank is precharged */
+    int dram_row_conflict_latency; /* ... when another row is open */
+    int dram_burst_cycles;       /* Cycles a line takes on the data bus */
+    int dram_queue_size;         /* Requests the scheduler chooses from */
+    int dram_page_policy;        /* One of DRAM_*_PAGE */
+    int dtlb_entries;            /* Data TLB entries, 0 for no translation */
+    int dtlb_assoc;
+    int l2_tlb_entries;          /* Second level TLB entries, 0 for none */
+    int l2_tlb_assoc;
+    int l2_tlb_latency;          /* Cycles of a second level TLB hit */
+    int page_size;               /* One of PAGE_* */
+    int page_table_levels;       /* Levels of the page table of 4 KB pages */
+    int page_walkers;            /* Page walks in flight */
+    long max_cycles;             /* Stop after this many cycles, 0 for no limit */
+    int skip_idle_cycles;        /* Let APEX_cpu_run jump over cycles in which only
+                                  * multi cycle operations count down (0 or 1) */
+} APEX_Config;
+
+void APEX_config_init(APEX_Config *config);
+int APEX_config_set(APEX_Config *config, const char *key, const char *value);
+int APEX_config_parse_assignment(APEX_Config *config, const char *assignment);
+int APEX_config_load(APEX_Config *config, const char *filename);
+int APEX_config_check(const APEX_Config *config);
+void APEX_config_print(const APEX_Config *config, FILE *fp);
+#endif
@@ -8,8 +8,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "apex_cpu.h"
 #include "apex_macros.h"
+#include "apex_isa.h"
 #include "physical_register.h"
 #include  "issue_queue.h"
 
@@ -25,8 +27,10 @@ get_code_memory_index_from_pc(const int pc)
 
 
 static void
-print_instruction(const CPU_Stage *stage)
+print_instruction(FILE *fp, const CPU_Stage *stage)
 {
+    const char *opcode_str = APEX_opcode_name(stage->opcode);
+
     switch (stage->opcode)
     {
         case OPCODE_ADD:
@@ -36,40 +40,40 @@ print_instruction(const CPU_Stage *stage)
         case OPCODE_OR:
         case OPCODE_XOR:
         {
-            printf("%s,R%d,R%d,R%d ", stage->opcode_str, stage->rd, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,R%d ", opcode_str, stage->rd, stage->rs1,
                    stage->rs2);
             break;
         }
         case OPCODE_ADDL:
         {
-            printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,#%d ", opcode_str, stage->rd, stage->rs1,
                    stage->imm);
             break;
         }
         case OPCODE_SUBL:
         {
-            printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,#%d ", opcode_str, stage->rd, stage->rs1,
                    stage->imm);
             break;
         }
 
         case OPCODE_MOVC:
         {
-            printf("%s,R%d,#%d ", stage->opcode_str, stage->rd, stage->imm);
+            fprintf(fp, "%s,R%d,#%d ", opcode_str, stage->rd, stage->imm);
             break;
         }
 
         
         case OPCODE_LOAD:
         {
-            printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,#%d ", opcode_str, stage->rd, stage->rs1,
                    stage->imm);
             break;
         }
 
         case OPCODE_STORE:
         {
-            printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rs2, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,#%d ", opcode_str, stage->rs2, stage->rs1,
                    stage->imm);
             break;
         }
@@ -79,32 +83,32 @@ print_instruction(const CPU_Stage *stage)
         case OPCODE_BP:
         case OPCODE_BNP:
         {
-            printf("%s,#%d ", stage->opcode_str, stage->imm);
+            fprintf(fp, "%s,#%d ", opcode_str, stage->imm);
             break;
         }
         case OPCODE_JUMP:
         {
-            printf("%s,R%d,#%d ", stage->opcode_str, stage->rs1, stage->imm);
+            fprintf(fp, "%s,R%d,#%d ", opcode_str, stage->rs1, stage->imm);
             break;
         }
         case OPCODE_JALR:
         {
-            printf("%s,R%d,R%d,#%d ", stage->opcode_str, stage->rd, stage->rs1,
+            fprintf(fp, "%s,R%d,R%d,#%d ", opcode_str, stage->rd, stage->rs1,
                    stage->imm);
         }
         case OPCODE_RET:
         {
-            printf("%s,R%d", stage->opcode_str, stage->rs1);
+            fprintf(fp, "%s,R%d", opcode_str, stage->rs1);
             break;
         }
         case OPCODE_CMP:
         {
-            printf("%s,R%d,R%d ", stage->opcode_str, stage->rs1, stage->rs2);
+            fprintf(fp, "%s,R%d,R%d ", opcode_str, stage->rs1, stage->rs2);
             break;
         }
         case OPCODE_HALT:
         {
-            printf("%s", stage->opcode_str);
+            fprintf(fp, "%s", opcode_str);
             break;
         }
     }
@@ -115,13 +119,13 @@ print_instruction(const CPU_Stage *stage)
  * Note: You can edit this function to print in more detail
  */
 static void
-print_stage_content(const char *name, const CPU_Stage *stage)
+print_stage_content(const APEX_CPU *cpu, const char *name, const CPU_Stage *stage)
 {
     if(stage->pc>=4000){
         //printf("%-15s: pc(%d) ", name, stage->pc);
-        printf("%-15s: I[%d] ",name, (stage->pc-4000)/4);
+        fprintf(cpu->trace_out, "%-15s: I[%d] ",name, (stage->pc-4000)/4);
 
-        printf("\n");
+        fprintf(cpu->trace_out, "\n");
     }
 }
 
@@ -134,1290 +138,2001 @@ print_reg_file(const APEX_CPU *cpu)
 {
     int i,ph;
 
-    printf("----------\n%s\n----------\n", "ARCHITECTURAL Registers:");
+    fprintf(cpu->trace_out, "----------\n%s\n----------\n", "ARCHITECTURAL Registers:");
 
     for (int i = 0; i < ARCHITECTURAL_REGISTERS_SIZE / 2; ++i)
     {
-        printf("R%-3d[%-3d] ", i, cpu->arf.architectural_register_file[i].value);
+        fprintf(cpu->trace_out, "R%-3d[%-3d] ", i, cpu->arf.architectural_register_file[i].value);
     }
 
-    printf("\n");
+    fprintf(cpu->trace_out, "\n");
 
     for (i = (ARCHITECTURAL_REGISTERS_SIZE / 2); i < ARCHITECTURAL_REGISTERS_SIZE; ++i)
     {
-        printf("R%-3d[%-3d] ", i,cpu->arf.architectural_register_file[i].value);
+        fprintf(cpu->trace_out, "R%-3d[%-3d] ", i,cpu->arf.architectural_register_file[i].value);
     }
 
-    printf("\n");
+    fprintf(cpu->trace_out, "\n");
 
-    printf("----------\n%s\n----------\n", "PHYSICAL Registers:");
+    fprintf(cpu->trace_out, "----------\n%s\n----------\n", "PHYSICAL Registers:");
 
-    for (int ph = 0; ph < PHYSICAL_REGISTERS_SIZE / 2; ++ph)
+    for (int ph = 0; ph < cpu->prf.size / 2; ++ph)
     {
-        printf("P%-3d[%-3d] ", ph, cpu->prf.physical_register[ph].reg_value);
+        fprintf(cpu->trace_out, "P%-3d[%-3d] ", ph, cpu->prf.physical_register[ph].reg_value);
     }
 
-    printf("\n");
+    fprintf(cpu->trace_out, "\n");
 
-    for (ph = (PHYSICAL_REGISTERS_SIZE / 2); ph < PHYSICAL_REGISTERS_SIZE; ++ph)
+    for (ph = (cpu->prf.size / 2); ph < cpu->prf.size; ++ph)
     {
-        printf("P%-3d[%-3d] ", ph,cpu->prf.physical_register[ph].reg_value);
+        fprintf(cpu->trace_out, "P%-3d[%-3d] ", ph,cpu->prf.physical_register[ph].reg_value);
     }
 
-    printf("\n");
+    fprintf(cpu->trace_out, "\n");
 
     //rename table CCR
 
     if(cpu->rnt.rename_table[16].register_source==1)
     {
         if(cpu->prf.physical_register[cpu->rnt.rename_table[16].mapped_to_physical_register].reg_valid){
-            printf("%d", cpu->prf.physical_register[cpu->rnt.rename_table[16].mapped_to_physical_register].reg_value);
+            fprintf(cpu->trace_out, "%d", cpu->prf.physical_register[cpu->rnt.rename_table[16].mapped_to_physical_register].reg_value);
         }
         else{
-            printf("%d", cpu->arf.architectural_register_file[cpu->arf.architectural_register_file[16].value].value);
+            fprintf(cpu->trace_out, "%d", cpu->arf.architectural_register_file[cpu->arf.architectural_register_file[16].value].value);
         }
     }
 
 }
 
-/*
- * Fetch Stage of APEX Pipeline
- *
- * Note: You are free to edit this function according to your implementation
- */
+/* Debug function which prints the parsed code memory */
 static void
-APEX_fetch(APEX_CPU *cpu)
+print_code_memory(const APEX_CPU *cpu)
 {
-    APEX_Instruction *current_ins;
+    int i;
 
-    if (cpu->fetch.has_insn)
+    fprintf(cpu->trace_out, "APEX_CPU: Initialized APEX CPU, loaded %d instructions\n",
+            cpu->code_memory_size);
+    fprintf(cpu->trace_out, "APEX_CPU: PC initialized to %d\n", cpu->pc);
+    fprintf(cpu->trace_out, "APEX_CPU: Printing Code Memory\n");
+    fprintf(cpu->trace_out, "%-9s %-9s %-9s %-9s %-9s\n", "opcode_str", "rd", "rs1", "rs2",
+           "imm");
+
+    for (i = 0; i < cpu->code_memory_size; ++i)
     {
-        /* This fetches new branch target instruction from next cycle */
-        if (cpu->fetch_from_next_cycle == TRUE)
+        fprintf(cpu->trace_out, "%-9s %-9d %-9d %-9d %-9d\n",
+               APEX_opcode_name(cpu->code_memory[i].opcode),
+               cpu->code_memory[i].rd, cpu->code_memory[i].rs1,
+               cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
+    }
+}
+
+/* Summary labels of the cache levels */
+static const char *const cache_names[NUM_CACHE_LEVELS] = {
+    "L1D", "L2", "L1I",
+};
+
+//level a cache misses to, -1 for the memory behind the caches
+static int
+next_cache_level(int level)
+{
+    return level==CACHE_L2?-1:CACHE_L2;
+}
+
+//cache level the prefetcher fills, the first data cache in use, -1 for none
+static int
+prefetch_level(const APEX_CPU *cpu)
+{
+    for(int level=CACHE_L1D;level!=-1;level=next_cache_level(level)){
+        if(cache_enabled(&cpu->caches[level])){
+            return level;
+        }
+    }
+    return -1;
+}
+
+/* Prints the end of simulation summary line, shown at every verbosity except
+ * VERBOSITY_NONE and independent of ENABLE_DEBUG_MESSAGES, followed by the
+ * statistics of every cache level in use, of the front end, of the
+ * prefetcher, of the DRAM and of the TLBs
+ */
+static void
+print_summary(const APEX_CPU *cpu, const char *reason, int cycles)
+{
+    if (cpu->verbosity >= VERBOSITY_SUMMARY)
+    {
+        fprintf(cpu->trace_out, "APEX_CPU: %s, cycles = %d instructions = %d IPC = %.4f\n",
+               reason, cycles, cpu->insn_completed,
+               cycles ? (double)cpu->insn_completed / cycles : 0.0);
+        fprintf(cpu->trace_out, "APEX_CPU: branches = %ld mispredictions = %ld accuracy = %.2f%% MPKI = %.2f\n",
+               cpu->stats.branches, cpu->stats.branch_mispredicts,
+               cpu->stats.branches ? 100.0 * (cpu->stats.branches - cpu->stats.branch_mispredicts) / cpu->stats.branches : 0.0,
+               cpu->insn_completed ? 1000.0 * cpu->stats.branch_mispredicts / cpu->insn_completed : 0.0);
+        for (int i = 0; i < NUM_CACHE_LEVELS; ++i)
         {
-            cpu->fetch_from_next_cycle = FALSE;
+            const cache_stats *stats = &cpu->stats.caches[i];
 
-            /* Skip this cycle*/
-            return;
+            if (!cache_enabled(&cpu->caches[i]))
+            {
+                continue;
+            }
+            fprintf(cpu->trace_out, "APEX_CPU: %s accesses = %ld hit rate = %.2f%% miss latency = %.2f writebacks = %ld\n",
+                   cache_names[i], stats->accesses,
+                   stats->accesses ? 100.0 * (stats->accesses - stats->misses) / stats->accesses : 0.0,
+                   stats->misses ? (double)stats->miss_cycles / stats->misses : 0.0,
+                   stats->writebacks);
+        }
+        if (cache_enabled(&cpu->caches[CACHE_L1I]) || cpu->config.fetch_buffer_size)
+        {
+            fprintf(cpu->trace_out, "APEX_CPU: fetch I-cache stall cycles = %ld average fetch buffer = %.2f\n",
+                   cpu->stats.icache_stall_cycles,
+                   cycles ? (double)cpu->stats.fetch_buffer_occupancy / cycles : 0.0);
         }
+        if (cpu->pf.kind != PF_NONE && prefetch_level(cpu) != -1)
+        {
+            const APEX_Stats *stats = &cpu->stats;
+            long misses = stats->caches[prefetch_level(cpu)].misses;
 
-        if(cpu->decode_rename.is_stage_stalled==1){
-            return;
+            fprintf(cpu->trace_out, "APEX_CPU: prefetches = %ld accuracy = %.2f%% coverage = %.2f%% timely = %.2f%%\n",
+                   stats->prefetches,
+                   stats->prefetches ? 100.0 * stats->prefetch_hits / stats->prefetches : 0.0,
+                   stats->prefetch_hits + misses ? 100.0 * stats->prefetch_hits / (stats->prefetch_hits + misses) : 0.0,
+                   stats->prefetch_hits ? 100.0 * (stats->prefetch_hits - stats->prefetch_late) / stats->prefetch_hits : 0.0);
+        }
+        if (dram_enabled(&cpu->dram))
+        {
+            const dram_stats *stats = &cpu->stats.dram;
+            long accesses = stats->reads + stats->writes;
+
+            fprintf(cpu->trace_out, "APEX_CPU: DRAM reads = %ld writes = %ld row hits = %.2f%% row conflicts = %.2f%% read latency = %.2f bus utilization = %.2f%%\n",
+                   stats->reads, stats->writes,
+                   accesses ? 100.0 * stats->row_hits / accesses : 0.0,
+                   accesses ? 100.0 * stats->row_conflicts / accesses : 0.0,
+                   stats->reads ? (double)stats->read_cycles / stats->reads : 0.0,
+                   cycles ? 100.0 * stats->bus_cycles / ((double)cycles * cpu->dram.channels) : 0.0);
+        }
+        if (mmu_enabled(&cpu->mmu))
+        {
+            const APEX_Stats *stats = &cpu->stats;
+
+            fprintf(cpu->trace_out, "APEX_CPU: DTLB accesses = %ld miss rate = %.2f%% page walks = %ld walk cycles = %ld average walk = %.2f\n",
+                   stats->dtlb_accesses,
+                   stats->dtlb_accesses ? 100.0 * stats->dtlb_misses / stats->dtlb_accesses : 0.0,
+                   stats->page_walks, stats->walk_cycles,
+                   stats->page_walks ? (double)stats->walk_cycles / stats->page_walks : 0.0);
+            if (cache_enabled(&cpu->mmu.l2_tlb))
+            {
+                fprintf(cpu->trace_out, "APEX_CPU: L2 TLB accesses = %ld miss rate = %.2f%%\n",
+                       stats->l2_tlb_accesses,
+                       stats->l2_tlb_accesses ? 100.0 * stats->l2_tlb_misses / stats->l2_tlb_accesses : 0.0);
+            }
         }
+    }
+}
 
+//memory accesses held by the MSHRs of all memory units
+static int
+memory_accesses_in_flight(const APEX_CPU *cpu)
+{
+    int count=0;
 
-        /* Store current PC in fetch latch */
-        cpu->fetch.pc = cpu->pc;
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        const functional_unit *fu=&cpu->fu_pool[cpu->fu_first[MEM_FU]+u];
+
+        for(int k=0;k<fu->num_stages;k++){
+            count+=fu->stages[k].has_insn;
+        }
+    }
+    return count;
+}
 
-        /* Index into code memory using this pc and copy all instruction fields
-         * into fetch latch  */
-        current_ins = &cpu->code_memory[get_code_memory_index_from_pc(cpu->pc)];
-        strcpy(cpu->fetch.opcode_str, current_ins->opcode_str);
-        cpu->fetch.opcode = current_ins->opcode;
-        cpu->fetch.rd = current_ins->rd;
-        cpu->fetch.rs1 = current_ins->rs1;
-        cpu->fetch.rs2 = current_ins->rs2;
-        cpu->fetch.imm = current_ins->imm;
+/* Adds the entries in use at the end of a cycle to the occupancy statistics */
+static void
+count_occupancy(APEX_CPU *cpu, long cycles)
+{
+    cpu->stats.rob_occupancy += cycles * cpu->rob.count;
+    cpu->stats.iq_occupancy += cycles * cpu->iq.count;
+    cpu->stats.lsq_occupancy += cycles * cpu->lsq.count;
+    cpu->stats.mshr_occupancy += cycles * memory_accesses_in_flight(cpu);
+    cpu->stats.fetch_buffer_occupancy += cycles * cpu->fetch_buffer_count;
+}
 
-        /* Update PC for next instruction */
-        cpu->pc += 4;
+/* Width of an in order stage, 0 in the config selects the machine width */
+static int
+stage_width(const APEX_CPU *cpu, int width)
+{
+    return width ? width : cpu->config.machine_width;
+}
 
-        /* Copy data from fetch latch to decode latch*/
-        cpu->decode_rename = cpu->fetch;
+/* Instructions held by a front end group, they fill it from slot 0 */
+static int
+group_count(const CPU_Stage *group)
+{
+    int count = 0;
 
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Fetch", &cpu->fetch);
-            // printf("has isn: %d\n", cpu->fetch.has_insn);
+    while (count < MAX_MACHINE_WIDTH && group[count].has_insn)
+    {
+        count++;
+    }
+    return count;
+}
+
+/* Drops the n oldest instructions of a group, the younger ones move up */
+static void
+group_remove(CPU_Stage *group, int n)
+{
+    int count = group_count(group);
+
+    memmove(group, group + n, (count - n) * sizeof(CPU_Stage));
+    for (int i = count - n; i < count; i++)
+    {
+        group[i].has_insn = FALSE;
+    }
+}
+
+/* Empties a group, its instructions are squashed */
+static void
+group_clear(CPU_Stage *group)
+{
+    for (int i = 0; i < MAX_MACHINE_WIDTH; i++)
+    {
+        group[i].has_insn = FALSE;
+        group[i].is_stage_stalled = 0;
+    }
+}
+
+/*
+ * Moves the oldest instructions of from to the end of to, as many as fit in
+ * the width of to; the ones left behind are marked stalled. Returns the
+ * number moved
+ */
+static int
+group_advance(CPU_Stage *from, CPU_Stage *to, int width)
+{
+    int in_from = group_count(from);
+    int in_to = group_count(to);
+    int moved = width - in_to;
+
+    if (moved > in_from)
+    {
+        moved = in_from;
+    }
+    if (moved < 0)
+    {
+        moved = 0;
+    }
+    for (int i = 0; i < moved; i++)
+    {
+        to[in_to + i] = from[i];
+        to[in_to + i].is_stage_stalled = 0;
+    }
+    group_remove(from, moved);
+    for (int i = 0; i < in_from - moved; i++)
+    {
+        from[i].is_stage_stalled = 1;
+    }
+    return moved;
+}
+
+/* Cycles the memory behind the caches takes for the words of address:
+ * the flat memory_latency or, with a DRAM, a request to the controller. Its
+ * data arrives once the controller schedules it, so the access returns 0
+ * cycles counted from that data and the request in *request. Without memory
+ * to spare for the request it takes memory_latency instead */
+static int
+memory_access(APEX_CPU *cpu, int address, int words, int write, int *request)
+{
+    *request=-1;
+    if(dram_enabled(&cpu->dram)){
+        *request=dram_enqueue(&cpu->dram, address, words, write, cpu->clock);
+        if(*request!=-1){
+            return 0;
         }
+    }
+    return cpu->config.memory_latency;
+}
 
-        /* Stop fetching new instructions if HALT is fetched */
-        if (cpu->fetch.opcode == OPCODE_HALT)
-        {
-            cpu->fetch.has_insn = FALSE;
+static int cache_access(APEX_CPU *cpu, int level, int address, int write, int *request);
+
+//cycles the levels below a cache level take for the line of address, the
+//memory reads or writes the whole line
+static int
+access_below(APEX_CPU *cpu, int level, int address, int write, int *request)
+{
+    const cache *c=&cpu->caches[level];
+    int next=next_cache_level(level);
+
+    while(next!=-1 && !cache_enabled(&cpu->caches[next])){
+        next=next_cache_level(next);
+    }
+    if(next==-1){
+        return memory_access(cpu, cache_line_address(c, address)*c->line_size, c->line_size,
+                             write, request);
+    }
+    return cache_access(cpu, next, address, write, request);
+}
+
+//charges a miss of a cache level the below cycles the levels below took,
+//counted from the data of request while it is pending. Those cycles are only
+//known, and charged, once the request is scheduled
+static void
+count_miss(APEX_CPU *cpu, int level, int below, int request)
+{
+    cache_stats *stats=&cpu->stats.caches[level];
+
+    stats->misses++;
+    if(request==-1){
+        stats->miss_cycles+=below;
+    }
+    else{
+        dram_request *pending=dram_find(&cpu->dram, request);
+
+        pending->misses[level]++;
+        pending->miss_cycles[level]+=below-cpu->clock;
+    }
+}
+
+//fills the line of address into a cache level, arriving latency cycles from
+//now or from the data of request, and writes the dirty line it evicts back
+//to the level below
+static cache_line *
+allocate_line(APEX_CPU *cpu, int level, int address, int latency, int request)
+{
+    cache *c=&cpu->caches[level];
+    cache_line *line, victim;
+
+    line=cache_fill(c, address, request==-1?cpu->clock+latency:latency, &victim);
+    line->request=request;
+    if(victim.valid && victim.dirty){
+        int writeback;
+
+        cpu->stats.caches[level].writebacks++;
+        access_below(cpu, level, cache_victim_address(c, &victim), TRUE, &writeback);
+    }
+    return line;
+}
+
+/* Cycles until the word at address can be read or written in a cache level,
+ * level -1 being the memory behind the caches (see memory_access). A level
+ * that is left out passes the access on. While the data comes from a DRAM
+ * request that is not scheduled yet, the cycles count from its data and the
+ * request is returned in *request, -1 otherwise.
+ *
+ * A miss fetches the line from the level below and replaces a line of the
+ * set, a dirty one is written back to the level below, which allocates it
+ * like any other write. The levels are not inclusive. A hit on a line still
+ * on its way waits for it. With cache_write_back 0 a write goes on to the
+ * level below through a write buffer instead, without allocating a line, and
+ * only waits for the first level. The first access to a prefetched line
+ * counts the prefetch as used. */
+static int
+cache_access(APEX_CPU *cpu, int level, int address, int write, int *request)
+{
+    cache *c;
+    cache_line *line;
+    int below, below_request;
+
+    *request=-1;
+    if(level==-1){
+        return memory_access(cpu, address, 1, write, request);
+    }
+    c=&cpu->caches[level];
+    if(!cache_enabled(c)){
+        return cache_access(cpu, next_cache_level(level), address, write, request);
+    }
+    cpu->stats.caches[level].accesses++;
+    line=cache_lookup(c, address);
+    if(line && line->prefetched){
+        line->prefetched=FALSE;
+        cpu->stats.prefetch_hits++;
+        cpu->stats.prefetch_late+=line->request!=-1 || line->ready>cpu->clock;
+    }
+    if(write && !cpu->config.cache_write_back){
+        below=access_below(cpu, level, address, TRUE, &below_request);
+        if(!line){
+            count_miss(cpu, level, below, below_request);
+        }
+        return c->latency;
+    }
+    if(line){
+        line->dirty|=write;
+        if(line->request!=-1){
+            *request=line->request;
+            return line->ready;
         }
+        return line->ready-cpu->clock>c->latency?line->ready-cpu->clock:c->latency;
     }
+    below=access_below(cpu, level, address, FALSE, request);
+    count_miss(cpu, level, below, *request);
+    line=allocate_line(cpu, level, address, c->latency+below, *request);
+    line->dirty=write;
+    return c->latency+below;
 }
-//// first ROB---> LSQ--->Issue_queue/////
+
+/* Instructions are cached at addresses above every data word, so the unified
+ * L2 keeps them apart from the data */
+#define CODE_CACHE_ADDRESS(pc) ((1 << 30) + get_code_memory_index_from_pc(pc))
+
 /*
- * Decode Stage of APEX Pipeline
+ * Returns how many more cycles fetch waits for the instruction cache line
+ * of cpu->pc, 0 when it can read it or has not looked it up yet and
+ * INT_MAX while the line waits for a DRAM request that is not scheduled.
+ * A hit takes the fetch cycle plus l1i_latency - 1, a miss also the latency
+ * of the levels below
+ */
+static int
+fetch_line_wait(const APEX_CPU *cpu)
+{
+    const cache *c = &cpu->caches[CACHE_L1I];
+
+    if (!cache_enabled(c) || cpu->pc < 4000 ||
+        get_code_memory_index_from_pc(cpu->pc) >= cpu->code_memory_size ||
+        cpu->fetch_line != cache_line_address(c, CODE_CACHE_ADDRESS(cpu->pc)))
+    {
+        return 0;
+    }
+    if (cpu->fetch_line_request != -1)
+    {
+        return INT_MAX;
+    }
+    return cpu->fetch_line_ready > cpu->clock ? cpu->fetch_line_ready - cpu->clock : 0;
+}
+
+/* Instructions fetch can deliver this cycle: the free slots of the decode
+ * group and of the fetch buffer */
+static int
+fetch_room(const APEX_CPU *cpu)
+{
+    return stage_width(cpu, cpu->config.fetch_width) - group_count(cpu->decode_rename) +
+           cpu->config.fetch_buffer_size - cpu->fetch_buffer_count;
+}
+
+/* Moves the oldest buffered instructions into the free slots of the decode group */
+static void
+drain_fetch_buffer(APEX_CPU *cpu)
+{
+    int width = stage_width(cpu, cpu->config.fetch_width);
+
+    for (int slot = group_count(cpu->decode_rename); slot < width && cpu->fetch_buffer_count; slot++)
+    {
+        cpu->decode_rename[slot] = cpu->fetch_buffer[cpu->fetch_buffer_head];
+        cpu->fetch_buffer_head = (cpu->fetch_buffer_head + 1) % cpu->config.fetch_buffer_size;
+        cpu->fetch_buffer_count--;
+    }
+}
+
+/*
+ * Fetch Stage of APEX Pipeline
+ *
+ * Fetches up to fetch_width instructions, the group ends after a branch
+ * predicted taken or a HALT. They fill the free slots of the decode group,
+ * or queue in the fetch buffer behind older instructions still waiting for
+ * decode. With an instruction cache fetch reads one line at a time and waits
+ * while the line it moved on to is being filled
  *
  * Note: You are free to edit this function according to your implementation
  */
 static void
-APEX_decode_rename(APEX_CPU *cpu)
+APEX_fetch(APEX_CPU *cpu)
 {
-    if (cpu->decode_rename.has_insn )
+    const APEX_Instruction *current_ins;
+    const cache *icache = &cpu->caches[CACHE_L1I];
+    int width = stage_width(cpu, cpu->config.fetch_width);
+
+    drain_fetch_buffer(cpu);
+
+    if (cpu->fetch.has_insn)
     {
+        /* This fetches new branch target instruction from next cycle */
+        if (cpu->fetch_from_next_cycle == TRUE)
+        {
+            cpu->fetch_from_next_cycle = FALSE;
 
-        if(cpu->rename_dispatch.is_stage_stalled==1){
-            cpu->decode_rename.is_stage_stalled=1;
+            /* Skip this cycle*/
             return;
         }
-        cpu->decode_rename.is_stage_stalled=0;
-
-        cpu->decode_rename.is_physical_register_required=0;
-        cpu->decode_rename.is_src1_register_required=0;
-        cpu->decode_rename.is_src2_register_required=0;
-        cpu->decode_rename.is_memory_insn=0;
 
-        /* Read operands from register file based on the instruction type */
-        switch (cpu->decode_rename.opcode)
+        for (int n = 0; n < width && cpu->fetch.has_insn && fetch_room(cpu) > 0; n++)
         {
-            case OPCODE_ADD:
-            case OPCODE_MUL:
-            case OPCODE_DIV:
-            case OPCODE_AND:
-            case OPCODE_OR:
-            case OPCODE_XOR:
+            /* A mispredicted path can run past the last instruction, fetch
+             * waits there for the branch to redirect it */
+            if (cpu->pc < 4000 || get_code_memory_index_from_pc(cpu->pc) >= cpu->code_memory_size)
             {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.is_src2_register_required=1;
-                cpu->decode_rename.fu=INT_FU;  
-                if(cpu->decode_rename.opcode==OPCODE_MUL || cpu->decode_rename.opcode==OPCODE_DIV){
-                    cpu->decode_rename.fu=MUL_FU;      
-                }
-                break;
+                return;
             }
-            case OPCODE_SUB:
-            {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.is_src2_register_required=1;
-                cpu->decode_rename.fu=INT_FU;
 
-            }
-            case OPCODE_ADDL:
+            /* The instruction cache is read a line at a time */
+            if (cache_enabled(icache) &&
+                cpu->fetch_line != cache_line_address(icache, CODE_CACHE_ADDRESS(cpu->pc)))
             {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;  
-                cpu->decode_rename.fu=INT_FU;        
-                break;
+                cpu->fetch_line = cache_line_address(icache, CODE_CACHE_ADDRESS(cpu->pc));
+                cpu->fetch_line_ready = cache_access(cpu, CACHE_L1I, CODE_CACHE_ADDRESS(cpu->pc), FALSE,
+                                                     &cpu->fetch_line_request) - 1;
+                if (cpu->fetch_line_request == -1)
+                {
+                    cpu->fetch_line_ready += cpu->clock;
+                }
             }
-            case OPCODE_SUBL:
+            if (fetch_line_wait(cpu))
             {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=INT_FU;
-                break;
+                cpu->stats.icache_stall_cycles++;
+                APEX_LOG(cpu, VERBOSITY_FULL, "Fetch waits for the instruction cache\n");
+                return;
             }
 
-            case OPCODE_LOAD:
-            {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.is_memory_insn=1;
-                cpu->decode_rename.fu=INT_FU;
-                cpu->decode_rename.memory_instruction_type=LOAD_INS;
-                break;
-            }
-            case OPCODE_STORE:
+            /* Store current PC in fetch latch */
+            cpu->fetch.pc = cpu->pc;
+
+            /* Index into code memory using this pc and copy all instruction fields
+             * into fetch latch  */
+            current_ins = &cpu->code_memory[get_code_memory_index_from_pc(cpu->pc)];
+            cpu->fetch.opcode = current_ins->opcode;
+            cpu->fetch.rd = current_ins->rd;
+            cpu->fetch.rs1 = current_ins->rs1;
+            cpu->fetch.rs2 = current_ins->rs2;
+            cpu->fetch.imm = current_ins->imm;
+
+            /* Next PC comes from the branch predictor, the history and return
+             * stack a branch was fetched with travel with it so a mispredict can
+             * restore them */
+            branch_predictor_snapshot(&cpu->bp, &cpu->fetch.bp_state);
+            cpu->pc = branch_predictor_next_pc(&cpu->bp, cpu->pc, current_ins->opcode);
+            cpu->fetch.predicted_pc = cpu->pc;
+
+            /* Copy data from fetch latch to decode latch, or behind the older
+             * instructions in the fetch buffer */
+            if (!cpu->fetch_buffer_count && group_count(cpu->decode_rename) < width)
             {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.is_src2_register_required=1;
-                cpu->decode_rename.is_memory_insn=1;
-                cpu->decode_rename.fu=INT_FU;
-                cpu->decode_rename.memory_instruction_type=STORE_INS;
-                break;
+                cpu->decode_rename[group_count(cpu->decode_rename)] = cpu->fetch;
             }
-
-            case OPCODE_BZ:
+            else
             {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
+                cpu->fetch_buffer[(cpu->fetch_buffer_head + cpu->fetch_buffer_count) %
+                                  cpu->config.fetch_buffer_size] = cpu->fetch;
+                cpu->fetch_buffer_count++;
             }
 
-            case OPCODE_BNZ:
-            {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
-            }
-            
-            case OPCODE_BP:
+            if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
             {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
+                print_stage_content(cpu, "Fetch", &cpu->fetch);
             }
 
-            case OPCODE_BNP:
+            /* Stop fetching new instructions if HALT is fetched */
+            if (cpu->fetch.opcode == OPCODE_HALT)
             {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
-            }
-            case OPCODE_CMP:
-            {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.is_src2_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
-            }
-             case OPCODE_JUMP:
-            {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
-            }
-            case OPCODE_JALR:
-            {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
+                cpu->fetch.has_insn = FALSE;
             }
 
-            case OPCODE_MOVC:
-            {
-                cpu->decode_rename.is_physical_register_required=1;
-                cpu->decode_rename.fu=INT_FU;
-
-                break;
-            }
-            case OPCODE_RET:
+            /* The target of a taken branch is fetched in the next cycle */
+            if (cpu->pc != cpu->fetch.pc + 4)
             {
-                cpu->decode_rename.is_src1_register_required=1;
-                cpu->decode_rename.fu=BRANCH_FU;
-                break;
-            }
-            case OPCODE_HALT:
-            {
-                cpu->decode_rename.fu=INT_FU;
-                break;
+                return;
             }
         }
-        //checking the resources (availabilty of free physical register, iq entry and lsq entry)
-    
-        // int temp_iq_index=issue_buffer_available_index(&cpu->iq);
-        // if(temp_iq_index!=-1)
-        //     cpu->decode_rename.issue_queue_index=temp_iq_index;
-        // else
-        //     cpu->decode_rename.is_stage_stalled=1;
-        
-        // //check rob availabolity
-
-        // //check lsq availability if it is memry instruction
-
-
+    }
+}
+//// first ROB---> LSQ--->Issue_queue/////
+/*
+ * Decode Stage of APEX Pipeline
+ *
+ * Passes up to dispatch_width instructions on to rename, as many as the
+ * rename group has room for
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static void
+APEX_decode_rename(APEX_CPU *cpu)
+{
+    const APEX_Instruction *ins;
+    int count = group_count(cpu->decode_rename);
+    int moved;
 
+    /* Operand and unit requirements were decoded when the program was loaded */
+    for (int i = 0; i < count; i++)
+    {
+        CPU_Stage *stage = &cpu->decode_rename[i];
 
+        ins = &cpu->code_memory[get_code_memory_index_from_pc(stage->pc)];
+        stage->is_physical_register_required=ins->is_physical_register_required;
+        stage->is_src1_register_required=ins->is_src1_register_required;
+        stage->is_src2_register_required=ins->is_src2_register_required;
+        stage->is_memory_insn=ins->is_memory_insn;
+        //mul_opcodes moves opcodes between the integer and multiply units
+        stage->fu=ins->fu;
+        if(ins->fu!=BRANCH_FU){
+            stage->fu=(cpu->config.mul_opcodes>>ins->opcode)&1?MUL_FU:INT_FU;
+        }
+        if(ins->is_memory_insn){
+            stage->memory_instruction_type=ins->memory_instruction_type;
+        }
+    }
 
+    /* Copy data from decode latch to execute latch*/
+    moved = group_advance(cpu->decode_rename, cpu->rename_dispatch,
+                          stage_width(cpu, cpu->config.dispatch_width));
 
-        /* Copy data from decode latch to execute latch*/
-        cpu->rename_dispatch = cpu->decode_rename;
-        cpu->decode_rename.has_insn = FALSE;
+    if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+    {
+        int in_rename = group_count(cpu->rename_dispatch);
 
-        if (ENABLE_DEBUG_MESSAGES)
+        for (int i = in_rename - moved; i < in_rename; i++)
         {
-            print_stage_content("Decode_Rename", &cpu->decode_rename);
+            print_stage_content(cpu, "Decode_Rename", &cpu->rename_dispatch[i]);
         }
     }
 }
 
 static void
-
 APEX_rename_dispatch(APEX_CPU *cpu)
 {
-    //check availabity of iq_entry
-    if(cpu->rename_dispatch.has_insn){
-        // if(cpu->rename_dispatch.opcode==OPCODE_RET){
-        //     if(cpu->rnt.rename_table[cpu->rename_dispatch.rs1].register_source){
-        //         if(cpu->prf.physical_register [cpu->rnt.rename_table[cpu->rename_dispatch.rs1].mapped_to_physical_register].reg_valid){
-        //             cpu->pc= cpu->prf.physical_register [cpu->rnt.rename_table[cpu->rename_dispatch.rs1].mapped_to_physical_register].reg_value;
-                    
-        //             cpu->rename_dispatch.is_stage_stalled=0;
-        //         }
-        //         else{
-        //             cpu->rename_dispatch.is_stage_stalled=1;
-        //         }
-        //     }
-        //     else{
-        //         cpu->pc= cpu->arf.architectural_register_file[cpu->rename_dispatch.rs1].value;
-        //     }
-        //      printf("RETURNED TO PC: %d\n",cpu->pc);
-            
-        // }
-    cpu->queue_entry=cpu->rename_dispatch;
-    cpu->rename_dispatch.has_insn = FALSE;
-    if (ENABLE_DEBUG_MESSAGES)
+    int moved = group_advance(cpu->rename_dispatch, cpu->queue_entry,
+                              stage_width(cpu, cpu->config.dispatch_width));
+
+    if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+    {
+        int in_queue = group_count(cpu->queue_entry);
+
+        for (int i = in_queue - moved; i < in_queue; i++)
         {
-            print_stage_content("Rename_Dispatch", &cpu->rename_dispatch);
+            print_stage_content(cpu, "Rename_Dispatch", &cpu->queue_entry[i]);
         }
     }
 }
 
 
-static void APEX_queue_entry_addition(APEX_CPU *cpu)
+/* Squashes every fetched instruction behind the oldest keep of the dispatch
+ * group, fetch goes on from cpu->pc */
+static void
+squash_front_end(APEX_CPU *cpu, int keep)
 {
-if(cpu->queue_entry.has_insn)
+    cpu->fetch_buffer_count = 0;
+    group_clear(cpu->decode_rename);
+    group_clear(cpu->rename_dispatch);
+    for (int i = keep; i < MAX_MACHINE_WIDTH; i++)
     {
-    
-    if(cpu->queue_entry.opcode==OPCODE_RET){
-        //cpu->rename_dispatch.is_stage_stalled=1;
-        if(reorder_buffer_available(&cpu->rob) ==-1){
-            cpu->rename_dispatch.is_stage_stalled=1;
-            return;
-        }
-        else{
-            if(cpu->rnt.rename_table[cpu->queue_entry.rs1].register_source){
-                if(cpu->prf.physical_register [cpu->rnt.rename_table[cpu->queue_entry.rs1].mapped_to_physical_register].reg_valid){
-                    cpu->pc= cpu->prf.physical_register [cpu->rnt.rename_table[cpu->queue_entry.rs1].mapped_to_physical_register].reg_value;
-                    cpu->decode_rename.has_insn=FALSE;
-                    cpu->rename_dispatch.has_insn=FALSE;
-                    cpu->queue_entry.is_stage_stalled=0;
-                }
-                else{
-                    cpu->queue_entry.is_stage_stalled=1;
-                }
-            }
-            else{
-                cpu->pc= cpu->arf.architectural_register_file[cpu->queue_entry.rs1].value;
-                cpu->decode_rename.has_insn=FALSE;
-                cpu->rename_dispatch.has_insn=FALSE;
-            }
-             printf("RETURNED TO PC: %d\n",cpu->pc);
-            
+        cpu->queue_entry[i].has_insn = FALSE;
+        cpu->queue_entry[i].is_stage_stalled = 0;
+    }
+}
 
-        //provide rob_entry and return
-            cpu->queue_entry.temp_rob_entry.pc_value=cpu->queue_entry.pc;
-            cpu->queue_entry.temp_rob_entry.destination_address=cpu->queue_entry.rd;
-            //check if physical register is corectly populated
-            cpu->queue_entry.temp_rob_entry.physical_register=cpu->queue_entry.phy_rd;
-            cpu->queue_entry.temp_rob_entry.status_bit=1;
-            cpu->queue_entry.temp_rob_entry.store_value_valid=0;
-            cpu->queue_entry.temp_rob_entry.opcode=cpu->queue_entry.opcode;
-            cpu->queue_entry.temp_rob_entry.insn_type=BRANCH_FU;
-            reorder_buffer_entry_addition_to_queue(&cpu->rob,&cpu->queue_entry.temp_rob_entry);
-            cpu->queue_entry.has_insn=FALSE;
-            return;
+/* Without a predictor there is no return address stack, RET then reads its
+ * register at dispatch and redirects fetch from there */
+static int
+ret_resolves_at_dispatch(const APEX_CPU *cpu)
+{
+    return cpu->bp.kind == BP_NONE;
+}
+
+/* Branches that may redirect fetch hold a rename checkpoint until they resolve,
+ * a RET resolved at dispatch never gets that far */
+static int
+takes_rename_checkpoint(int opcode)
+{
+    return opcode == OPCODE_BZ || opcode == OPCODE_BNZ || opcode == OPCODE_BP ||
+           opcode == OPCODE_BNP || opcode == OPCODE_JUMP || opcode == OPCODE_JALR ||
+           opcode == OPCODE_RET;
+}
+
+/*
+ * Checks whether insn lacks a ROB, IQ or LSQ entry, a physical register or a
+ * rename checkpoint, and charges cycles stalled cycles to each missing
+ * resource in cpu->stats
+ */
+static int
+dispatch_blocked(APEX_CPU *cpu, const CPU_Stage *insn, long cycles)
+{
+    int rob_free=reorder_buffer_available(&cpu->rob)!=-1;
+    int iq_free=issue_buffer_index_available(&cpu->iq)!=-1;
+    int lsq_free=!insn->is_memory_insn || lsq_index_available(&cpu->lsq)!=-1;
+    int prf_free=!insn->is_physical_register_required || !cpu->free_prf_q.is_empty;
+    int checkpoint_free=!takes_rename_checkpoint(insn->opcode) ||
+                        rename_checkpoint_available(&cpu->checkpoints)!=-1;
+
+    if(rob_free && iq_free && lsq_free && prf_free && checkpoint_free){
+        return FALSE;
+    }
+    if(!rob_free)
+        cpu->stats.rob_full_stalls+=cycles;
+    if(!iq_free)
+        cpu->stats.iq_full_stalls+=cycles;
+    if(!lsq_free)
+        cpu->stats.lsq_full_stalls+=cycles;
+    if(!prf_free)
+        cpu->stats.prf_empty_stalls+=cycles;
+    if(!checkpoint_free)
+        cpu->stats.checkpoint_full_stalls+=cycles;
+    return TRUE;
+}
+
+/*
+ * Renames and dispatches one instruction of the dispatch group, returns TRUE
+ * when it left the group and FALSE when it has to wait
+ */
+static int
+dispatch_instruction(APEX_CPU *cpu, CPU_Stage *insn)
+{
+    reorder_buffer_entry rob_entry = {0};
+    issue_queue_entry iq_entry = {0};
+    load_store_queue_entry lsq_entry = {0};
+
+if(insn->has_insn)
+    {
+    //with a return address stack RET was predicted at fetch and is checked
+    //by the branch unit like JALR
+    if(insn->opcode==OPCODE_RET && ret_resolves_at_dispatch(cpu)){
+        if(reorder_buffer_available(&cpu->rob) ==-1){
+            insn->is_stage_stalled=1;
+            cpu->stats.rob_full_stalls++;
+            return FALSE;
         }
+        else{
+            if(cpu->rnt.rename_table[insn->rs1].register_source){
+                if(cpu->prf.physical_register [cpu->rnt.rename_table[insn->rs1].mapped_to_physical_register].reg_valid){
+                    cpu->pc= cpu->prf.physical_register [cpu->rnt.rename_table[insn->rs1].mapped_to_physical_register].reg_value;
+                    insn->is_stage_stalled=0;
+                }
+                else{
+                    //wait here for the return address
+                    insn->is_stage_stalled=1;
+                    return FALSE;
+                }
+            }
+            else{
+                cpu->pc= cpu->arf.architectural_register_file[insn->rs1].value;
+            }
+             APEX_LOG(cpu, VERBOSITY_FULL, "RETURNED TO PC: %d\n",cpu->pc);
+            //the instructions fetched after RET are dropped
+            squash_front_end(cpu, 1);
+            cpu->fetch.has_insn=TRUE;
+            branch_predictor_recover(&cpu->bp, insn->pc, OPCODE_RET, &insn->bp_state, 1);
             
+
+        //provide rob_entry and return
+            rob_entry.pc_value=insn->pc;
+            rob_entry.destination_address=insn->rd;
+            //RET has no destination register
+            rob_entry.physical_register=100;
+            rob_entry.status_bit=1;
+            rob_entry.store_value_valid=0;
+            rob_entry.opcode=insn->opcode;
+            rob_entry.insn_type=BRANCH_FU;
+            rob_entry.mispredicted=1;
+            reorder_buffer_entry_addition_to_queue(&cpu->rob,&rob_entry);
+            APEX_LOG(cpu, VERBOSITY_FULL, "ROB entry created for I[%d] \n", (rob_entry.pc_value-4000)/4);
+            return TRUE;
+        }
+            
+    }
+
+    //dispatch only when every resource the instruction needs is free, otherwise
+    //hold it in this latch, which stalls rename_dispatch, decode and fetch
+    if(dispatch_blocked(cpu, insn, 1)){
+        insn->is_stage_stalled=1;
+        return FALSE;
     }
+    insn->is_stage_stalled=0;
 
-    cpu->queue_entry.rs1_ready=1;
-        cpu->queue_entry.rs2_ready=1;
-        if(cpu->queue_entry.is_src1_register_required){
+    insn->rs1_ready=1;
+        insn->rs2_ready=1;
+        if(insn->is_src1_register_required){
             int temp_physcial_src1=100;
             //if need to reaad the content from physical register
-            if(cpu->rnt.rename_table[cpu->queue_entry.rs1].register_source){
-                temp_physcial_src1=cpu->rnt.rename_table[cpu->queue_entry.rs1].mapped_to_physical_register;
+            if(cpu->rnt.rename_table[insn->rs1].register_source){
+                temp_physcial_src1=cpu->rnt.rename_table[insn->rs1].mapped_to_physical_register;
                 //if physical register content is valid then read the value 
                 if(cpu->prf.physical_register[temp_physcial_src1].reg_valid){
-                    cpu->queue_entry.rs1_value=cpu->prf.physical_register[temp_physcial_src1].reg_value;
-                    cpu->queue_entry.phy_rs1=temp_physcial_src1;
-                    cpu->queue_entry.rs1_ready=1;
+                    insn->rs1_value=cpu->prf.physical_register[temp_physcial_src1].reg_value;
+                    insn->phy_rs1=temp_physcial_src1;
+                    insn->rs1_ready=1;
                 }
                 //if physical register content is invalid  then read the prf  from which it  need to be read  
                 else{
-                    cpu->queue_entry.phy_rs1=temp_physcial_src1;
-                    cpu->queue_entry.rs1_ready=0;
+                    insn->phy_rs1=temp_physcial_src1;
+                    insn->rs1_ready=0;
                 }
             }
             //read from architectural register 
             else{
-                 cpu->queue_entry.rs1_value= cpu->arf.architectural_register_file[cpu->queue_entry.rs1].value;
-                 cpu->queue_entry.rs1_ready=1;
-            }
-            if (cpu->queue_entry.opcode == OPCODE_JUMP || cpu->queue_entry.opcode == OPCODE_JALR || cpu->queue_entry.opcode == OPCODE_RET)
-            {
-                create_mri_backup(cpu);
-                create_rename_table_backup(cpu);
+                 insn->rs1_value= cpu->arf.architectural_register_file[insn->rs1].value;
+                 insn->rs1_ready=1;
             }
             //if opcode is bz or bnz or bp or bnp then check the condition
-            if (cpu->queue_entry.opcode == OPCODE_BZ || cpu->queue_entry.opcode == OPCODE_BNZ || cpu->queue_entry.opcode == OPCODE_BP || cpu->queue_entry.opcode == OPCODE_BNP)
+            if (insn->opcode == OPCODE_BZ || insn->opcode == OPCODE_BNZ || insn->opcode == OPCODE_BP || insn->opcode == OPCODE_BNP)
             {
-                //create a backup of mri and rnt
-                create_mri_backup(cpu);
-                create_rename_table_backup(cpu);
                 //read the rename table last entry
                 if(cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].register_source){
                     temp_physcial_src1=cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register;
                     //if physical register content is valid then read the value 
                     if(cpu->prf.physical_register[temp_physcial_src1].reg_valid){
-                        cpu->queue_entry.rs1_value=cpu->prf.physical_register[temp_physcial_src1].reg_value;
-                        cpu->queue_entry.phy_rs1=temp_physcial_src1;
-                        cpu->queue_entry.rs1_ready=1;
+                        insn->rs1_value=cpu->prf.physical_register[temp_physcial_src1].reg_value;
+                        insn->phy_rs1=temp_physcial_src1;
+                        insn->rs1_ready=1;
                     }
                     else{
-                        cpu->queue_entry.phy_rs1=temp_physcial_src1;
-                        cpu->queue_entry.rs1_ready=0;
+                        insn->phy_rs1=temp_physcial_src1;
+                        insn->rs1_ready=0;
                     }
                 }
                 else{
-                        cpu->queue_entry.rs1_value=  cpu->arf.architectural_register_file[cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].value].value;
-                        cpu->queue_entry.rs1_ready=1;
+                        insn->rs1_value=  cpu->arf.architectural_register_file[cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].value].value;
+                        insn->rs1_ready=1;
                     }
             }
 
         }
 
-        if(cpu->queue_entry.is_src2_register_required){
+        if(insn->is_src2_register_required){
             int temp_physcial_src2=100;
-            if(cpu->rnt.rename_table[cpu->queue_entry.rs2].register_source){
-                temp_physcial_src2=cpu->rnt.rename_table[cpu->queue_entry.rs2].mapped_to_physical_register;
+            if(cpu->rnt.rename_table[insn->rs2].register_source){
+                temp_physcial_src2=cpu->rnt.rename_table[insn->rs2].mapped_to_physical_register;
                 if(cpu->prf.physical_register[temp_physcial_src2].reg_valid){
-                    cpu->queue_entry.rs2_value=cpu->prf.physical_register[temp_physcial_src2].reg_value;
-                    cpu->queue_entry.phy_rs2=temp_physcial_src2;
-                    cpu->queue_entry.rs2_ready=1;
+                    insn->rs2_value=cpu->prf.physical_register[temp_physcial_src2].reg_value;
+                    insn->phy_rs2=temp_physcial_src2;
+                    insn->rs2_ready=1;
                 }
                 else{
-                    cpu->queue_entry.phy_rs2=temp_physcial_src2;
-                    cpu->queue_entry.rs2_ready=0;
+                    insn->phy_rs2=temp_physcial_src2;
+                    insn->rs2_ready=0;
                 }
             }
             else{
-                 cpu->queue_entry.rs2_value= cpu->arf.architectural_register_file[cpu->queue_entry.rs2].value;
-                 cpu->queue_entry.rs2_ready=1;
+                 insn->rs2_value= cpu->arf.architectural_register_file[insn->rs2].value;
+                 insn->rs2_ready=1;
             }
         }
 
-        cpu->queue_entry.phy_rd=100;//default value is set to 100 for phy_rd
+        insn->phy_rd=100;//default value is set to 100 for phy_rd
         //ccr update for cmp , assigned to last physical register
-        if (cpu->queue_entry.opcode==OPCODE_CMP){
-             cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register= PHYSICAL_REGISTERS_SIZE;
+        if (insn->opcode==OPCODE_CMP){
+             cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register= cpu->prf.size;
              cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].register_source=1;
              //check this code for cmp
-             cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]=PHYSICAL_REGISTERS_SIZE+2;
-             printf("MRP CCR=P%d\n", cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]);
+             cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]=cpu->prf.size+2;
+             APEX_LOG(cpu, VERBOSITY_FULL, "MRP CCR=P%d\n", cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]);
         }
 
-        if(cpu->queue_entry.is_physical_register_required){
+        if(insn->is_physical_register_required){
             int temp_rd=pop_free_physical_registers(&cpu->free_prf_q);
             if( temp_rd!= -1){
-                cpu->queue_entry.phy_rd =temp_rd;
-                cpu->rnt.rename_table[cpu->queue_entry.rd].mapped_to_physical_register=temp_rd;
-                cpu->rnt.rename_table[cpu->queue_entry.rd].register_source=1;
-                cpu->mri[cpu->queue_entry.rd]=temp_rd;
-                //if insn is add sub addl subl mul 
-                if( cpu->queue_entry.opcode==OPCODE_ADD || 
-                    cpu->queue_entry.opcode==OPCODE_ADDL || 
-                    cpu->queue_entry.opcode==OPCODE_SUB || 
-                    cpu->queue_entry.opcode==OPCODE_SUBL || 
-                    cpu->queue_entry.opcode==OPCODE_MUL){
+                insn->phy_rd =temp_rd;
+                //a recycled register still holds the value of its last owner
+                cpu->prf.physical_register[temp_rd].reg_valid=0;
+                cpu->rnt.rename_table[insn->rd].mapped_to_physical_register=temp_rd;
+                cpu->rnt.rename_table[insn->rd].register_source=1;
+                cpu->mri[insn->rd]=temp_rd;
+                //if insn is add sub addl subl mul div, as commit sets the ccr for these
+                if( insn->opcode==OPCODE_ADD || 
+                    insn->opcode==OPCODE_ADDL || 
+                    insn->opcode==OPCODE_SUB || 
+                    insn->opcode==OPCODE_SUBL || 
+                    insn->opcode==OPCODE_MUL ||
+                    insn->opcode==OPCODE_DIV){
                        cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register=temp_rd;
                        cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].register_source=1;
                        cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]=temp_rd;
-                       printf("MRP CCR=P%d\n", cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]);
+                       APEX_LOG(cpu, VERBOSITY_FULL, "MRP CCR=P%d\n", cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]);
                     }
-                printf("Physical Reg Allocation: +P[%d]\n",cpu->queue_entry.phy_rd);
-                printf("RNT change R[%d]=p[%d]\n", cpu->queue_entry.rd,cpu->queue_entry.phy_rd);
+                APEX_LOG(cpu, VERBOSITY_FULL, "Physical Reg Allocation: +P[%d]\n",insn->phy_rd);
+                APEX_LOG(cpu, VERBOSITY_FULL, "RNT change R[%d]=p[%d]\n", insn->rd,insn->phy_rd);
             }
-            else  //setting the stalling variable to 1 if no free physical register available
-                cpu->queue_entry.is_stage_stalled=1;
         }
             int temp_iq_index=issue_buffer_index_available(&cpu->iq);
         //printf("%d",temp_iq_index);
         int temp_lsq_index=100;
-        if(cpu->queue_entry.is_memory_insn){
+        if(insn->is_memory_insn){
             temp_lsq_index=lsq_index_available(&cpu->lsq);
         }
         int temp_rob_index=reorder_buffer_available(&cpu->rob);
         if(temp_iq_index!=-1 && temp_lsq_index!=-1 && temp_rob_index!=-1){
            //temp lsq entry , rob entry and iq entry are available
-            cpu->queue_entry.temp_iq_entry.dest_tag=cpu->queue_entry.phy_rd;
-            cpu->queue_entry.temp_iq_entry.src1_tag=cpu->queue_entry.phy_rs1;
-            cpu->queue_entry.temp_iq_entry.src2_tag=cpu->queue_entry.phy_rs2;
-            cpu->queue_entry.temp_iq_entry.src1_valid=cpu->queue_entry.rs1_ready;
-            cpu->queue_entry.temp_iq_entry.src2_valid=cpu->queue_entry.rs2_ready;
-            cpu->queue_entry.temp_iq_entry.src1_value=cpu->queue_entry.rs1_value;
-            cpu->queue_entry.temp_iq_entry.src2_value=cpu->queue_entry.rs2_value;
-            cpu->queue_entry.temp_iq_entry.FU=cpu->queue_entry.fu;
-            cpu->queue_entry.temp_iq_entry.immediate_literal=cpu->queue_entry.imm;
-            cpu->queue_entry.temp_iq_entry.is_allocated=1;
-            cpu->queue_entry.temp_iq_entry.rob_index=temp_rob_index;
-            cpu->queue_entry.temp_iq_entry.lsq_index=temp_lsq_index;
-            cpu->queue_entry.temp_iq_entry.opcode=cpu->queue_entry.opcode;
-            cpu->queue_entry.temp_iq_entry.pc_value=cpu->queue_entry.pc;
-            cpu->queue_entry.temp_iq_entry.counter=0;
-            cpu->queue_entry.issue_queue_index=temp_iq_index;
-            cpu->queue_entry.temp_rob_entry.insn_type=cpu->queue_entry.fu;
-
-            if(temp_lsq_index!=100 && temp_lsq_index != -1){
-                cpu->queue_entry.temp_lsq_entry.allocate=1;
-                cpu->queue_entry.temp_lsq_entry.instruction_type=cpu->queue_entry.memory_instruction_type;
-                cpu->queue_entry.temp_lsq_entry.address_valid=0;
-                cpu->queue_entry.temp_lsq_entry.data_ready=0;
-                cpu->queue_entry.temp_lsq_entry.OPCODE=cpu->queue_entry.opcode;
-                cpu->queue_entry.temp_lsq_entry.data_ready=cpu->queue_entry.rs1_ready;
-                cpu->queue_entry.temp_lsq_entry.value_to_be_stored=cpu->queue_entry.rs1_value;
-                cpu->queue_entry.temp_lsq_entry.src1_store=cpu->queue_entry.phy_rs1;
-                cpu->queue_entry.temp_rob_entry.insn_type=3;
-                cpu->queue_entry.temp_lsq_entry.pc_value=cpu->queue_entry.pc;
-                cpu->queue_entry.temp_lsq_entry.phy_destination_address_for_load=cpu->queue_entry.phy_rd;
-                cpu->queue_entry.temp_lsq_entry.destination_address_for_load=cpu->queue_entry.rd;
+            iq_entry.dest_tag=insn->phy_rd;
+            iq_entry.src1_tag=insn->phy_rs1;
+            iq_entry.src2_tag=insn->phy_rs2;
+            iq_entry.src1_valid=insn->rs1_ready;
+            iq_entry.src2_valid=insn->rs2_ready;
+            iq_entry.src1_value=insn->rs1_value;
+            iq_entry.src2_value=insn->rs2_value;
+            iq_entry.FU=insn->fu;
+            iq_entry.immediate_literal=insn->imm;
+            iq_entry.is_allocated=1;
+            iq_entry.rob_index=temp_rob_index;
+            iq_entry.lsq_index=temp_lsq_index;
+            iq_entry.opcode=insn->opcode;
+            iq_entry.pc_value=insn->pc;
+            iq_entry.predicted_pc=insn->predicted_pc;
+            iq_entry.bp_state=insn->bp_state;
+            insn->issue_queue_index=temp_iq_index;
+            rob_entry.insn_type=insn->fu;
+
+            if(insn->is_memory_insn && temp_lsq_index != -1){
+                lsq_entry.allocate=1;
+                lsq_entry.instruction_type=insn->memory_instruction_type;
+                lsq_entry.address_valid=0;
+                lsq_entry.data_ready=0;
+                lsq_entry.OPCODE=insn->opcode;
+                lsq_entry.data_ready=insn->rs1_ready;
+                lsq_entry.value_to_be_stored=insn->rs1_value;
+                lsq_entry.src1_store=insn->phy_rs1;
+                rob_entry.insn_type=3;
+                lsq_entry.pc_value=insn->pc;
+                lsq_entry.phy_destination_address_for_load=insn->phy_rd;
+                lsq_entry.destination_address_for_load=insn->rd;
+                lsq_entry.bp_state=insn->bp_state;
             }
             
             //check the pc value later
-            cpu->queue_entry.temp_rob_entry.pc_value=cpu->queue_entry.pc;
-            cpu->queue_entry.temp_rob_entry.destination_address=cpu->queue_entry.rd;
+            rob_entry.pc_value=insn->pc;
+            rob_entry.destination_address=insn->rd;
             //check if physical register is corectly populated
-            cpu->queue_entry.temp_rob_entry.physical_register=cpu->queue_entry.phy_rd;
-            cpu->queue_entry.temp_rob_entry.status_bit=0;
-            cpu->queue_entry.temp_rob_entry.store_value_valid=0;
-            cpu->queue_entry.temp_rob_entry.opcode=cpu->queue_entry.opcode;
+            rob_entry.physical_register=insn->phy_rd;
+            rob_entry.status_bit=0;
+            rob_entry.store_value_valid=0;
+            rob_entry.opcode=insn->opcode;
 
             //
         }
-        else{
-            cpu->rename_dispatch.is_stage_stalled=1;
-        } 
-        //print_iq_indexes(&cpu->iq);
+        //print_iq_indexes(&cpu->iq, cpu->trace_out);
     int rob_index,lsq_index;
     lsq_index=100;
-        rob_index= reorder_buffer_entry_addition_to_queue(&cpu->rob,&cpu->queue_entry.temp_rob_entry);
-        if(cpu->queue_entry.is_memory_insn){
-            cpu->queue_entry.temp_lsq_entry.rob_index=rob_index;
-            lsq_index=lsq_entry_addition_to_queue(&cpu->lsq,&cpu->queue_entry.temp_lsq_entry);
+        rob_index= reorder_buffer_entry_addition_to_queue(&cpu->rob,&rob_entry);
+        APEX_LOG(cpu, VERBOSITY_FULL, "ROB entry created for I[%d] \n", (rob_entry.pc_value-4000)/4);
+        if(insn->is_memory_insn){
+            lsq_entry.rob_index=rob_index;
+            lsq_index=lsq_entry_addition_to_queue(&cpu->lsq,&lsq_entry);
+            APEX_LOG(cpu, VERBOSITY_FULL, "LSQ tail= I[%d] ", (cpu->lsq.load_store_queue[lsq_index].pc_value-4000)/4);
+            APEX_LOG(cpu, VERBOSITY_FULL, "LSQ head= I[%d] \n", (cpu->lsq.load_store_queue[cpu->lsq.head].pc_value-4000)/4);
         }
-        cpu->queue_entry.temp_iq_entry.rob_index=rob_index;
-        cpu->queue_entry.temp_iq_entry.lsq_index=lsq_index;
-        iq_entry_addition(&cpu->iq,&cpu->queue_entry.temp_iq_entry,cpu->queue_entry.issue_queue_index);
+        iq_entry.rob_index=rob_index;
+        iq_entry.lsq_index=lsq_index;
+        iq_entry_addition(&cpu->iq,&iq_entry,insn->issue_queue_index);
 
-        printf("IQ + I[%d]\n", (cpu->queue_entry.pc-4000)/4);
+        APEX_LOG(cpu, VERBOSITY_FULL, "IQ + I[%d]\n", (insn->pc-4000)/4);
 
-        //print_rob_entries(&cpu->rob);
+        //print_rob_entries(&cpu->rob, cpu->trace_out);
         //cpu->process_iq=cpu->queue_entry;
         //printf("%d",cpu->int_fu.imm);
-        cpu->queue_entry.has_insn = FALSE;
     
-    if(cpu->queue_entry.opcode==OPCODE_JALR){
-            create_mri_backup(cpu);
-            create_rename_table_backup(cpu);
-
+    //the checkpoint is taken after the branch renamed, so a mispredicted
+    //JALR keeps its own destination register
+    if(takes_rename_checkpoint(insn->opcode)){
+        rename_checkpoint_take(&cpu->checkpoints, rob_index, &cpu->rnt, cpu->mri, &cpu->free_prf_q);
+    }
+    //a load behind a store of unknown address may go to memory first if a
+    //free checkpoint lets it replay, otherwise it waits for the address
+    else if(insn->opcode==OPCODE_LOAD && cpu->config.memory_dependence!=MD_WAIT &&
+            lsq_unknown_store_before(&cpu->lsq, lsq_index) &&
+            rename_checkpoint_take(&cpu->checkpoints, rob_index, &cpu->rnt, cpu->mri, &cpu->free_prf_q)!=-1){
+        cpu->lsq.load_store_queue[lsq_index].speculative=1;
     }
         
-    //print_iq_entries(&cpu->iq);
-    if (ENABLE_DEBUG_MESSAGES)
+    //print_iq_entries(&cpu->iq, cpu->trace_out);
+    if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
         {
-            print_stage_content("All queue entry", &cpu->queue_entry);
+            print_stage_content(cpu, "All queue entry", insn);
         }
     }
+    return TRUE;
 }
 
-void push_information_to_fu(APEX_CPU *cpu, int index, int fu){
-    switch (fu)
+/*
+ * Dispatches the dispatch group in program order, up to dispatch_width
+ * instructions a cycle. Each one renames after the older ones of its group,
+ * so a source written earlier in the same group maps to the physical
+ * register of that instruction, as the intra-group dependency check of a
+ * wide renamer would. The first instruction that has to wait holds back
+ * every younger one.
+ */
+static void
+APEX_queue_entry_addition(APEX_CPU *cpu)
+{
+    int width = stage_width(cpu, cpu->config.dispatch_width);
+
+    for (int n = 0; n < width && cpu->queue_entry[0].has_insn; n++)
     {
-    //addition fu
-    case INT_FU:
-        cpu->int_fu.rs1_value=cpu->iq.issue_queue[index].src1_value;
-        cpu->int_fu.rs2_value=cpu->iq.issue_queue[index].src2_value;
-        cpu->int_fu.phy_rd=cpu->iq.issue_queue[index].dest_tag;
-        cpu->int_fu.rob_index=cpu->iq.issue_queue[index].rob_index;
-        cpu->int_fu.lsq_index=cpu->iq.issue_queue[index].lsq_index;
-        cpu->int_fu.opcode=cpu->iq.issue_queue[index].opcode;
-        cpu->int_fu.has_insn=1;
-        cpu->int_fu.imm=cpu->iq.issue_queue[index].immediate_literal;
-        cpu->iq.issue_queue[index].is_allocated=0;
-        cpu->int_fu.pc=cpu->iq.issue_queue[index].pc_value;
-        break;
-    //multiplication fu
-    case MUL_FU:
-        cpu->mul1_fu.rs1_value=cpu->iq.issue_queue[index].src1_value;
-        cpu->mul1_fu.rs2_value=cpu->iq.issue_queue[index].src2_value;
-        cpu->mul1_fu.phy_rd=cpu->iq.issue_queue[index].dest_tag;
-        cpu->mul1_fu.rob_index=cpu->iq.issue_queue[index].rob_index;
-        cpu->mul1_fu.lsq_index=cpu->iq.issue_queue[index].lsq_index;
-        cpu->mul1_fu.opcode=cpu->iq.issue_queue[index].opcode;
-        cpu->mul1_fu.has_insn=1;
-        cpu->iq.issue_queue[index].is_allocated=0;
-        cpu->mul1_fu.pc=cpu->iq.issue_queue[index].pc_value;
-
-        break;
-    //branch fu
-    case BRANCH_FU:
-        cpu->bu_fu.rs1_value=cpu->iq.issue_queue[index].src1_value;
-        cpu->bu_fu.rs2_value=cpu->iq.issue_queue[index].src2_value;
-        cpu->bu_fu.imm=cpu->iq.issue_queue[index].immediate_literal;
-        cpu->bu_fu.phy_rd=cpu->iq.issue_queue[index].dest_tag;
-        cpu->bu_fu.rob_index=cpu->iq.issue_queue[index].rob_index;
-        cpu->bu_fu.lsq_index=cpu->iq.issue_queue[index].lsq_index;
-        cpu->bu_fu.opcode=cpu->iq.issue_queue[index].opcode;
-        cpu->bu_fu.has_insn=1;
-        cpu->iq.issue_queue[index].is_allocated=0;
-        cpu->bu_fu.pc=cpu->iq.issue_queue[index].pc_value;
-        break;
-    default:
-        break;
-    }
-    printf("IQ - I[%d]\n", (cpu->iq.issue_queue[index].pc_value-4000)/4);
-
-}
-
-void APEX_bu_fu(APEX_CPU *cpu){
-    if(cpu->bu_fu.has_insn){
-        cpu->bu_fu.need_to_flush=0;
-        switch (cpu->bu_fu.opcode)
+        if (!dispatch_instruction(cpu, &cpu->queue_entry[0]))
+        {
+            for (int i = 1; i < group_count(cpu->queue_entry); i++)
+            {
+                cpu->queue_entry[i].is_stage_stalled = 1;
+            }
+            return;
+        }
+        group_remove(cpu->queue_entry, 1);
+    }
+}
+
+/* Trace labels of the latches of each functional unit class */
+static const char *const fu_stage_names[NUM_FU_CLASSES] = {
+    "Integer Functional Unit", "MUL FU", "BU FU", "Memory",
+};
+static const char *const fu_fwd_names[NUM_FU_CLASSES] = {
+    "Integer forward Bus", "Mul fwd bus", "BU Fwd", "Memory forward Bus",
+};
+static const char *const fu_writeback_names[NUM_FU_CLASSES] = {
+    "Integer WB", "Multiplication WB", "Branch WB", "Memory WB",
+};
+
+//prints a latch of a unit, name gets the stage number when the unit has
+//several stages (stage -1 for the forward and writeback latches) and the
+//unit number when its class has several units
+static void print_unit_latch(const APEX_CPU *cpu, const functional_unit *fu,
+                             const char *name, int stage, const CPU_Stage *latch){
+    char label[64];
+    int len=snprintf(label, sizeof(label), "%s", name);
+
+    if(stage>=0 && fu->num_stages>1){
+        len+=snprintf(label+len, sizeof(label)-len, "%d", stage+1);
+    }
+    if(cpu->fu_units[fu->fu_class]>1){
+        snprintf(label+len, sizeof(label)-len, " #%d", fu->index);
+    }
+    print_stage_content(cpu, label, latch);
+}
+
+//issues the issue queue entry at index to the first stage of fu
+void push_information_to_fu(APEX_CPU *cpu, int index, functional_unit *fu){
+    const issue_queue_entry *entry=&cpu->iq.issue_queue[index];
+    CPU_Stage *stage=&fu->stages[0];
+
+    stage->rs1_value=entry->src1_value;
+    stage->rs2_value=entry->src2_value;
+    stage->imm=entry->immediate_literal;
+    stage->phy_rd=entry->dest_tag;
+    stage->rob_index=entry->rob_index;
+    stage->lsq_index=entry->lsq_index;
+    stage->opcode=entry->opcode;
+    stage->pc=entry->pc_value;
+    //branches only, checked by the branch unit
+    stage->predicted_pc=entry->predicted_pc;
+    stage->bp_state=entry->bp_state;
+    stage->cycles=0;
+    stage->is_stage_stalled=0;
+    stage->fault=FAULT_NONE;
+    stage->has_insn=1;
+    APEX_LOG(cpu, VERBOSITY_FULL, "IQ - I[%d]\n", (entry->pc_value-4000)/4);
+    issue_queue_remove(&cpu->iq, index);
+
+}
+
+//resolves a branch and checks it against the pc fetched after it, only a
+//branch that fetch mispredicted flushes
+static void resolve_branch(APEX_CPU *cpu, CPU_Stage *stage){
+        int taken=0;
+        int target=stage->pc+stage->imm;
+        switch (stage->opcode)
         {
             case OPCODE_BZ:
-                if(cpu->bu_fu.rs1_value==0){
-                    cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.pc+cpu->bu_fu.imm;
-                    cpu->bu_fu.need_to_flush=1;
-                    cpu->fetch_from_next_cycle=TRUE;
-                    // cpu->fetch.has_insn=TRUE;
-                    //flush_instructions(cpu,cpu->bu_fu.rob_index);
-                }
+                taken=stage->rs1_value==0;
                 break;
             case OPCODE_BNZ:
-                if(cpu->bu_fu.rs1_value!=0){
-                    cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.pc+cpu->bu_fu.imm;
-                    //flush_instructions(cpu,cpu->bu_fu.rob_index);
-                    cpu->bu_fu.need_to_flush=1;
-                    //cpu->fetch_from_next_cycle=TRUE;
-                    //cpu->fetch.has_insn=TRUE;
-                }
+                taken=stage->rs1_value!=0;
                 break;
             case OPCODE_BP:
-                if(cpu->bu_fu.rs1_value>0){
-                    cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.pc+cpu->bu_fu.imm;
-                    cpu->bu_fu.need_to_flush=1;
-                    //cpu->fetch_from_next_cycle=TRUE;
-                    //cpu->fetch.has_insn=TRUE;
-                }
+                taken=stage->rs1_value>0;
                 break;
             case OPCODE_BNP:
-                if(cpu->bu_fu.rs1_value<0){
-                    cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.pc+cpu->bu_fu.imm;
-                    cpu->bu_fu.need_to_flush=1;
-                    //cpu->fetch_from_next_cycle=TRUE;
-                    //cpu->fetch.has_insn=TRUE;
-                }
+                taken=stage->rs1_value<0;
                 break;
             case OPCODE_JUMP:
             {
-                cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.rs1_value+cpu->bu_fu.imm;
-                cpu->bu_fu.need_to_flush=1;
-                //cpu->fetch_from_next_cycle=TRUE;
-                //cpu->fetch.has_insn=TRUE;
+                taken=1;
+                target=stage->rs1_value+stage->imm;
                 break;
             }
             case OPCODE_JALR:
             {
-                cpu->bu_fu.result_buffer=cpu->bu_fu.pc+4;
-                cpu->bu_fu.pc_value_to_be_taken=cpu->bu_fu.rs1_value+cpu->bu_fu.imm;
-                cpu->bu_fu.need_to_flush=1;
-                //cpu->fetch_from_next_cycle=TRUE;
-                //cpu->fetch.has_insn=TRUE;
+                stage->result_buffer=stage->pc+4;
+                taken=1;
+                target=stage->rs1_value+stage->imm;
                 break;
             }
+            case OPCODE_RET:
+                taken=1;
+                target=stage->rs1_value;
+                break;
             default:
                 break;
         }
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-                print_stage_content("BU FU", &cpu->bu_fu);
+        stage->pc_value_to_be_taken=taken?target:stage->pc+4;
+        stage->need_to_flush=stage->pc_value_to_be_taken!=stage->predicted_pc;
+        if(stage->need_to_flush && stage->opcode==OPCODE_BZ){
+            cpu->fetch_from_next_cycle=TRUE;
         }
-        cpu->bu_fwd=cpu->bu_fu;
-        cpu->bu_fu.has_insn=FALSE;
-    }
+        cpu->rob.reorder_buffer_queue[stage->rob_index].mispredicted=stage->need_to_flush;
+        branch_predictor_update(&cpu->bp, stage->pc, stage->opcode,
+                                &stage->bp_state, taken, target);
 }
 
+/* Moves the instructions in the units of a class on by a cycle, the last
+ * stage finishes an instruction and hands it to the unit's forward bus */
+void APEX_execute(APEX_CPU *cpu, int fu_class){
+    for(int u=0;u<cpu->fu_units[fu_class];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[fu_class]+u];
+        int last=fu->num_stages-1;
+        CPU_Stage *stage=&fu->stages[last];
+
+        if(stage->has_insn){
+            //an unpipelined unit holds the instruction for its whole latency
+            if(!fu->pipelined && stage->cycles<fu->latency-1){
+                stage->cycles++;
+                stage->is_stage_stalled=1;
+            }
+            else{
+                stage->cycles=0;
+                stage->is_stage_stalled=0;
+                if(fu_class==BRANCH_FU){
+                    resolve_branch(cpu, stage);
+                }
+                else{
+                    APEX_Execute_fn execute = cpu->code_memory[get_code_memory_index_from_pc(stage->pc)].execute;
 
+                    //HALT has nothing to compute
+                    if(execute){
+                        execute(stage);
+                    }
+                }
+                fu->fwd=*stage;
+                stage->has_insn=FALSE;
+            }
+            if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+            {
+                print_unit_latch(cpu, fu, fu_stage_names[fu_class], last, stage);
+            }
+        }
+        for(int i=last-1;i>=0;i--){
+            if(fu->stages[i].has_insn){
+                fu->stages[i+1]=fu->stages[i];
+                fu->stages[i].has_insn=FALSE;
+                if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+                {
+                    print_unit_latch(cpu, fu, fu_stage_names[fu_class], i, &fu->stages[i]);
+                }
+            }
+        }
+    }
+}
 
-void APEX_bu_fwd(APEX_CPU *cpu){
-    if(cpu->bu_fwd.has_insn){
-        if(cpu->bu_fwd.need_to_flush){
-            flush_instructions(cpu,cpu->bu_fwd.rob_index);
-            cpu->pc=cpu->bu_fwd.pc_value_to_be_taken;
+static void branch_fwd(APEX_CPU *cpu, functional_unit *fu){
+        if(fu->fwd.need_to_flush){
+            flush_instructions(cpu,fu->fwd.rob_index);
+            cpu->pc=fu->fwd.pc_value_to_be_taken;
             cpu->fetch.has_insn=TRUE;
+            branch_predictor_recover(&cpu->bp, fu->fwd.pc, fu->fwd.opcode, &fu->fwd.bp_state,
+                                     fu->fwd.pc_value_to_be_taken!=fu->fwd.pc+4);
         }
-        cpu->branch_writeback=cpu->bu_fwd;
-        cpu->bu_fwd.has_insn=FALSE;
-    if (ENABLE_DEBUG_MESSAGES)
-    {
-            print_stage_content("BU Fwd", &cpu->bu_fwd);
+        else{
+            int ckpt=rename_checkpoint_find(&cpu->checkpoints, fu->fwd.rob_index);
+            if(ckpt!=-1){
+                rename_checkpoint_release(&cpu->checkpoints, ckpt);
+            }
+        }
+        fu->writeback=fu->fwd;
+}
+
+//reads the page table entry of the next level of a walk through the data
+//caches, like a load of the first data cache would
+static void
+read_page_table_entry(APEX_CPU *cpu, page_walk *walk)
+{
+    int latency=cache_access(cpu, CACHE_L1D, mmu_entry_address(&cpu->mmu, walk->page, walk->level),
+                             FALSE, &walk->request);
+
+    walk->ready=walk->request==-1?cpu->clock+latency:latency;
+    walk->level++;
+}
+
+static void
+start_page_walk(APEX_CPU *cpu, page_walk *walk, int page)
+{
+    walk->page=page;
+    walk->level=0;
+    walk->start=cpu->clock;
+    APEX_LOG(cpu, VERBOSITY_FULL, "Page walk of page %d\n", page);
+    read_page_table_entry(cpu, walk);
+}
+
+//fills the TLBs with the page of a walk that read its leaf entry and lets
+//every lsq entry waiting for the page go to memory
+static void
+finish_page_walk(APEX_CPU *cpu, page_walk *walk)
+{
+    mmu *m=&cpu->mmu;
+    int address=walk->page*m->page_size;
+    cache_line victim;
+
+    if(!cache_probe(&m->dtlb, address)){
+        cache_fill(&m->dtlb, address, cpu->clock, &victim);
     }
+    if(cache_enabled(&m->l2_tlb) && !cache_probe(&m->l2_tlb, address)){
+        cache_fill(&m->l2_tlb, address, cpu->clock, &victim);
     }
+    for(int n=0,j=cpu->lsq.head;n<cpu->lsq.count;n++,j=(j+1)%cpu->lsq.size){
+        load_store_queue_entry *entry=&cpu->lsq.load_store_queue[j];
 
+        if(entry->translated==TRANSLATION_PENDING && mmu_page(m, entry->mem_address)==walk->page){
+            entry->translated=cpu->clock;
+        }
+    }
+    cpu->stats.page_walks++;
+    cpu->stats.walk_cycles+=cpu->clock-walk->start;
+    APEX_LOG(cpu, VERBOSITY_FULL, "Page walk of page %d done after %d cycles\n",
+             walk->page, cpu->clock-walk->start);
+    walk->page=-1;
+}
 
+//true if address is a word of the data memory
+static int
+data_address_valid(const APEX_CPU *cpu, int address)
+{
+    return address>=0 && address<cpu->data_memory_size;
 }
 
-void APEX_branch_writeback(APEX_CPU *cpu){
-    if(cpu->branch_writeback.has_insn){
-        if(cpu->branch_writeback.opcode==OPCODE_JALR){
-            cpu->prf.physical_register[cpu->branch_writeback.phy_rd].reg_value=cpu->branch_writeback.result_buffer;
-            cpu->prf.physical_register[cpu->branch_writeback.phy_rd].reg_valid=1;
-            printf("PRF updated for P[%d]\n",cpu->branch_writeback.phy_rd);
+/* Translates the address an lsq entry just computed, which lies inside the
+ * data memory, setting the cycle it may go to memory from. Pages map to the
+ * physical page of the same number, so translation only takes time. The
+ * DTLB is looked up alongside the first data cache and a hit costs nothing,
+ * a miss that hits in the L2 TLB waits its latency and one that misses both
+ * waits for a walk of the page, which starts right away if no walk of the
+ * page is in flight and a walker is free (see APEX_page_walk) */
+static void
+translate_address(APEX_CPU *cpu, load_store_queue_entry *entry)
+{
+    mmu *m=&cpu->mmu;
+    cache_line *line, victim;
+    int page=mmu_page(m, entry->mem_address);
 
-            
-            for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-            if(cpu->iq.issue_queue[i].is_allocated==1){
-                if(!cpu->iq.issue_queue[i].src1_valid){
-                    if(cpu->iq.issue_queue[i].src1_tag==cpu->branch_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src1_value=cpu->branch_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src1_valid=1;
-                    }
-                }
-                if(!cpu->iq.issue_queue[i].src2_valid){
-                    if(cpu->iq.issue_queue[i].src2_tag==cpu->branch_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src2_value=cpu->branch_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src2_valid=1;
-                    }
-                }
-            }
+    if(!mmu_enabled(m)){
+        return;
+    }
+    cpu->stats.dtlb_accesses++;
+    line=cache_lookup(&m->dtlb, entry->mem_address);
+    if(line){
+        //a translation filled from the L2 TLB may still be on its way
+        entry->translated=line->ready>cpu->clock?line->ready:cpu->clock;
+        return;
+    }
+    cpu->stats.dtlb_misses++;
+    if(cache_enabled(&m->l2_tlb)){
+        cpu->stats.l2_tlb_accesses++;
+        if(cache_lookup(&m->l2_tlb, entry->mem_address)){
+            entry->translated=cpu->clock+m->l2_tlb.latency;
+            cache_fill(&m->dtlb, entry->mem_address, entry->translated, &victim);
+            return;
         }
-        //update lsq instruction for which phys_rd is matched
-        for(int i=cpu->lsq.head;i!=cpu->lsq.tail;i=(i+1)%LSQ_SIZE){
-            //if instn is store
-            if(cpu->lsq.load_store_queue[i].OPCODE==OPCODE_STORE){
-                if(!cpu->lsq.load_store_queue[i].data_ready){
-                    if(cpu->lsq.load_store_queue[i].src1_store==cpu->branch_writeback.phy_rd){
-                        cpu->lsq.load_store_queue[i].data_ready=1;
-                        cpu->lsq.load_store_queue[i].value_to_be_stored=cpu->branch_writeback.result_buffer;
-                    }
-                }
-            }
+        cpu->stats.l2_tlb_misses++;
+    }
+    entry->translated=TRANSLATION_PENDING;
+    APEX_LOG(cpu, VERBOSITY_FULL, "LSQ I[%d] TLB miss on page %d\n", (entry->pc_value-4000)/4, page);
+    if(!mmu_find_walk(m, page) && mmu_idle_walker(m)){
+        start_page_walk(cpu, mmu_idle_walker(m), page);
+    }
+}
+
+/* Moves the page walks on once the entry they read last arrived: a walk
+ * reads the next level or, after the leaf, fills the TLBs. Idle walkers then
+ * take the oldest lsq entries still waiting for a walk of their page */
+static void
+APEX_page_walk(APEX_CPU *cpu)
+{
+    mmu *m=&cpu->mmu;
+
+    for(int i=0;i<m->num_walkers;i++){
+        page_walk *walk=&m->walks[i];
+
+        if(walk->page==-1 || walk->request!=-1 || walk->ready>cpu->clock){
+            continue;
         }
+        if(walk->level<m->levels){
+            read_page_table_entry(cpu, walk);
         }
-        cpu->rob.reorder_buffer_queue[cpu->branch_writeback.rob_index].status_bit=1;
-        cpu->branch_writeback.has_insn=FALSE;
-    if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Branch WB", &cpu->branch_writeback);
+        else{
+            finish_page_walk(cpu, walk);
         }
     }
-}
+    for(int n=0,j=cpu->lsq.head;n<cpu->lsq.count;n++,j=(j+1)%cpu->lsq.size){
+        const load_store_queue_entry *entry=&cpu->lsq.load_store_queue[j];
+        int page=mmu_page(m, entry->mem_address);
 
-
-void APEX_int_fu(APEX_CPU *cpu){
-    if(cpu->int_fu.has_insn){
-        switch (cpu->int_fu.opcode)
-        {
-        case OPCODE_ADD:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value+cpu->int_fu.rs2_value;
-            cpu->int_fu.positive_flag= (cpu->int_fu.result_buffer>0)?1:0;
-            cpu->int_fu.zero_flag= (cpu->int_fu.result_buffer==0)?1:0;
-            break;
-        case OPCODE_ADDL:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value+cpu->int_fu.imm;
-            cpu->int_fu.positive_flag= (cpu->int_fu.result_buffer>0)?1:0;
-            cpu->int_fu.zero_flag= (cpu->int_fu.result_buffer==0)?1:0;
-            break;
-        case OPCODE_SUB:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value-cpu->int_fu.rs2_value;
-            cpu->int_fu.positive_flag= (cpu->int_fu.result_buffer>0)?1:0;
-            cpu->int_fu.zero_flag= (cpu->int_fu.result_buffer==0)?1:0;
-            break;
-        case OPCODE_SUBL:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value-cpu->int_fu.imm;
-            cpu->int_fu.positive_flag= (cpu->int_fu.result_buffer>0)?1:0;
-            cpu->int_fu.zero_flag= (cpu->int_fu.result_buffer==0)?1:0;
-            break; 
-        case OPCODE_AND:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value & cpu->int_fu.rs2_value;
-            break;
-        case OPCODE_OR:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value | cpu->int_fu.rs2_value;
-            break;
-        case OPCODE_XOR:
-            cpu->int_fu.result_buffer=cpu->int_fu.rs1_value ^ cpu->int_fu.rs2_value;
-            break;   
-        case OPCODE_MOVC:
-            cpu->int_fu.result_buffer=cpu->int_fu.imm ;
-            break; 
-        case OPCODE_LOAD:
-            cpu->int_fu.memory_address=cpu->int_fu.rs1_value+cpu->int_fu.imm;
-            break;
-        case OPCODE_STORE:
-            cpu->int_fu.memory_address=cpu->int_fu.rs2_value+cpu->int_fu.imm;
-            break;
-        default:
+        if(entry->translated!=TRANSLATION_PENDING || mmu_find_walk(m, page)){
+            continue;
+        }
+        if(!mmu_idle_walker(m)){
             break;
         }
-        cpu->int_fwd=cpu->int_fu;
-        cpu->int_fu.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Integer Functional Unit", &cpu->int_fu);
+        start_page_walk(cpu, mmu_idle_walker(m), page);
+    }
+}
+
+//first cycle a page walk moves on or an lsq entry finishes its translation
+//in the L2 TLB, -1 when neither will before a DRAM request is scheduled
+static int
+next_translation_event(const APEX_CPU *cpu)
+{
+    int next=mmu_next_event(&cpu->mmu);
+
+    for(int n=0,j=cpu->lsq.head;n<cpu->lsq.count;n++,j=(j+1)%cpu->lsq.size){
+        const load_store_queue_entry *entry=&cpu->lsq.load_store_queue[j];
+
+        if(entry->address_valid && !entry->issued && entry->translated>cpu->clock &&
+           entry->translated!=TRANSLATION_PENDING && (next==-1 || entry->translated<next)){
+            next=entry->translated;
         }
     }
+    return next;
+}
+
+/* Replays the load at lsq_index, which read memory before the older store at
+ * store_index wrote the same address: everything younger than the load goes
+ * back to the rename checkpoint the load took, the load returns to the lsq
+ * to go to memory again and fetch restarts right after it */
+static void replay_load(APEX_CPU *cpu, int store_index, int lsq_index){
+    load_store_queue_entry *load=&cpu->lsq.load_store_queue[lsq_index];
+    int rob_index=load->rob_index;
+
+    APEX_LOG(cpu, VERBOSITY_FULL, "Memory order violation: I[%d] read before I[%d] wrote\n",
+             (load->pc_value-4000)/4, (cpu->lsq.load_store_queue[store_index].pc_value-4000)/4);
+    cpu->stats.memory_violations++;
+    cpu->stats.violation_squashed+=cpu->rob.count-1-
+                                   (rob_index-cpu->rob.head+cpu->rob.size)%cpu->rob.size;
+    store_set_violation(&cpu->ssp, load->pc_value, cpu->lsq.load_store_queue[store_index].pc_value);
+    flush_instructions(cpu, rob_index);
+
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[MEM_FU]+u];
+
+        for(int k=-2;k<fu->num_stages;k++){
+            CPU_Stage *latch=k==-2?&fu->writeback:k==-1?&fu->fwd:&fu->stages[k];
+
+            if(latch->has_insn && latch->rob_index==rob_index){
+                latch->has_insn=FALSE;
+            }
+        }
     }
+    cpu->rob.reorder_buffer_queue[rob_index].status_bit=0;
+    cpu->prf.physical_register[load->phy_destination_address_for_load].reg_valid=0;
+    load->issued=0;
+    load->speculative=0;
+
+    cpu->pc=load->pc_value+4;
+    cpu->fetch.has_insn=TRUE;
+    branch_predictor_recover(&cpu->bp, load->pc_value, OPCODE_LOAD, &load->bp_state, FALSE);
+}
 
+//a store address is known: replays the first load that read it too early
+//and frees the checkpoints of loads no older store address can hold back now
+static void store_address_known(APEX_CPU *cpu, int store_index){
+    int violation=lsq_find_violation(&cpu->lsq, store_index);
 
-void APEX_int_fwd(APEX_CPU *cpu){
-    if(cpu->int_fwd.has_insn){
+    if(violation!=-1){
+        replay_load(cpu, store_index, violation);
+    }
+    for(int k=(store_index+1)%cpu->lsq.size;k!=cpu->lsq.tail;k=(k+1)%cpu->lsq.size){
+        load_store_queue_entry *entry=&cpu->lsq.load_store_queue[k];
 
+        if(entry->speculative && !lsq_unknown_store_before(&cpu->lsq, k)){
+            int ckpt=rename_checkpoint_find(&cpu->checkpoints, entry->rob_index);
 
-        if(cpu->int_fwd.opcode==OPCODE_STORE || cpu->int_fwd.opcode==OPCODE_LOAD){
-            cpu->lsq.load_store_queue[cpu->int_fwd.lsq_index].mem_address  = cpu->int_fwd.memory_address;
-            cpu->lsq.load_store_queue[cpu->int_fwd.lsq_index].address_valid = 1;
-            printf("LSQ I[%d] memory address calculated \n",(cpu->int_fwd.pc -4000)/4);
-            printf("calculated address is %d \n",cpu->lsq.load_store_queue[cpu->int_fwd.lsq_index].mem_address);
+            if(ckpt!=-1){
+                rename_checkpoint_release(&cpu->checkpoints, ckpt);
+            }
+            entry->speculative=0;
         }
+    }
+}
 
-        if(cpu->int_fwd.opcode!=OPCODE_STORE && cpu->int_fwd.opcode!=OPCODE_LOAD){
-            cpu->int_writeback=cpu->int_fwd;
+//a load or store passes its address to the lsq, everything else goes on to
+//writeback
+static void execute_fwd(APEX_CPU *cpu, functional_unit *fu){
+        if(fu->fwd.opcode==OPCODE_STORE || fu->fwd.opcode==OPCODE_LOAD){
+            cpu->lsq.load_store_queue[fu->fwd.lsq_index].mem_address  = fu->fwd.memory_address;
+            cpu->lsq.load_store_queue[fu->fwd.lsq_index].address_valid = 1;
+            //a bad address may be on a wrong path, so it only faults at commit
+            if(data_address_valid(cpu, fu->fwd.memory_address)){
+                translate_address(cpu, &cpu->lsq.load_store_queue[fu->fwd.lsq_index]);
+            }
+            else{
+                cpu->rob.reorder_buffer_queue[fu->fwd.rob_index].fault=FAULT_ADDRESS;
+                cpu->rob.reorder_buffer_queue[fu->fwd.rob_index].fault_address=fu->fwd.memory_address;
+                APEX_LOG(cpu, VERBOSITY_FULL, "LSQ I[%d] address %d outside data memory\n",
+                         (fu->fwd.pc -4000)/4, fu->fwd.memory_address);
+            }
+            APEX_LOG(cpu, VERBOSITY_FULL, "LSQ I[%d] memory address calculated \n",(fu->fwd.pc -4000)/4);
+            APEX_LOG(cpu, VERBOSITY_FULL, "calculated address is %d \n",cpu->lsq.load_store_queue[fu->fwd.lsq_index].mem_address);
+            if(fu->fwd.opcode==OPCODE_STORE){
+                store_address_known(cpu, fu->fwd.lsq_index);
+            }
         }
-        cpu->int_fwd.has_insn=FALSE;
 
-    if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Integer forward Bus", &cpu->int_fwd);
-        }
-    }
-
-}
-
-void APEX_memory_fwd(APEX_CPU *cpu){
-    if(cpu->memory_fwd.has_insn){
-        // for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-        //     if(cpu->iq.issue_queue[i].is_allocated==1){
-        //         if(!cpu->iq.issue_queue[i].src1_valid){
-        //             if(cpu->iq.issue_queue[i].src1_tag==cpu->memory_fwd.phy_rd){
-        //               cpu->iq.issue_queue[i].src1_value=cpu->memory_fwd.result_buffer;
-        //                 cpu->iq.issue_queue[i].src1_valid=1;
-        //             }
-        //         }
-        //         if(!cpu->iq.issue_queue[i].src2_valid){
-        //             if(cpu->iq.issue_queue[i].src2_tag==cpu->memory_fwd.phy_rd){
-        //                 cpu->iq.issue_queue[i].src2_value=cpu->memory_fwd.result_buffer;
-        //                 cpu->iq.issue_queue[i].src2_valid=1;
-        //             }
-        //         }
-        //     }
-        // }
-        // //update lsq instruction for which phys_rd is matched
-        // for(int i=cpu->lsq.head;i!=cpu->lsq.tail;i=(i+1)%LSQ_SIZE){
-        //     //if instn is store
-        //     if(cpu->lsq.load_store_queue[i].OPCODE==OPCODE_STORE){
-        //         if(!cpu->lsq.load_store_queue[i].data_ready){
-        //             if(cpu->lsq.load_store_queue[i].src1_store==cpu->memory_fwd.phy_rd){
-        //                 cpu->lsq.load_store_queue[i].data_ready=1;
-        //                 cpu->lsq.load_store_queue[i].value_to_be_stored=cpu->memory_fwd.result_buffer;
-        //             }
-        //         }
-        //     }
-        // }
-        if(cpu->memory_fwd.opcode==OPCODE_STORE){
-            cpu->data_memory[cpu->memory_fwd.memory_address]=cpu->memory_fwd.result_buffer;
-            printf("data[%d]=%d\n", cpu->memory_fwd.memory_address,cpu->data_memory[cpu->memory_fwd.memory_address]);
-            cpu->rob.reorder_buffer_queue[cpu->memory_fwd.rob_index].status_bit=1;
-            printf("ROB I[%d] status bit updated\n",(cpu->memory_fwd.pc -4000)/4);
-            //cpu->lsq.head=(cpu->lsq.head+1)%LSQ_SIZE;
-        }
-        if(cpu->memory_fwd.opcode==OPCODE_LOAD){
-            cpu->mem_writeback=cpu->memory_fwd;
-        }
-        cpu->memory_fwd.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Memory forward Bus", &cpu->memory_fwd);
+        if(fu->fwd.opcode!=OPCODE_STORE && fu->fwd.opcode!=OPCODE_LOAD){
+            //like a bad address, a bad DIV only faults at commit
+            if(fu->fwd.fault){
+                cpu->rob.reorder_buffer_queue[fu->fwd.rob_index].fault=fu->fwd.fault;
+                APEX_LOG(cpu, VERBOSITY_FULL, "I[%d] faults at commit\n", (fu->fwd.pc -4000)/4);
+            }
+            fu->writeback=fu->fwd;
         }
-    }
+}
 
+static void memory_fwd(APEX_CPU *cpu, functional_unit *fu){
+        if(fu->fwd.opcode==OPCODE_STORE){
+            if(data_address_valid(cpu, fu->fwd.memory_address)){
+                cpu->data_memory[fu->fwd.memory_address]=fu->fwd.result_buffer;
+                APEX_LOG(cpu, VERBOSITY_FULL, "data[%d]=%d\n", fu->fwd.memory_address,cpu->data_memory[fu->fwd.memory_address]);
+            }
+            cpu->rob.reorder_buffer_queue[fu->fwd.rob_index].status_bit=1;
+            APEX_LOG(cpu, VERBOSITY_FULL, "ROB I[%d] status bit updated\n",(fu->fwd.pc -4000)/4);
+        }
+        if(fu->fwd.opcode==OPCODE_LOAD){
+            fu->writeback=fu->fwd;
+        }
 }
 
-static int APEX_int_writeback(APEX_CPU *cpu){
-    if(cpu->int_writeback.has_insn){
+/* Drives the forward buses of the units of a class */
+static void APEX_forward(APEX_CPU *cpu, int fu_class){
+    for(int u=0;u<cpu->fu_units[fu_class];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[fu_class]+u];
 
-        if(cpu->int_writeback.opcode==OPCODE_HALT){
-            cpu->rob.reorder_buffer_queue[cpu->int_writeback.rob_index].status_bit=1;
-            printf("Halting the CPU\n");
-            goto last;
+        if(fu->fwd.has_insn){
+            switch (fu_class)
+            {
+            case BRANCH_FU:
+                branch_fwd(cpu, fu);
+                break;
+            case MEM_FU:
+                memory_fwd(cpu, fu);
+                break;
+            default:
+                execute_fwd(cpu, fu);
+                break;
+            }
+            fu->fwd.has_insn=FALSE;
+            if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+            {
+                print_unit_latch(cpu, fu, fu_fwd_names[fu_class], -1, &fu->fwd);
+            }
         }
+    }
+}
 
-        if(cpu->int_writeback.opcode!=OPCODE_STORE && cpu->int_writeback.opcode!=OPCODE_LOAD){
-            cpu->prf.physical_register[cpu->int_writeback.phy_rd].reg_value=cpu->int_writeback.result_buffer;
-            cpu->prf.physical_register[cpu->int_writeback.phy_rd].positive_flag=cpu->int_writeback.positive_flag;
-            cpu->prf.physical_register[cpu->int_writeback.phy_rd].zero_flag=cpu->int_writeback.zero_flag;
-            cpu->prf.physical_register[cpu->int_writeback.phy_rd].reg_valid=1;
+static void branch_writeback(APEX_CPU *cpu, CPU_Stage *wb){
+        if(wb->opcode==OPCODE_JALR){
+            cpu->prf.physical_register[wb->phy_rd].reg_value=wb->result_buffer;
+            cpu->prf.physical_register[wb->phy_rd].reg_valid=1;
+            APEX_LOG(cpu, VERBOSITY_FULL, "PRF updated for P[%d]\n",wb->phy_rd);
 
-            printf("PRF updated for P[%d]\n",cpu->int_writeback.phy_rd);
+            
+            //wake up every issue queue entry and store waiting for phys_rd
+            issue_queue_wakeup(&cpu->iq, wb->phy_rd, wb->result_buffer);
+            lsq_wakeup(&cpu->lsq, wb->phy_rd, wb->result_buffer);
         }
-        if(cpu->int_writeback.opcode==OPCODE_STORE || cpu->int_writeback.opcode==OPCODE_LOAD){
-            cpu->lsq.load_store_queue[cpu->int_writeback.lsq_index].mem_address=cpu->int_writeback.memory_address;
-            cpu->lsq.load_store_queue[cpu->int_writeback.lsq_index].address_valid=1;
+        cpu->rob.reorder_buffer_queue[wb->rob_index].status_bit=1;
+}
+
+static void execute_writeback(APEX_CPU *cpu, CPU_Stage *wb){
+
+        if(wb->opcode==OPCODE_HALT){
+            cpu->rob.reorder_buffer_queue[wb->rob_index].status_bit=1;
+            APEX_LOG(cpu, VERBOSITY_FULL, "Halting the CPU\n");
+            return;
         }
+
+        cpu->prf.physical_register[wb->phy_rd].reg_value=wb->result_buffer;
+        cpu->prf.physical_register[wb->phy_rd].positive_flag=wb->positive_flag;
+        cpu->prf.physical_register[wb->phy_rd].zero_flag=wb->zero_flag;
+        cpu->prf.physical_register[wb->phy_rd].reg_valid=1;
+
+        APEX_LOG(cpu, VERBOSITY_FULL, "PRF updated for P[%d]\n",wb->phy_rd);
         //if instn is add addl sub subl
-        if(cpu->int_writeback.opcode==OPCODE_ADDL || cpu->int_writeback.opcode==OPCODE_SUBL || cpu->int_writeback.opcode==OPCODE_SUB || cpu->int_writeback.opcode==OPCODE_ADD){
-            printf("after the result zero flag is %d\n",cpu->prf.physical_register[cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register].positive_flag);
-            printf("after the result positive flag is %d\n",cpu->prf.physical_register[cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register].zero_flag);
+        if(wb->opcode==OPCODE_ADDL || wb->opcode==OPCODE_SUBL || wb->opcode==OPCODE_SUB || wb->opcode==OPCODE_ADD){
+            APEX_LOG(cpu, VERBOSITY_FULL, "after the result zero flag is %d\n",cpu->prf.physical_register[cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register].positive_flag);
+            APEX_LOG(cpu, VERBOSITY_FULL, "after the result positive flag is %d\n",cpu->prf.physical_register[cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].mapped_to_physical_register].zero_flag);
         }
 
 
-        for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-            if(cpu->iq.issue_queue[i].is_allocated==1){
-                if(!cpu->iq.issue_queue[i].src1_valid){
-                    if(cpu->iq.issue_queue[i].src1_tag==cpu->int_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src1_value=cpu->int_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src1_valid=1;
-                    }
-                }
-                if(!cpu->iq.issue_queue[i].src2_valid){
-                    if(cpu->iq.issue_queue[i].src2_tag==cpu->int_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src2_value=cpu->int_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src2_valid=1;
-                    }
-                }
+        //wake up every issue queue entry and store waiting for phys_rd
+        issue_queue_wakeup(&cpu->iq, wb->phy_rd, wb->result_buffer);
+        lsq_wakeup(&cpu->lsq, wb->phy_rd, wb->result_buffer);
+        cpu->rob.reorder_buffer_queue[wb->rob_index].status_bit=1;
+        cpu->rob.reorder_buffer_queue[wb->rob_index].result_value=wb->result_buffer;
+        cpu->rob.reorder_buffer_queue[wb->rob_index].positive_flag=wb->positive_flag;
+        cpu->rob.reorder_buffer_queue[wb->rob_index].zero_flag=wb->zero_flag;
+}
+
+static void memory_writeback(APEX_CPU *cpu, CPU_Stage *wb){
+        cpu->prf.physical_register[wb->phy_rd].reg_value=wb->result_buffer;
+        APEX_LOG(cpu, VERBOSITY_FULL, "read from memory data[]= %d\n",wb->result_buffer);
+        cpu->prf.physical_register[wb->phy_rd].reg_valid=1;
+        APEX_LOG(cpu, VERBOSITY_FULL, "PRF updated for P[%d]\n",wb->phy_rd);
+
+
+        //wake up every issue queue entry and store waiting for phys_rd
+        issue_queue_wakeup(&cpu->iq, wb->phy_rd, wb->result_buffer);
+        lsq_wakeup(&cpu->lsq, wb->phy_rd, wb->result_buffer);
+        cpu->rob.reorder_buffer_queue[wb->rob_index].status_bit=1;
+        cpu->rob.reorder_buffer_queue[wb->rob_index].result_value=wb->result_buffer;
+}
+
+/* Writes the results of the units of a class to the physical registers and
+ * wakes up their consumers */
+static void APEX_writeback(APEX_CPU *cpu, int fu_class){
+    for(int u=0;u<cpu->fu_units[fu_class];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[fu_class]+u];
+
+        if(fu->writeback.has_insn){
+            switch (fu_class)
+            {
+            case BRANCH_FU:
+                branch_writeback(cpu, &fu->writeback);
+                break;
+            case MEM_FU:
+                memory_writeback(cpu, &fu->writeback);
+                break;
+            default:
+                execute_writeback(cpu, &fu->writeback);
+                break;
             }
-        }
-        //update lsq instruction for which phys_rd is matched
-        for(int i=cpu->lsq.head;i!=cpu->lsq.tail;i=(i+1)%LSQ_SIZE){
-            //if instn is store
-            if(cpu->lsq.load_store_queue[i].OPCODE==OPCODE_STORE){
-                if(!cpu->lsq.load_store_queue[i].data_ready){
-                    if(cpu->lsq.load_store_queue[i].src1_store==cpu->int_writeback.phy_rd){
-                        cpu->lsq.load_store_queue[i].data_ready=1;
-                        cpu->lsq.load_store_queue[i].value_to_be_stored=cpu->int_writeback.result_buffer;
-                    }
-                }
+            fu->writeback.has_insn=FALSE;
+            if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+            {
+                print_unit_latch(cpu, fu, fu_writeback_names[fu_class], -1, &fu->writeback);
             }
         }
-    cpu->rob_commit=cpu->int_writeback;
-    if(cpu->int_writeback.opcode!=OPCODE_STORE && cpu->int_writeback.opcode!=OPCODE_LOAD){
-        cpu->rob.reorder_buffer_queue[cpu->int_writeback.rob_index].status_bit=1;
-        cpu->rob.reorder_buffer_queue[cpu->int_writeback.rob_index].result_value=cpu->int_writeback.result_buffer;
-        cpu->rob.reorder_buffer_queue[cpu->int_writeback.rob_index].positive_flag=cpu->int_writeback.positive_flag;
-        cpu->rob.reorder_buffer_queue[cpu->int_writeback.rob_index].zero_flag=cpu->int_writeback.zero_flag;
-
     }
-last:
-    cpu->int_writeback.has_insn=FALSE;
-    if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Integer WB", &cpu->int_writeback);
-        }
-    }
-    return 0;
 }
 
-void APEX_mul_writeback(APEX_CPU *cpu){
-    if(cpu->mul_writeback.has_insn){
-        cpu->prf.physical_register[cpu->mul_writeback.phy_rd].reg_value=cpu->mul_writeback.result_buffer;
-        cpu->prf.physical_register[cpu->mul_writeback.phy_rd].positive_flag=cpu->mul_writeback.positive_flag;
-        cpu->prf.physical_register[cpu->mul_writeback.phy_rd].zero_flag=cpu->mul_writeback.zero_flag;
-        cpu->prf.physical_register[cpu->mul_writeback.phy_rd].reg_valid=1;
-        printf("PRF updated for P[%d]\n",cpu->mul_writeback.phy_rd);
 
-
-        for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-            if(cpu->iq.issue_queue[i].is_allocated==1){
-                if(!cpu->iq.issue_queue[i].src1_valid){
-                    if(cpu->iq.issue_queue[i].src1_tag==cpu->mul_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src1_value=cpu->mul_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src1_valid=1;
-                    }
-                }
-                if(!cpu->iq.issue_queue[i].src2_valid){
-                    if(cpu->iq.issue_queue[i].src2_tag==cpu->mul_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src2_value=cpu->mul_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src2_valid=1;
-                    }
-                }
+//identify iq index and push information 
+//issues the oldest ready instructions of every class to its free units, at
+//most issue_width of them a cycle
+void APEX_process_iq(APEX_CPU *cpu){
+    int selected[NUM_ISSUE_FU][MAX_FU_UNITS];
+    int found[NUM_ISSUE_FU];
+    int candidates=0;
+    int ready=0;
+
+    for(int fu=INT_FU;fu<NUM_ISSUE_FU;fu++){
+        int free_units=0;
+
+        //a pipelined unit moved its last instruction on, so only an
+        //unpipelined one can be busy
+        for(int u=0;u<cpu->fu_units[fu];u++){
+            free_units+=!cpu->fu_pool[cpu->fu_first[fu]+u].stages[0].has_insn;
+        }
+        ready+=issue_queue_ready_count(&cpu->iq, fu);
+        found[fu]=issue_queue_select(&cpu->iq, fu, selected[fu], free_units);
+        candidates+=found[fu];
+    }
+    //with fewer issue slots than candidates the youngest ones wait, each
+    //class selected oldest first so its youngest candidate is the last one
+    while(cpu->config.issue_width && candidates>cpu->config.issue_width){
+        int youngest=-1;
+
+        for(int fu=INT_FU;fu<NUM_ISSUE_FU;fu++){
+            if(found[fu] && (youngest==-1 ||
+               (int)((unsigned int)cpu->iq.issue_queue[selected[fu][found[fu]-1]].age-
+                     (unsigned int)cpu->iq.issue_queue[selected[youngest][found[youngest]-1]].age)>0)){
+                youngest=fu;
             }
         }
-        //update lsq instruction for which phys_rd is matched
-        for(int i=cpu->lsq.head;i!=cpu->lsq.tail;i=(i+1)%LSQ_SIZE){
-            //if instn is store
-            if(cpu->lsq.load_store_queue[i].OPCODE==OPCODE_STORE){
-                if(!cpu->lsq.load_store_queue[i].data_ready){
-                    if(cpu->lsq.load_store_queue[i].src1_store==cpu->mul_writeback.phy_rd){
-                        cpu->lsq.load_store_queue[i].data_ready=1;
-                        cpu->lsq.load_store_queue[i].value_to_be_stored=cpu->mul_writeback.result_buffer;
-                    }
-                }
+        found[youngest]--;
+        candidates--;
+    }
+    cpu->stats.operand_stalls+=cpu->iq.count-ready;
+    cpu->stats.fu_busy_stalls+=ready-candidates;
+    for(int fu=INT_FU;fu<NUM_ISSUE_FU;fu++){
+        functional_unit *unit=&cpu->fu_pool[cpu->fu_first[fu]];
+
+        for(int k=0;k<found[fu];k++){
+            while(unit->stages[0].has_insn){
+                unit++;
             }
-        }
-    cpu->rob.reorder_buffer_queue[cpu->mul_writeback.rob_index].status_bit=1;
-    cpu->rob.reorder_buffer_queue[cpu->mul_writeback.rob_index].result_value=cpu->mul_writeback.result_buffer;
-    cpu->rob.reorder_buffer_queue[cpu->mul_writeback.rob_index].positive_flag=cpu->mul_writeback.positive_flag;
-    cpu->rob.reorder_buffer_queue[cpu->mul_writeback.rob_index].zero_flag=cpu->mul_writeback.zero_flag;
-    cpu->mul_writeback.has_insn=FALSE;
-    if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Multiplication WB", &cpu->mul_writeback);
+            push_information_to_fu(cpu, selected[fu][k], unit);
         }
     }
 }
 
-void APEX_mem_writeback(APEX_CPU *cpu){
-    if(cpu->mem_writeback.has_insn){
-        cpu->prf.physical_register[cpu->mem_writeback.phy_rd].reg_value=cpu->mem_writeback.result_buffer;
-        printf("read from memory data[]= %d\n",cpu->mem_writeback.result_buffer);
-        cpu->prf.physical_register[cpu->mem_writeback.phy_rd].reg_valid=1;
-        printf("PRF updated for P[%d]\n",cpu->mem_writeback.phy_rd);
 
 
-        for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-            if(cpu->iq.issue_queue[i].is_allocated==1){
-                if(!cpu->iq.issue_queue[i].src1_valid){
-                    if(cpu->iq.issue_queue[i].src1_tag==cpu->mem_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src1_value=cpu->mem_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src1_valid=1;
-                    }
-                }
-                if(!cpu->iq.issue_queue[i].src2_valid){
-                    if(cpu->iq.issue_queue[i].src2_tag==cpu->mem_writeback.phy_rd){
-                        cpu->iq.issue_queue[i].src2_value=cpu->mem_writeback.result_buffer;
-                        cpu->iq.issue_queue[i].src2_valid=1;
-                    }
-                }
-            }
-        }
-        cpu->rob.reorder_buffer_queue[cpu->mem_writeback.rob_index].status_bit=1;
-        cpu->rob.reorder_buffer_queue[cpu->mem_writeback.rob_index].result_value=cpu->mem_writeback.result_buffer;
-        cpu->lsq.head=(cpu->lsq.head+1)%LSQ_SIZE;
-        cpu->mem_writeback.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Memory WB", &cpu->mem_writeback);
-        }
+/* Cycles an access takes in the memory hierarchy, looked up in the caches
+ * when it enters a memory unit. Without caches every access costs the flat
+ * memory_latency or goes to the DRAM; the memory units let accesses of
+ * different latencies overlap and finish out of order. While the access
+ * waits for a DRAM request that is not scheduled, the request is kept in
+ * stage->dram_request and the cycles count from its data. */
+static int
+memory_access_latency(APEX_CPU *cpu, CPU_Stage *stage)
+{
+    //an access that faults at commit goes nowhere
+    if(!data_address_valid(cpu, stage->memory_address)){
+        return 1;
     }
-
+    return cache_access(cpu, CACHE_L1D, stage->memory_address, stage->opcode==OPCODE_STORE,
+                        &stage->dram_request);
 }
 
-void APEX_mul_fu_1(APEX_CPU *cpu){
-    if(cpu->mul1_fu.has_insn){
-        cpu->mul2_fu=cpu->mul1_fu;
-        cpu->mul1_fu.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("MUL FU1", &cpu->mul1_fu);
-        }
+/* Trains the prefetcher on a load entering a memory unit, after its own
+ * access, and fills the lines it asks for into the first data cache. A
+ * prefetch reads the line from the levels below like a miss would, without
+ * holding an MSHR, and the line arrives once they served it; lines already
+ * cached and addresses outside the data memory are dropped. */
+static void
+issue_prefetches(APEX_CPU *cpu, const load_store_queue_entry *entry)
+{
+    int addresses[MAX_PREFETCH_DEGREE];
+    int level=prefetch_level(cpu);
+    int count;
+    cache *c;
+
+    if(cpu->pf.kind==PF_NONE || level==-1){
+        return;
+    }
+    c=&cpu->caches[level];
+    count=prefetcher_train(&cpu->pf, entry->pc_value, entry->mem_address, c->line_size, addresses);
+    for(int i=0;i<count;i++){
+        int below, request;
+
+        if(!data_address_valid(cpu, addresses[i]) || cache_probe(c, addresses[i])){
+            continue;
+        }
+        below=access_below(cpu, level, addresses[i], FALSE, &request);
+        allocate_line(cpu, level, addresses[i], below, request)->prefetched=TRUE;
+        cpu->stats.prefetches++;
+        APEX_LOG(cpu, VERBOSITY_FULL, "Prefetch of line %d for I[%d]\n",
+                 cache_line_address(c, addresses[i]), (entry->pc_value-4000)/4);
     }
 }
 
-void APEX_mul_fu_2(APEX_CPU *cpu){
-    if(cpu->mul2_fu.has_insn){
-        cpu->mul3_fu=cpu->mul2_fu;
-        cpu->mul2_fu.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("MUL FU2", &cpu->mul2_fu);
+//true if a store to address has not written the data memory yet. Stores
+//only start at the ROB head, so such a store is older than every load in
+//flight and a load of the same address has to wait for it.
+static int
+store_in_flight(const APEX_CPU *cpu, int address)
+{
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        const functional_unit *fu=&cpu->fu_pool[cpu->fu_first[MEM_FU]+u];
+
+        if(fu->fwd.has_insn && fu->fwd.opcode==OPCODE_STORE && fu->fwd.memory_address==address){
+            return TRUE;
+        }
+        for(int k=0;k<fu->num_stages;k++){
+            const CPU_Stage *stage=&fu->stages[k];
+
+            if(stage->has_insn && stage->opcode==OPCODE_STORE && stage->memory_address==address){
+                return TRUE;
+            }
         }
     }
+    return FALSE;
 }
 
-void APEX_mul_fu_3(APEX_CPU *cpu){
-    if(cpu->mul3_fu.has_insn){
-        cpu->mul4_fu=cpu->mul3_fu;
-        cpu->mul3_fu.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("MUL FU3", &cpu->mul3_fu);
+//finishes the access in stage, a load reads the data memory unless a store
+//forwarded its data or its address is outside it, and a store goes on to
+//write it
+static void
+complete_memory_access(APEX_CPU *cpu, functional_unit *fu, CPU_Stage *stage)
+{
+    if(stage->opcode==OPCODE_LOAD){
+        if(!stage->forwarded){
+            stage->result_buffer=data_address_valid(cpu, stage->memory_address)?
+                                 cpu->data_memory[stage->memory_address]:0;
         }
+        //update rob
+        cpu->rob.reorder_buffer_queue[stage->rob_index].result_value=stage->result_buffer;
     }
+    else{
+        stage->result_buffer=stage->rs1_value;
+    }
+    stage->cycles=0;
+    stage->is_stage_stalled=0;
+    fu->fwd=*stage;
+    stage->has_insn=FALSE;
+    APEX_LOG(cpu, VERBOSITY_FULL, "Memory I[%d] completed\n", (stage->pc-4000)/4);
 }
 
+/* Counts every access in the memory units down. Each unit has one forward
+ * bus, so of its finished accesses the oldest one completes and the others
+ * wait a cycle; a load also waits while a store to its address is in flight.
+ * An access waiting for a DRAM request only finishes once the request is
+ * scheduled and its latency known. */
+void  APEX_memory(APEX_CPU *cpu){
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[MEM_FU]+u];
+        int oldest=-1;
+        int oldest_age=0;
+
+        for(int k=0;k<fu->num_stages;k++){
+            CPU_Stage *stage=&fu->stages[k];
+            int age;
 
-void APEX_mul_fu_4(APEX_CPU *cpu){
-    if(cpu->mul4_fu.has_insn){
-        if(cpu->mul4_fu.opcode==OPCODE_MUL){
-            cpu->mul4_fu.result_buffer=cpu->mul4_fu.rs1_value*cpu->mul4_fu.rs2_value;
-            cpu->mul4_fu.positive_flag=(cpu->mul4_fu.result_buffer>0)?1:0;
-            cpu->mul4_fu.zero_flag=(cpu->mul4_fu.result_buffer==0)?1:0;
+            if(!stage->has_insn){
+                continue;
+            }
+            stage->is_stage_stalled=1;
+            if(stage->dram_request!=-1 || stage->cycles<stage->latency-1){
+                stage->cycles++;
+                APEX_LOG(cpu, VERBOSITY_FULL, "Memory I[%d] in progress\n", (stage->pc-4000)/4);
+                continue;
+            }
+            if(stage->opcode==OPCODE_LOAD && !stage->forwarded &&
+               store_in_flight(cpu, stage->memory_address)){
+                continue;
+            }
+            age=(stage->rob_index-cpu->rob.head+cpu->rob.size)%cpu->rob.size;
+            if(oldest==-1 || age<oldest_age){
+                oldest=k;
+                oldest_age=age;
+            }
         }
-        else{
-            cpu->mul4_fu.result_buffer=cpu->mul4_fu.rs1_value/cpu->mul4_fu.rs2_value;
-            cpu->mul4_fu.positive_flag=(cpu->mul4_fu.result_buffer>0)?1:0;
-            cpu->mul4_fu.zero_flag=(cpu->mul4_fu.result_buffer==0)?1:0;
+        if(oldest!=-1){
+            complete_memory_access(cpu, fu, &fu->stages[oldest]);
         }
-        cpu->mul_fwd=cpu->mul4_fu;
-        cpu->mul4_fu.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
+        if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
         {
-            print_stage_content("MUL FU4", &cpu->mul4_fu);
+            for(int k=0;k<fu->num_stages;k++){
+                if(fu->stages[k].has_insn || k==oldest){
+                    print_unit_latch(cpu, fu, fu_stage_names[MEM_FU], k, &fu->stages[k]);
+                }
+            }
         }
     }
 }
 
-void APEX_mul_fwd(APEX_CPU *cpu){
-    if(cpu->mul_fwd.has_insn){
+/* Hands the cycle the data of a scheduled DRAM request arrives to everything
+ * that waited for it: the lines it fills in each cache level, the misses
+ * charged to those levels, the accesses in the memory units, the line fetch
+ * waits for and the page table entries of the walks */
+static void
+dram_request_done(APEX_CPU *cpu, const dram_request *request, int done)
+{
+    for(int level=0;level<NUM_CACHE_LEVELS;level++){
+        cache *c=&cpu->caches[level];
 
-        if(cpu->mul_fwd.opcode!=OPCODE_STORE && cpu->mul_fwd.opcode!=OPCODE_LOAD){
-            cpu->mul_writeback=cpu->mul_fwd;
+        if(!cache_enabled(c)){
+            continue;
         }
-        
-        cpu->mul_fwd.has_insn=FALSE;
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Mul fwd bus", &cpu->mul_fwd);
+        cpu->stats.caches[level].miss_cycles+=request->miss_cycles[level]+(long)done*request->misses[level];
+        //a line of an upper level may take a part of the line the request fills
+        for(int tag=cache_line_address(c, request->address);
+            tag<=cache_line_address(c, request->address+request->words-1);tag++){
+            cache_line *line=cache_probe(c, tag*c->line_size);
+
+            if(line && line->request==request->id){
+                line->ready+=done;
+                line->request=-1;
+            }
         }
     }
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        functional_unit *fu=&cpu->fu_pool[cpu->fu_first[MEM_FU]+u];
 
-}
-
+        for(int k=0;k<fu->num_stages;k++){
+            CPU_Stage *stage=&fu->stages[k];
 
-//identify iq index and push information 
-void APEX_process_iq(APEX_CPU *cpu){
-    
-        int int_iq_index=-1;
-        int mul_iq_index=-1;
-        int bu_iq_index=-1;
-        
-        int_iq_index = get_iq_index_fu(&cpu->iq, 0);//0 for add
-        mul_iq_index = get_iq_index_fu(&cpu->iq, 1);//1  for mul
-        bu_iq_index  = get_iq_index_fu(&cpu->iq, 2);//2 for branch
-            
-        if(int_iq_index>=0){
-            push_information_to_fu(cpu, int_iq_index, 0);
-        }
-        if(mul_iq_index>=0){
-            push_information_to_fu(cpu, mul_iq_index, 1);
+            //it entered the unit stage->cycles cycles ago
+            if(stage->has_insn && stage->dram_request==request->id){
+                stage->latency+=done-(cpu->clock-stage->cycles);
+                stage->dram_request=-1;
+            }
         }
-        if(bu_iq_index>=0){
-            push_information_to_fu(cpu, bu_iq_index, 2);
+    }
+    if(cpu->fetch_line_request==request->id){
+        cpu->fetch_line_ready+=done;
+        cpu->fetch_line_request=-1;
+    }
+    for(int i=0;i<cpu->mmu.num_walkers;i++){
+        page_walk *walk=&cpu->mmu.walks[i];
+
+        if(walk->page!=-1 && walk->request==request->id){
+            walk->ready+=done;
+            walk->request=-1;
         }
+    }
 }
 
+/* Lets every DRAM channel start a request at the end of a cycle, once all
+ * stages queued theirs */
+static void
+APEX_dram(APEX_CPU *cpu)
+{
+    dram_request request;
+    int done;
 
+    for(int channel=0;channel<cpu->dram.channels;channel++){
+        if(dram_schedule(&cpu->dram, channel, cpu->clock, &request, &done, &cpu->stats.dram)){
+            APEX_LOG(cpu, VERBOSITY_FULL, "DRAM %s of word %d on channel %d bank %d row %d, data at cycle %d\n",
+                     request.write?"write":"read", request.address, channel, request.bank,
+                     request.row, done+1);
+            dram_request_done(cpu, &request, done);
+        }
+    }
+}
 
+//true if an lsq entry can go to memory this cycle
+static int lsq_ready(const APEX_CPU *cpu){
+    int forward_from, bypassed;
 
+    return lsq_select(&cpu->lsq, cpu->rob.head, &cpu->ssp, cpu->clock, &forward_from, &bypassed)!=-1;
+}
 
-
-
-void  APEX_memory(APEX_CPU *cpu){
-    if(cpu->memory.has_insn){
-        //for load operation
-        if(cpu->memory.cycles==0){
-
-            cpu->memory.cycles++;
-            cpu->memory.is_stage_stalled=1;
-            printf("Memory I[%d] in progress\n", (cpu->memory.pc-4000)/4);
+//free MSHR of a memory unit, NULL when all its accesses are in flight
+static CPU_Stage *free_mshr(functional_unit *fu){
+    for(int k=0;k<fu->num_stages;k++){
+        if(!fu->stages[k].has_insn){
+            return &fu->stages[k];
         }
-        else if(cpu->memory.cycles==1){
-            if(cpu->memory.opcode==OPCODE_LOAD)
-            {
-                cpu->memory.result_buffer=cpu->data_memory[cpu->memory.memory_address];
-                cpu->memory.cycles=0;
-                cpu->memory_fwd=cpu->memory;
-                cpu->memory.has_insn=FALSE;
-                cpu->memory.is_stage_stalled=0;
-
-                //update rob
-                // cpu->rob.reorder_buffer_queue[cpu->memory.rob_index].status_bit=1;
-                cpu->rob.reorder_buffer_queue[cpu->memory.rob_index].result_value=cpu->memory.result_buffer;
-            }
-            else if(cpu->memory.opcode==OPCODE_STORE)
-            {
-                cpu->memory.result_buffer=cpu->memory.rs1_value;
-                cpu->memory.cycles=0;
-                cpu->memory_fwd=cpu->memory;
-                cpu->memory.has_insn=FALSE;
-                cpu->memory.is_stage_stalled=0;
+    }
+    return NULL;
+}
 
-                // cpu->rob.reorder_buffer_queue[cpu->memory.rob_index].status_bit=1;
-            }
-            printf("Memory I[%d] completed\n", (cpu->memory.pc-4000)/4);
-            cpu->memory.has_insn=FALSE;
-        }
-        if (ENABLE_DEBUG_MESSAGES)
-        {
-            print_stage_content("Memory", &cpu->memory);
-        }
+//moves lsq entry lsq_index into an MSHR of a memory unit, a load forwarded
+//from the store at forward_from takes its data and a single cycle
+static void push_lsq_entry(APEX_CPU *cpu, CPU_Stage *stage, int lsq_index, int forward_from){
+    const load_store_queue_entry *entry=&cpu->lsq.load_store_queue[lsq_index];
+
+    stage->has_insn=TRUE;
+    stage->cycles=0;
+    stage->is_stage_stalled=0;
+    stage->forwarded=FALSE;
+    stage->dram_request=-1;
+    stage->memory_address=entry->mem_address;
+    stage->memory_instruction_type=entry->instruction_type;
+    //if instruction is load =0
+    if(entry->instruction_type==0){
+        stage->opcode=OPCODE_LOAD;
+        stage->phy_rd=entry->phy_destination_address_for_load;
+        stage->rd=entry->destination_address_for_load;
+    }
+    //if instruction is store =1
+    else{
+        stage->opcode=OPCODE_STORE;
+        //either need to read from physical or architectural register
+        stage->phy_rs1=entry->src1_store;
+        stage->rs1_value=entry->value_to_be_stored;
+    }
+    stage->rob_index=entry->rob_index;
+    stage->lsq_index=lsq_index;
+    stage->pc=entry->pc_value;
+    if(forward_from!=-1){
+        stage->forwarded=TRUE;
+        stage->result_buffer=cpu->lsq.load_store_queue[forward_from].value_to_be_stored;
+        stage->latency=1;
+        APEX_LOG(cpu, VERBOSITY_FULL, "LSQ I[%d] forwarded to I[%d]\n",
+                 (cpu->lsq.load_store_queue[forward_from].pc_value-4000)/4, (stage->pc-4000)/4);
     }
+    else{
+        stage->latency=memory_access_latency(cpu, stage);
+    }
+    if(stage->opcode==OPCODE_LOAD){
+        issue_prefetches(cpu, entry);
+    }
+    APEX_LOG(cpu, VERBOSITY_FULL, "**************************************\n");
+    APEX_LOG(cpu, VERBOSITY_FULL, "ROB index %d\n", stage->rob_index);
+    APEX_LOG(cpu, VERBOSITY_FULL, "**************************************\n");
+    lsq_issue(&cpu->lsq, lsq_index);
 }
 
+/* Sends the oldest lsq entries that can go to memory to the memory units,
+ * each unit takes at most one access a cycle into a free MSHR. Loads go
+ * ahead of older stores whose addresses differ or, as the memory dependence
+ * predictor allows, are not known yet (see lsq_select). */
 void push_lsq_instruction_to_memory_fu(APEX_CPU *cpu){
-    load_store_queue lsq=cpu->lsq;
-    if (lsq.load_store_queue[lsq.head].allocate==1 && lsq.load_store_queue[lsq.head].address_valid==1){
-        //if instruction is load =0
-        if(lsq.load_store_queue[lsq.head].instruction_type==0){
-            if(lsq.load_store_queue[lsq.head].address_valid==1){
-                //push instruction to memory function 
-                if(cpu->memory.is_stage_stalled==0){
-                    cpu->memory.has_insn=TRUE;
-                    cpu->memory.memory_address=lsq.load_store_queue[lsq.head].mem_address;
-                    cpu->memory.memory_instruction_type=0;
-                    cpu->memory.opcode=OPCODE_LOAD;
-                    cpu->memory.phy_rd=lsq.load_store_queue[lsq.head].phy_destination_address_for_load;
-                    cpu->memory.rd=lsq.load_store_queue[lsq.head].destination_address_for_load;
-                    cpu->memory.rob_index=lsq.load_store_queue[lsq.head].rob_index;
-                    printf("**************************************\n");
-                    printf("ROB index %d\n", cpu->memory.rob_index);
-                    printf("**************************************\n");
-                    cpu->lsq.load_store_queue[lsq.head].allocate=0;
-                    cpu->memory.pc=lsq.load_store_queue[lsq.head].pc_value;
-                    cpu->lsq.head=(cpu->lsq.head+1)%LSQ_SIZE;
+    int pushed=0;
 
-                }
-            }
-        }
-        //if instruction is store =1
-        if(lsq.load_store_queue[lsq.head].instruction_type==1){
-            if(lsq.load_store_queue[lsq.head].address_valid==1  &&
-                lsq.load_store_queue[lsq.head].data_ready ==1 &&
-                lsq.load_store_queue[lsq.head].rob_index == cpu->rob.head){
-                 if(cpu->memory.is_stage_stalled==0){
-                    cpu->memory.has_insn=TRUE;
-                    cpu->memory.memory_address=lsq.load_store_queue[lsq.head].mem_address;
-                    cpu->memory.memory_instruction_type=1;
-                    cpu->memory.opcode=OPCODE_STORE;
-                    //either need to read from physical or architectural register
-                    cpu->memory.phy_rs1=lsq.load_store_queue[lsq.head].src1_store;
-                    cpu->memory.rs1_value=lsq.load_store_queue[lsq.head].value_to_be_stored;
-                    cpu->memory.rob_index=lsq.load_store_queue[lsq.head].rob_index;
-                    printf("**************************************\n");
-                    printf("ROB index %d\n", cpu->memory.rob_index);
-                    printf("**************************************\n");
-                    cpu->lsq.load_store_queue[lsq.head].allocate=0;
-                    cpu->memory.pc=lsq.load_store_queue[lsq.head].pc_value;
-                    cpu->lsq.head=(cpu->lsq.head+1)%LSQ_SIZE;
+    for(int u=0;u<cpu->fu_units[MEM_FU];u++){
+        CPU_Stage *stage=free_mshr(&cpu->fu_pool[cpu->fu_first[MEM_FU]+u]);
+        int lsq_index, forward_from, bypassed;
 
-                }
-            }
+        if(!stage){
+            continue;
         }
+        lsq_index=lsq_select(&cpu->lsq, cpu->rob.head, &cpu->ssp, cpu->clock, &forward_from, &bypassed);
+        if(lsq_index==-1){
+            return;
+        }
+        if(cpu->lsq.load_store_queue[lsq_index].instruction_type==0){
+            cpu->stats.loads++;
+            cpu->stats.loads_forwarded+=forward_from!=-1;
+            cpu->stats.loads_bypassed+=bypassed!=LSQ_IN_ORDER && forward_from==-1;
+            cpu->stats.loads_speculated+=bypassed==LSQ_SPECULATE;
+        }
+        push_lsq_entry(cpu, stage, lsq_index, forward_from);
+        pushed++;
+    }
+    if(!pushed && lsq_ready(cpu)){
+        cpu->stats.mshr_full_stalls++;
     }
 }
 
 
-void APEX_rob_commit_writeback(APEX_CPU *cpu){
-    if(cpu->rob_commit_writeback.has_insn){
+/* Updates the architectural state for an instruction retired last cycle */
+static void
+commit_writeback(APEX_CPU *cpu, CPU_Stage *wb){
+    if(wb->has_insn){
  
 
                     //wrrite the result into the destination  architecture register
-                    cpu->arf.architectural_register_file[cpu->rob_commit_writeback.rd].value=
-                    cpu->prf.physical_register[cpu->rob_commit_writeback.phy_rd].reg_value;
+                    cpu->arf.architectural_register_file[wb->rd].value=
+                    cpu->prf.physical_register[wb->phy_rd].reg_value;
                     
-                    if( cpu->rob_commit_writeback.opcode==OPCODE_ADD  ||
-                        cpu->rob_commit_writeback.opcode==OPCODE_SUB  ||
-                        cpu->rob_commit_writeback.opcode==OPCODE_ADDL ||
-                        cpu->rob_commit_writeback.opcode==OPCODE_SUBL ||
-                        cpu->rob_commit_writeback.opcode==OPCODE_MUL  ||
-                        cpu->rob_commit_writeback.opcode==OPCODE_DIV){
+                    if( wb->opcode==OPCODE_ADD  ||
+                        wb->opcode==OPCODE_SUB  ||
+                        wb->opcode==OPCODE_ADDL ||
+                        wb->opcode==OPCODE_SUBL ||
+                        wb->opcode==OPCODE_MUL  ||
+                        wb->opcode==OPCODE_DIV){
                         
                         //positive flag
-                        cpu->arf.architectural_register_file[cpu->rob_commit_writeback.rd].positive_flag=
-                        cpu->prf.physical_register[cpu->rob_commit_writeback.phy_rd].positive_flag;
+                        cpu->arf.architectural_register_file[wb->rd].positive_flag=
+                        cpu->prf.physical_register[wb->phy_rd].positive_flag;
                         //zero flag
-                        cpu->arf.architectural_register_file[cpu->rob_commit_writeback.rd].zero_flag=
-                        cpu->prf.physical_register[cpu->rob_commit_writeback.phy_rd].zero_flag;
+                        cpu->arf.architectural_register_file[wb->rd].zero_flag=
+                        cpu->prf.physical_register[wb->phy_rd].zero_flag;
                         //ccr
-                        cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].value= cpu->rob_commit_writeback.rd;
+                        cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].value= wb->rd;
                         cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].positive_flag=
-                        cpu->arf.architectural_register_file[cpu->rob_commit_writeback.rd].positive_flag;
+                        cpu->arf.architectural_register_file[wb->rd].positive_flag;
                         cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].zero_flag=
-                        cpu->arf.architectural_register_file[cpu->rob_commit_writeback.rd].zero_flag;
+                        cpu->arf.architectural_register_file[wb->rd].zero_flag;
 
 
                         
-                        printf("MRA CCR=R[%d]\n",cpu->rob_commit_writeback.rd);
+                        APEX_LOG(cpu, VERBOSITY_FULL, "MRA CCR=R[%d]\n",wb->rd);
 
-                        if(cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]==cpu->rob_commit_writeback.phy_rd ){
+                        if(cpu->mri[ARCHITECTURAL_REGISTERS_SIZE]==wb->phy_rd ){
                             cpu->rnt.rename_table[ARCHITECTURAL_REGISTERS_SIZE].register_source=0;
-                            printf("Updating RNT for CCR\n");
+                            APEX_LOG(cpu, VERBOSITY_FULL, "Updating RNT for CCR\n");
                         }
+                        rename_checkpoint_commit(&cpu->checkpoints, ARCHITECTURAL_REGISTERS_SIZE, wb->phy_rd);
                     }
 
                         //free the physical register and add to prf free queue
-                        push_free_physical_registers(&cpu->free_prf_q,cpu->rob_commit_writeback.phy_rd);
+                        APEX_LOG(cpu, VERBOSITY_FULL, "PRF reg Freed: P[%d]\n",wb->phy_rd);
+                        push_free_physical_registers(&cpu->free_prf_q,wb->phy_rd);
 
-                        printf("ARF updates for R[%d]\n",cpu->rob_commit_writeback.rd);
+                        APEX_LOG(cpu, VERBOSITY_FULL, "ARF updates for R[%d]\n",wb->rd);
 
-                        if(cpu->mri[cpu->rob_commit_writeback.rd]==cpu->rob_commit_writeback.phy_rd){
-                            cpu->rnt.rename_table[cpu->rob_commit_writeback.rd].register_source=0;
-                            printf("Updating RNT for R[%d]\n",cpu->rob_commit_writeback.rd);
+                        if(cpu->mri[wb->rd]==wb->phy_rd){
+                            cpu->rnt.rename_table[wb->rd].register_source=0;
+                            APEX_LOG(cpu, VERBOSITY_FULL, "Updating RNT for R[%d]\n",wb->rd);
                         }
-                        cpu->rob_commit_writeback.has_insn=FALSE;
+                        rename_checkpoint_commit(&cpu->checkpoints, wb->rd, wb->phy_rd);
+                        wb->has_insn=FALSE;
+    }
+
+}
+
+void APEX_rob_commit_writeback(APEX_CPU *cpu){
+    for(int slot=0;slot<MAX_MACHINE_WIDTH;slot++){
+        commit_writeback(cpu, &cpu->rob_commit_writeback[slot]);
     }
-
 }
 
-int  APEX_rob_commit(APEX_CPU *cpu){
+/* Reports the fault of a completed ROB entry the way the functional model
+ * does and stops the simulation */
+static int
+report_fault(const APEX_CPU *cpu, const reorder_buffer_entry *entry)
+{
+    if (entry->fault == FAULT_ADDRESS)
+    {
+        fprintf(stderr, "APEX_Error: %s outside data memory, address %d at pc %d\n",
+                entry->opcode == OPCODE_LOAD ? "Load" : "Store", entry->fault_address,
+                entry->pc_value);
+    }
+    else
+    {
+        fprintf(stderr, "APEX_Error: Division %s in R %d at pc %d\n",
+                entry->fault == FAULT_DIV_ZERO ? "by zero" : "overflow",
+                cpu->code_memory[get_code_memory_index_from_pc(entry->pc_value)].rs2,
+                entry->pc_value);
+    }
+    return APEX_STATUS_FAULT;
+}
 
-        APEX_rob_commit_writeback(cpu);
+/* Retires the ROB head if it completed, an instruction with a destination
+ * register goes on to the commit writeback latch wb. Returns
+ * APEX_STATUS_HALTED for HALT and APEX_STATUS_FAULT, without retiring it, for
+ * a load or store outside the data memory or a DIV by zero or overflow */
+static int
+commit_rob_head(APEX_CPU *cpu, CPU_Stage *wb){
         if(cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated){
             //check the instruction type if it is register to register
             switch (cpu->rob.reorder_buffer_queue[cpu->rob.head].insn_type)
@@ -1426,20 +2141,26 @@ int  APEX_rob_commit(APEX_CPU *cpu){
             case 1:
             case 0:
                 if(cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode==OPCODE_HALT){
-                    return TRUE;
+                    cpu->insn_completed++;
+                    return APEX_STATUS_HALTED;
+                }
+                else if(cpu->rob.reorder_buffer_queue[cpu->rob.head].status_bit &&
+                        cpu->rob.reorder_buffer_queue[cpu->rob.head].fault){
+                    return report_fault(cpu, &cpu->rob.reorder_buffer_queue[cpu->rob.head]);
                 }
                 else if(cpu->rob.reorder_buffer_queue[cpu->rob.head].status_bit){
 
                     //push the content to rob commt write back 
-                    cpu->rob_commit_writeback.rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
-                    cpu->rob_commit_writeback.phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
-                    cpu->rob_commit_writeback.opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
-                    cpu->rob_commit_writeback.has_insn=TRUE;
+                    wb->rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
+                    wb->phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
+                    wb->opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
+                    wb->has_insn=TRUE;
 
-                    printf("ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
+                    APEX_LOG(cpu, VERBOSITY_FULL, "ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
                     //free the rob entry and change the head
-                    cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated=0;
-                    cpu->rob.head=(cpu->rob.head+1)%ROB_SIZE;
+                    reorder_buffer_release(&cpu->rob, cpu->rob.head);
+                    cpu->insn_completed++;
+                    cpu->rob.head=(cpu->rob.head+1)%cpu->rob.size;
                 }
                 break;
         
@@ -1487,7 +2208,7 @@ int  APEX_rob_commit(APEX_CPU *cpu){
                 //     printf("ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
                 //     //free the rob entry and change the head
                 //     cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated=0;
-                //     cpu->rob.head=(cpu->rob.head+1)%ROB_SIZE;
+                //     cpu->rob.head=(cpu->rob.head+1)%cpu->rob.size;
 
                 //     //update the rename table if the architectural register's most recent value is the same as the physical register
                 //     if(cpu->mri[cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address]==cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register){
@@ -1500,11 +2221,13 @@ int  APEX_rob_commit(APEX_CPU *cpu){
                 if(cpu->rob.reorder_buffer_queue[cpu->rob.head].status_bit ){
                     if(cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode==OPCODE_JALR){
 
-                        cpu->rob_commit_writeback.rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
-                        cpu->rob_commit_writeback.phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
-                        cpu->rob_commit_writeback.opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
-                        cpu->rob_commit_writeback.has_insn=TRUE;
+                        wb->rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
+                        wb->phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
+                        wb->opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
+                        wb->has_insn=TRUE;
                     }
+                    cpu->stats.branches++;
+                    cpu->stats.branch_mispredicts+=cpu->rob.reorder_buffer_queue[cpu->rob.head].mispredicted;
 
 
 
@@ -1520,30 +2243,36 @@ int  APEX_rob_commit(APEX_CPU *cpu){
                         // if(cpu->mri[cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address]==cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register){
                         //     cpu->rnt.rename_table[cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address].register_source=0;
                         // }
-                        printf("ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);   
+                        APEX_LOG(cpu, VERBOSITY_FULL, "ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);   
                         //free the rob entry and change the head
-                        cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated=0;
-                        cpu->rob.head=(cpu->rob.head+1)%ROB_SIZE;
+                        reorder_buffer_release(&cpu->rob, cpu->rob.head);
+                        cpu->insn_completed++;
+                        cpu->rob.head=(cpu->rob.head+1)%cpu->rob.size;
                 }
                 break;
             //memory insn
             case 3:
+                if(cpu->rob.reorder_buffer_queue[cpu->rob.head].status_bit &&
+                   cpu->rob.reorder_buffer_queue[cpu->rob.head].fault){
+                    return report_fault(cpu, &cpu->rob.reorder_buffer_queue[cpu->rob.head]);
+                }
                 if(cpu->rob.reorder_buffer_queue[cpu->rob.head].status_bit){
                     //check if the memory insn is load or store
                     if(cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode==OPCODE_LOAD){
 
-                        cpu->rob_commit_writeback.rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
-                        cpu->rob_commit_writeback.phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
-                        cpu->rob_commit_writeback.opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
-                        cpu->rob_commit_writeback.has_insn=TRUE;
+                        wb->rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address;
+                        wb->phy_rd=cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
+                        wb->opcode=cpu->rob.reorder_buffer_queue[cpu->rob.head].opcode;
+                        wb->has_insn=TRUE;
 
                         // cpu->arf.architectural_register_file[cpu->rob.reorder_buffer_queue[cpu->rob.head].destination_address].value=
                         // cpu->prf.physical_register[cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register].reg_value;
                         // cpu->free_prf_q.free_physical_registers[cpu->free_prf_q.tail]= cpu->rob.reorder_buffer_queue[cpu->rob.head].physical_register;
                     }
-                    printf("ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
-                    cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated=0;
-                    cpu->rob.head=(cpu->rob.head+1)%ROB_SIZE;
+                    APEX_LOG(cpu, VERBOSITY_FULL, "ROB commit: I[%d]\n", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
+                    reorder_buffer_release(&cpu->rob, cpu->rob.head);
+                    cpu->insn_completed++;
+                    cpu->rob.head=(cpu->rob.head+1)%cpu->rob.size;
                     }
                 break;
             
@@ -1551,15 +2280,173 @@ int  APEX_rob_commit(APEX_CPU *cpu){
                 break;
             }
     }
+    return APEX_STATUS_RUNNING;
+}
+
+/* Retires up to commit_width completed instructions from the ROB head in
+ * program order, returns APEX_STATUS_HALTED once HALT retired and
+ * APEX_STATUS_FAULT once a faulting load, store or DIV reached the head */
+int  APEX_rob_commit(APEX_CPU *cpu){
+    int width=stage_width(cpu, cpu->config.commit_width);
+
+    APEX_rob_commit_writeback(cpu);
+    for(int slot=0;slot<width;slot++){
+        int retired=cpu->insn_completed;
+        int status=commit_rob_head(cpu, &cpu->rob_commit_writeback[slot]);
+
+        if(status!=APEX_STATUS_RUNNING){
+            //instructions retired before it still update the register file
+            APEX_rob_commit_writeback(cpu);
+            return status;
+        }
+        if(cpu->insn_completed==retired){
+            break;
+        }
+    }
+    return APEX_STATUS_RUNNING;
+}
+
+/* Builds the functional unit pool from the count, latency and pipelining of
+ * each class, a memory unit gets one stage per MSHR */
+static int
+allocate_fu_pool(APEX_CPU *cpu)
+{
+    const APEX_Config *config = &cpu->config;
+    const int units[NUM_FU_CLASSES] = {
+        config->int_units, config->mul_units, config->branch_units, config->mem_units,
+    };
+    const int latency[NUM_FU_CLASSES] = {
+        config->int_latency, config->mul_latency, config->branch_latency, config->memory_latency,
+    };
+    const int pipelined[NUM_FU_CLASSES] = {
+        config->int_pipelined, config->mul_pipelined, config->branch_pipelined, 0,
+    };
+    int n = 0;
+
+    for (int c = 0; c < NUM_FU_CLASSES; ++c)
+    {
+        n += units[c];
+    }
+    cpu->fu_pool = calloc(n, sizeof(functional_unit));
+    if (!cpu->fu_pool)
+    {
+        return -1;
+    }
+    cpu->fu_pool_size = n;
+
+    n = 0;
+    for (int c = 0; c < NUM_FU_CLASSES; ++c)
+    {
+        cpu->fu_first[c] = n;
+        cpu->fu_units[c] = units[c];
+        for (int u = 0; u < units[c]; ++u, ++n)
+        {
+            functional_unit *fu = &cpu->fu_pool[n];
+
+            fu->fu_class = c;
+            fu->index = u;
+            fu->latency = latency[c];
+            fu->pipelined = pipelined[c];
+            fu->num_stages = c == MEM_FU ? config->memory_mshrs : pipelined[c] ? latency[c] : 1;
+            fu->stages = calloc(fu->num_stages, sizeof(CPU_Stage));
+            if (!fu->stages)
+            {
+                return -1;
+            }
+        }
+    }
     return 0;
 }
 
-APEX_CPU *APEX_cpu_init(const char *filename)
+/* Allocates every dynamically sized structure of the cpu from its config */
+static int
+allocate_structures(APEX_CPU *cpu)
+{
+    cpu->data_memory_size = cpu->config.data_memory_size;
+    cpu->data_memory = calloc(cpu->data_memory_size, sizeof(int));
+    /* One spare entry, so that a fetch buffer of size 0 is allocated as well */
+    cpu->fetch_buffer = calloc(cpu->config.fetch_buffer_size + 1, sizeof(CPU_Stage));
+    if (!cpu->data_memory || !cpu->fetch_buffer)
+    {
+        return -1;
+    }
+    if (physical_register_file_init(&cpu->prf, cpu->config.physical_registers_size) ||
+        free_physical_registers_init(&cpu->free_prf_q, cpu->config.physical_registers_size) ||
+        issue_queue_init(&cpu->iq, cpu->config.issue_queue_size) ||
+        lsq_init(&cpu->lsq, cpu->config.lsq_size) ||
+        reorder_buffer_init(&cpu->rob, cpu->config.rob_size) ||
+        rename_checkpoint_init(&cpu->checkpoints, cpu->config.branch_checkpoints) ||
+        branch_predictor_init(&cpu->bp, cpu->config.branch_predictor, cpu->config.btb_size,
+                              cpu->config.predictor_table_size, cpu->config.history_length,
+                              cpu->config.ras_size) ||
+        store_set_init(&cpu->ssp, cpu->config.memory_dependence, cpu->config.ssit_size) ||
+        prefetcher_init(&cpu->pf, cpu->config.prefetcher, cpu->config.prefetch_degree,
+                        cpu->config.prefetch_distance, cpu->config.prefetch_table_size) ||
+        dram_init(&cpu->dram, cpu->config.dram_channels, cpu->config.dram_banks,
+                  cpu->config.dram_row_size, cpu->config.dram_row_hit_latency,
+                  cpu->config.dram_row_miss_latency, cpu->config.dram_row_conflict_latency,
+                  cpu->config.dram_burst_cycles, cpu->config.dram_queue_size,
+                  cpu->config.dram_page_policy == DRAM_CLOSE_PAGE) ||
+        mmu_init(&cpu->mmu, cpu->config.dtlb_entries, cpu->config.dtlb_assoc,
+                 cpu->config.l2_tlb_entries, cpu->config.l2_tlb_assoc, cpu->config.l2_tlb_latency,
+                 cpu->config.page_size, cpu->config.page_table_levels, cpu->config.page_walkers) ||
+        cache_init(&cpu->caches[CACHE_L1D], cpu->config.l1d_size, cpu->config.l1d_assoc,
+                   cpu->config.l1d_line_size, cpu->config.l1d_latency,
+                   cpu->config.l1d_replacement) ||
+        cache_init(&cpu->caches[CACHE_L2], cpu->config.l2_size, cpu->config.l2_assoc,
+                   cpu->config.l2_line_size, cpu->config.l2_latency,
+                   cpu->config.l2_replacement) ||
+        cache_init(&cpu->caches[CACHE_L1I], cpu->config.l1i_size, cpu->config.l1i_assoc,
+                   cpu->config.l1i_line_size, cpu->config.l1i_latency,
+                   cpu->config.l1i_replacement) ||
+        allocate_fu_pool(cpu))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* Releases everything allocated by allocate_structures, safe on partial allocation */
+static void
+free_structures(APEX_CPU *cpu)
+{
+    free(cpu->data_memory);
+    free(cpu->fetch_buffer);
+    physical_register_file_free(&cpu->prf);
+    free_physical_registers_free(&cpu->free_prf_q);
+    issue_queue_free(&cpu->iq);
+    lsq_free(&cpu->lsq);
+    reorder_buffer_free(&cpu->rob);
+    rename_checkpoint_free(&cpu->checkpoints);
+    branch_predictor_free(&cpu->bp);
+    store_set_free(&cpu->ssp);
+    prefetcher_free(&cpu->pf);
+    dram_free(&cpu->dram);
+    mmu_free(&cpu->mmu);
+    for (int i = 0; i < NUM_CACHE_LEVELS; ++i)
+    {
+        cache_free(&cpu->caches[i]);
+    }
+    for (int i = 0; i < cpu->fu_pool_size; ++i)
+    {
+        free(cpu->fu_pool[i].stages);
+    }
+    free(cpu->fu_pool);
+}
+
+/*
+ * Creates a cpu running the given code memory, config selects the structure
+ * sizes and may be NULL for the defaults in apex_macros.h
+ *
+ * The code memory is only read, so any number of cpus may share one array
+ * created by create_code_memory; it stays owned by the caller.
+ */
+APEX_CPU *APEX_cpu_create(const APEX_Instruction *code_memory, int code_memory_size,
+                          const APEX_Config *config)
 {
-    int i;
     APEX_CPU *cpu;
 
-    if (!filename)
+    if (!code_memory)
     {
         return NULL;
     }
@@ -1571,317 +2458,509 @@ APEX_CPU *APEX_cpu_init(const char *filename)
         return NULL;
     }
 
-    /* Initialize PC, Registers and all pipeline stages */
-    cpu->pc = 4000;
-    memset(cpu->arf.architectural_register_file,0,sizeof(architectural_register_content)*ARCHITECTURAL_REGISTERS_SIZE);
-    memset(cpu->prf.physical_register,0,sizeof(physical_register_content)*PHYSICAL_REGISTERS_SIZE);
+    if (config)
+    {
+        cpu->config = *config;
+    }
+    else
+    {
+        APEX_config_init(&cpu->config);
+    }
 
-    memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE);
-    memset(cpu->iq.issue_queue,0,sizeof(issue_queue_entry)*ISSUE_QUEUE_SIZE);
-    cpu->single_step = ENABLE_SINGLE_STEP;
-    
-    //Initialization of free physiical registers
-    for (int i=0;i<PHYSICAL_REGISTERS_SIZE;i++){
-        cpu->free_prf_q.free_physical_registers[i]=i;  
+    if (APEX_config_check(&cpu->config) || allocate_structures(cpu))
+    {
+        free_structures(cpu);
+        free(cpu);
+        return NULL;
     }
-    cpu->free_prf_q.head=0;
-    cpu->free_prf_q.tail=PHYSICAL_REGISTERS_SIZE-1;
+
+    /* Initialize PC, Registers and all pipeline stages */
+    cpu->pc = 4000;
+    cpu->verbosity = VERBOSITY_FULL;
+    cpu->trace_out = stdout;
+    cpu->status = APEX_STATUS_RUNNING;
 
     for (int j=0;j<ARCHITECTURAL_REGISTERS_SIZE+1;j++){
         cpu->rnt.rename_table[j].mapped_to_physical_register=-1;
         cpu->rnt.rename_table[j].register_source=0;
     }
 
-    for (int i=0;i<PHYSICAL_REGISTERS_SIZE;i++){
-        cpu->prf.physical_register[i].reg_valid=0;
-        cpu->prf.physical_register[i].reg_value=0;
-    }
+    cpu->code_memory = code_memory;
+    cpu->code_memory_size = code_memory_size;
+
+    /* To start fetch stage */
+    cpu->fetch.has_insn = TRUE;
+    cpu->fetch_line = -1;
+    cpu->fetch_line_request = -1;
+    return cpu;
+}
+
+/*
+ * Creates a cpu for the given program, config selects the structure sizes and
+ * may be NULL for the defaults in apex_macros.h
+ */
+APEX_CPU *APEX_cpu_init(const char *filename, const APEX_Config *config)
+{
+    APEX_CPU *cpu;
+    APEX_Instruction *code_memory;
+    int code_memory_size;
+
     /* Parse input file and create code memory */
-    cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
-    if (!cpu->code_memory)
+    code_memory = create_code_memory(filename, &code_memory_size);
+    if (!code_memory)
     {
-        free(cpu);
         return NULL;
     }
 
-    if (ENABLE_DEBUG_MESSAGES)
+    cpu = APEX_cpu_create(code_memory, code_memory_size, config);
+    if (!cpu)
     {
-        fprintf(stderr,
-                "APEX_CPU: Initialized APEX CPU, loaded %d instructions\n",
-                cpu->code_memory_size);
-        fprintf(stderr, "APEX_CPU: PC initialized to %d\n", cpu->pc);
-        fprintf(stderr, "APEX_CPU: Printing Code Memory\n");
-        printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode_str", "rd", "rs1", "rs2",
-               "imm");
-
-        for (i = 0; i < cpu->code_memory_size; ++i)
-        {
-            printf("%-9s %-9d %-9d %-9d %-9d\n", cpu->code_memory[i].opcode_str,
-                   cpu->code_memory[i].rd, cpu->code_memory[i].rs1,
-                   cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
-        }
+        free(code_memory);
+        return NULL;
     }
-
-    /* To start fetch stage */
-    cpu->fetch.has_insn = TRUE;
+    cpu->owns_code_memory = TRUE;
     return cpu;
 }
 
 /*
- * APEX CPU simulation loop
+ * Step hook which waits for a key press on the FILE * passed as data, 'q'
+ * stops the simulation
+ */
+int
+APEX_step_interactive(APEX_CPU *cpu, void *data)
+{
+    int user_prompt_val;
+
+    fprintf(cpu->trace_out, "Press any key to advance CPU Clock or <q> to quit:\n");
+    fflush(cpu->trace_out);
+    user_prompt_val = fgetc((FILE *)data);
+
+    if ((user_prompt_val == 'Q') || (user_prompt_val == 'q') || (user_prompt_val == EOF))
+    {
+        return APEX_STEP_STOP;
+    }
+    return APEX_STEP_CONTINUE;
+}
+
+/*
+ * Simulates one clock cycle
  *
- * Note: You are free to edit this function according to your implementation
+ * Returns APEX_STATUS_RUNNING while the program has not finished, otherwise
+ * the reason the simulation ended. Touches nothing outside cpu, so separate
+ * cpus can be stepped from separate threads.
  */
-void
-APEX_cpu_run(APEX_CPU *cpu)
+int
+APEX_cpu_step(APEX_CPU *cpu)
 {
-    char user_prompt_val;
+    if (cpu->status != APEX_STATUS_RUNNING)
+    {
+        return cpu->status;
+    }
 
-    while (TRUE)
+    if (cpu->clock == 0 && APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
     {
-        if (ENABLE_DEBUG_MESSAGES)
+        print_code_memory(cpu);
+    }
+
+    if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+    {
+        fprintf(cpu->trace_out, "--------------------------------------------\n");
+        fprintf(cpu->trace_out, "Clock Cycle #: %d\n", cpu->clock+1);
+        fprintf(cpu->trace_out, "--------------------------------------------\n");
+    }
+
+    APEX_writeback(cpu, BRANCH_FU);
+    APEX_writeback(cpu, INT_FU);
+    APEX_writeback(cpu, MUL_FU);
+    APEX_writeback(cpu, MEM_FU);
+    cpu->status = APEX_rob_commit(cpu);
+    if (cpu->status != APEX_STATUS_RUNNING)
+    {
+        /* Halt or fault in writeback stage */
+        cpu->clock++;
+        print_summary(cpu, cpu->status == APEX_STATUS_HALTED ? "Simulation Complete"
+                                                            : "Simulation Stopped at a fault",
+                      cpu->clock);
+        if (APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
         {
-            printf("--------------------------------------------\n");
-            printf("Clock Cycle #: %d\n", cpu->clock+1);
-            printf("--------------------------------------------\n");
-        }
-
-        APEX_branch_writeback(cpu);
-        APEX_int_writeback(cpu);  
-        APEX_mul_writeback(cpu);  
-        APEX_mem_writeback(cpu); 
-         if (APEX_rob_commit(cpu))
-         {
-             /* Halt in writeback stage */
-            printf("APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n", cpu->clock+1, cpu->insn_completed);
             print_reg_file(cpu);
-            break;
         }
+        return cpu->status;
+    }
 
-        APEX_bu_fwd(cpu);
-        APEX_memory_fwd(cpu);
-        APEX_int_fwd(cpu);
-        APEX_mul_fwd(cpu);
-        APEX_memory(cpu);
-        push_lsq_instruction_to_memory_fu(cpu);
-        APEX_process_iq(cpu);
-        
-        APEX_bu_fu(cpu);
-        APEX_mul_fu_4(cpu);
-        APEX_mul_fu_3(cpu);
-        APEX_mul_fu_2(cpu);
-        APEX_mul_fu_1(cpu);
-        APEX_int_fu(cpu);
-        //need to add branch funcytion unit here
-        APEX_queue_entry_addition(cpu);
-        APEX_rename_dispatch(cpu);
-        APEX_decode_rename(cpu);
-        APEX_fetch(cpu);
-        //print_lsq_entries(&cpu->lsq);
+    APEX_forward(cpu, BRANCH_FU);
+    APEX_forward(cpu, MEM_FU);
+    APEX_forward(cpu, INT_FU);
+    APEX_forward(cpu, MUL_FU);
+    APEX_memory(cpu);
+    APEX_page_walk(cpu);
+    push_lsq_instruction_to_memory_fu(cpu);
+    APEX_process_iq(cpu);
+
+    APEX_execute(cpu, BRANCH_FU);
+    APEX_execute(cpu, MUL_FU);
+    APEX_execute(cpu, INT_FU);
+    APEX_queue_entry_addition(cpu);
+    APEX_rename_dispatch(cpu);
+    APEX_decode_rename(cpu);
+    APEX_fetch(cpu);
+    APEX_dram(cpu);
+    //print_lsq_entries(&cpu->lsq, cpu->trace_out);
+    if (APEX_TRACE_ENABLED(cpu, VERBOSITY_FULL))
+    {
         print_reg_file(cpu);
 
         if(cpu->rob.reorder_buffer_queue[cpu->rob.head].is_allocated)
-            printf("ROB head= I[%d] ", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
-        int temp= (cpu->rob.tail-1+ROB_SIZE)%ROB_SIZE;
+            fprintf(cpu->trace_out, "ROB head= I[%d] ", (cpu->rob.reorder_buffer_queue[cpu->rob.head].pc_value-4000)/4);
+        int temp= (cpu->rob.tail-1+cpu->rob.size)%cpu->rob.size;
         if(cpu->rob.reorder_buffer_queue[temp].is_allocated)
-            printf("ROB tail= I[%d] \n", (cpu->rob.reorder_buffer_queue[temp].pc_value-4000)/4);
+            fprintf(cpu->trace_out, "ROB tail= I[%d] \n", (cpu->rob.reorder_buffer_queue[temp].pc_value-4000)/4);
+    }
 
-        
+    count_occupancy(cpu, 1);
+    cpu->clock++;
 
-        if (cpu->single_step)
-        {
-            printf("Press any key to advance CPU Clock or <q> to quit:\n");
-            scanf("%c", &user_prompt_val);
+    if (cpu->config.max_cycles && cpu->clock >= cpu->config.max_cycles)
+    {
+        cpu->status = APEX_STATUS_CYCLE_LIMIT;
+        print_summary(cpu, "Simulation Stopped at cycle limit", cpu->clock);
+    }
+    return cpu->status;
+}
 
-            if ((user_prompt_val == 'Q') || (user_prompt_val == 'q'))
-            {
-                printf("APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
-                break;
-            }
-        }
+/* True when a stepped cycle would leave a front end group as it is: it is
+ * empty, or next (NULL for dispatch) has no room and every instruction of
+ * the group already waits */
+static int
+group_idle(const CPU_Stage *group, const CPU_Stage *next, int width)
+{
+    int count=group_count(group);
 
-        cpu->clock++;
+    if(count && next && group_count(next)<width){
+        return FALSE;
+    }
+    for(int i=0;i<count;i++){
+        if(!group[i].is_stage_stalled){
+            return FALSE;
+        }
     }
+    return TRUE;
 }
 
 /*
- * This function deallocates APEX CPU.
+ * Returns how many of the coming cycles would only count down the memory
+ * accesses and unpipelined operations in flight and the instruction cache
+ * line fetch waits for, with no DRAM request starting, or 0 when the next
+ * cycle can do anything else
  *
- * Note: You are free to edit this function according to your implementation
+ * Such a cycle leaves every other latch where it is: nothing is ready to
+ * write back, forward, commit or issue, no other unit holds an instruction,
+ * no lsq entry can go to a free MSHR and each front end stage either is empty or is stalled behind the next one with
+ * its stall flag already set; fetch has no room or waits for its line. A blocked dispatch stays blocked since only
+ * commit and issue free its resources.
  */
-void
-APEX_cpu_stop(APEX_CPU *cpu)
+static long
+cycles_to_next_event(APEX_CPU *cpu)
 {
-    free(cpu->code_memory);
-    free(cpu);
-}
-
-
-
-
-//flush all instructions in the previous stages
+    const reorder_buffer_entry *head=&cpu->rob.reorder_buffer_queue[cpu->rob.head];
+    int dispatch_width=stage_width(cpu, cpu->config.dispatch_width);
+    long cycles=0;
+    int i;
 
-void flush_instructions(APEX_CPU *cpu, int rob_index){
+    //every busy unit must be counting down a multi cycle operation
+    for(i=0;i<cpu->fu_pool_size;i++){
+        const functional_unit *fu=&cpu->fu_pool[i];
 
-    printf("Flushing instructions\n");
-    printf("---------------------\n");
-    //flush all previous stages instructions
+        if(fu->fwd.has_insn || fu->writeback.has_insn){
+            return 0;
+        }
+        for(int k=0;k<fu->num_stages;k++){
+            //an access waiting for DRAM is bounded by the controller below
+            if(fu->stages[k].has_insn && fu->fu_class==MEM_FU && fu->stages[k].dram_request!=-1){
+                continue;
+            }
+            if(fu->stages[k].has_insn){
+                //a memory access counts down its own latency
+                int latency=fu->fu_class==MEM_FU?fu->stages[k].latency:fu->latency;
+                long left=fu->pipelined?0:latency-1-fu->stages[k].cycles;
 
-    // //flush fetch stage
-    // cpu->fetch.has_insn=FALSE;
-    //flush decode stage
-    cpu->decode_rename.has_insn=FALSE;
-    //flush rename dispatch stage
-    cpu->rename_dispatch.has_insn=FALSE;
-    //flush queue ebtry addition stage
-    cpu->queue_entry.has_insn=FALSE;
-    
-    //flush rob entries from given rob_index till tail of rob entries 
-    //check the condition < rob_index < rob_tail
-    for (int i=rob_index+1;i!=cpu->rob.tail;i=(i+1)%ROB_SIZE){
-        //issue queue entries invalidation");
-       for (int j=0; j<ISSUE_QUEUE_SIZE;j++){
-           if(cpu->iq.issue_queue[j].rob_index==i){
-               printf("IQ- I[%d] \n,", (cpu->iq.issue_queue[j].pc_value-4000)/4);
-               cpu->iq.issue_queue[j].is_allocated=0;
-               break;
-           }
-       }
-        int temp_lsq_index=-1;
-       //delete lsq entry previous to given rob_index
-        for (int j=cpu->lsq.head; j<cpu->lsq.tail;j=(j+1)%LSQ_SIZE){
-            if(cpu->lsq.load_store_queue[j].rob_index==i){
-                temp_lsq_index=j;
-                break;
+                if(left<=0){
+                    return 0;
+                }
+                if(!cycles || left<cycles){
+                    cycles=left;
+                }
             }
         }
-        if(temp_lsq_index>0){
-            //mark all lsq entries after given temp_lsq_index as invalid
-            for (int j=temp_lsq_index; j<cpu->lsq.tail;j=(j+1)%LSQ_SIZE){
-                printf("LSQ- I[%d] \n,", (cpu->iq.issue_queue[j].pc_value-4000)/4);
-                cpu->lsq.load_store_queue[j].allocate=0;
+    }
+    if(!cycles && !fetch_line_wait(cpu) && !cpu->dram.count && next_translation_event(cpu)==-1){
+        return 0;
+    }
+    for(i=0;i<MAX_MACHINE_WIDTH;i++){
+        if(cpu->rob_commit_writeback[i].has_insn){
+            return 0;
+        }
+    }
+    if(lsq_ready(cpu)){
+        for(i=0;i<cpu->fu_units[MEM_FU];i++){
+            if(free_mshr(&cpu->fu_pool[cpu->fu_first[MEM_FU]+i])){
+                return 0;
             }
-            cpu->lsq.tail=temp_lsq_index;
         }
-        if(cpu->rob.reorder_buffer_queue[i].destination_address!=100){
-            //add that physical register to free list head
-            cpu->free_prf_q.head=(cpu->free_prf_q.head-1+PHYSICAL_REGISTERS_SIZE)%PHYSICAL_REGISTERS_SIZE;
-            cpu->free_prf_q.free_physical_registers[cpu->free_prf_q.head]=cpu->rob.reorder_buffer_queue[i].physical_register;
+    }
+    if(head->is_allocated && (head->status_bit || head->opcode==OPCODE_HALT)){
+        return 0;
+    }
+    if(issue_queue_has_ready(&cpu->iq)){
+        return 0;
+    }
 
-            printf("Physical register %d freed\n", cpu->rob.reorder_buffer_queue[i].physical_register);
-            update_rename_table_with_backup(cpu,cpu->rob.reorder_buffer_queue[i].physical_register);
-            set_mri_from_backup(cpu,cpu->rob.reorder_buffer_queue[i].physical_register);
-        }
+    if(cpu->queue_entry[0].has_insn){
+        const CPU_Stage *insn=&cpu->queue_entry[0];
 
-        //check every fu entry to chekc whether its rob index is equal to given rob_index
+        if(insn->opcode==OPCODE_RET && ret_resolves_at_dispatch(cpu)){
+            const rename_table_content *src=&cpu->rnt.rename_table[insn->rs1];
 
-        if(cpu->int_fu.rob_index==i){
-            cpu->int_fu.has_insn=FALSE;
+            if(reorder_buffer_available(&cpu->rob)!=-1 &&
+               (!src->register_source ||
+                cpu->prf.physical_register[src->mapped_to_physical_register].reg_valid)){
+                return 0;
+            }
         }
-        if(cpu->mul1_fu.rob_index==i){
-            cpu->mul1_fu.has_insn=FALSE;
+        else if(!dispatch_blocked(cpu, insn, 0)){
+            return 0;
+        }
+    }
+    if(!group_idle(cpu->queue_entry, NULL, 0) ||
+       !group_idle(cpu->rename_dispatch, cpu->queue_entry, dispatch_width) ||
+       !group_idle(cpu->decode_rename, cpu->rename_dispatch, dispatch_width)){
+        return 0;
+    }
+    if(cpu->fetch_from_next_cycle ||
+       (cpu->fetch_buffer_count && group_count(cpu->decode_rename)<stage_width(cpu, cpu->config.fetch_width))){
+        return 0;
+    }
+    //fetch may only wait for an instruction cache line
+    if(cpu->fetch.has_insn && fetch_room(cpu)>0){
+        long wait=fetch_line_wait(cpu);
+
+        if(!wait){
+            return 0;
         }
-        if(cpu->mul2_fu.rob_index==i){
-            cpu->mul2_fu.has_insn=FALSE;
+        if(!cycles || wait<cycles){
+            cycles=wait;
         }
-        if(cpu->mul3_fu.rob_index==i){
-            cpu->mul3_fu.has_insn=FALSE;
+    }
+    //nor may the DRAM start a request
+    if(cpu->dram.count){
+        long wait=dram_next_event(&cpu->dram)-cpu->clock;
+
+        if(wait<=0){
+            return 0;
         }
-        if(cpu->mul4_fu.rob_index==i){
-            cpu->mul4_fu.has_insn=FALSE;
+        if(!cycles || wait<cycles){
+            cycles=wait;
         }
-        if(cpu->memory.rob_index==i){
-            cpu->memory.has_insn=FALSE;
+    }
+    //nor may a page walk move on or a translation finish
+    if(next_translation_event(cpu)!=-1){
+        long wait=next_translation_event(cpu)-cpu->clock;
+
+        if(wait<=0){
+            return 0;
         }
-        //fwd buses
-        if(cpu->int_fwd.rob_index==i){
-            cpu->int_fwd.has_insn=FALSE;
+        if(!cycles || wait<cycles){
+            cycles=wait;
         }
-        if(cpu->mul_fwd.rob_index==i){
-            cpu->mul_fwd.has_insn=FALSE;
+    }
+
+    return cycles;
+}
+
+/*
+ * Advances the clock over the idle cycles found by cycles_to_next_event,
+ * applying what those cycles would have done: the busy units count up, the
+ * issue queue entries wait for operands, a ready lsq entry waits for an MSHR,
+ * fetch waits for the instruction cache and a blocked dispatch is charged to
+ * its stall counters. The result is
+ * identical to stepping through them.
+ */
+static void
+skip_idle_cycles(APEX_CPU *cpu)
+{
+    long cycles=cycles_to_next_event(cpu);
+
+    if(cycles==0){
+        return;
+    }
+    if(cpu->config.max_cycles && cycles>cpu->config.max_cycles-cpu->clock){
+        cycles=cpu->config.max_cycles-cpu->clock;
+    }
+
+    for(int i=0;i<cpu->fu_pool_size;i++){
+        functional_unit *fu=&cpu->fu_pool[i];
+
+        for(int k=0;k<fu->num_stages;k++){
+            if(fu->stages[k].has_insn){
+                fu->stages[k].cycles+=cycles;
+                fu->stages[k].is_stage_stalled=1;
+            }
         }
-        if(cpu->memory_fwd.rob_index==i){
-            cpu->memory_fwd.has_insn=FALSE;
+    }
+    count_occupancy(cpu, cycles);
+    //a ready lsq entry found every MSHR in use
+    if(lsq_ready(cpu)){
+        cpu->stats.mshr_full_stalls+=cycles;
+    }
+    //nothing in the issue queue is ready
+    cpu->stats.operand_stalls+=cycles*cpu->iq.count;
+    if(cpu->fetch.has_insn && fetch_room(cpu)>0 && fetch_line_wait(cpu)){
+        cpu->stats.icache_stall_cycles+=cycles;
+    }
+    if(cpu->queue_entry[0].has_insn){
+        if(cpu->queue_entry[0].opcode!=OPCODE_RET || !ret_resolves_at_dispatch(cpu)){
+            dispatch_blocked(cpu, &cpu->queue_entry[0], cycles);
         }
-        if(cpu->int_writeback.rob_index==i){
-            cpu->int_writeback.has_insn=FALSE;
+        else if(reorder_buffer_available(&cpu->rob)==-1){
+            cpu->stats.rob_full_stalls+=cycles;
         }
-        if(cpu->mul_writeback.rob_index==i){
-            cpu->mul_writeback.has_insn=FALSE;
+    }
+    cpu->clock+=cycles;
+
+    if (cpu->config.max_cycles && cpu->clock >= cpu->config.max_cycles)
+    {
+        cpu->status = APEX_STATUS_CYCLE_LIMIT;
+        print_summary(cpu, "Simulation Stopped at cycle limit", cpu->clock);
+    }
+}
+
+/*
+ * APEX CPU simulation loop, runs until the program halts, the cycle limit is
+ * reached or the step hook asks to stop
+ *
+ * Unless stage tracing is on, cycles in which only memory accesses and
+ * unpipelined operations count down are skipped in one go (config.skip_idle_cycles), the step hook then
+ * sees the clock advance by more than one cycle
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+int
+APEX_cpu_run(APEX_CPU *cpu)
+{
+    while (APEX_cpu_step(cpu) == APEX_STATUS_RUNNING)
+    {
+        if (cpu->step_fn && cpu->step_fn(cpu, cpu->step_data) == APEX_STEP_STOP)
+        {
+            cpu->status = APEX_STATUS_STOPPED;
+            print_summary(cpu, "Simulation Stopped", cpu->clock);
         }
-        if(cpu->mem_writeback.rob_index==i){
-            cpu->mem_writeback.has_insn=FALSE;
+        else if (cpu->config.skip_idle_cycles && !APEX_TRACE_ENABLED(cpu, VERBOSITY_STAGE))
+        {
+            skip_idle_cycles(cpu);
         }
-        //flush rob entry
-        cpu->rob.reorder_buffer_queue[i].is_allocated=0;
     }
-    cpu->rob.tail=rob_index+1;
-    printf("---------------------\n");
+    return cpu->status;
 }
 
+/*
+ * This function deallocates APEX CPU.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+void
+APEX_cpu_stop(APEX_CPU *cpu)
+{
+    if (cpu->owns_code_memory)
+    {
+        free((APEX_Instruction *)cpu->code_memory);
+    }
+    free_structures(cpu);
+    free(cpu);
+}
 
 
 
-//JUMP and JALR is branch instruction irrespective of the instruction type
-//check if the given instruction is branch instruction
-int is_branch_instruction(int opcode){
-    if(opcode==OPCODE_BNP || opcode==OPCODE_BP || 
-       opcode==OPCODE_BNZ || opcode==OPCODE_BZ || opcode==OPCODE_JUMP || opcode==OPCODE_JALR || opcode==OPCODE_RET){
-        return TRUE;
-    }
-    return FALSE;
-}
 
+//flush all instructions in the previous stages
 
+void flush_instructions(APEX_CPU *cpu, int rob_index){
 
-//backup for rename table
-void create_rename_table_backup( APEX_CPU *cpu){
-    for (int i=0;i<ARCHITECTURAL_REGISTERS_SIZE+1;i++){
-        cpu->rnt_bkp.rename_table[i].mapped_to_physical_register=cpu->rnt.rename_table[i].mapped_to_physical_register;
-        cpu->rnt_bkp.rename_table[i].register_source=cpu->rnt.rename_table[i].register_source;
-    }
-}
+    APEX_LOG(cpu, VERBOSITY_FULL, "Flushing instructions\n");
+    APEX_LOG(cpu, VERBOSITY_FULL, "---------------------\n");
+    //flush all previous stages instructions
+
+    // //flush fetch stage
+    // cpu->fetch.has_insn=FALSE;
+    //flush the decode, rename dispatch and queue entry addition groups
+    squash_front_end(cpu, 0);
+    
+    //rob entries younger than rob_index, up to the tail, are squashed
+    int first=(rob_index+1)%cpu->rob.size;
+    int squashed=(cpu->rob.tail-first+cpu->rob.size)%cpu->rob.size;
 
-//backup for mri
-void create_mri_backup( APEX_CPU *cpu){
-    for (int i=0;i<ARCHITECTURAL_REGISTERS_SIZE;i++){    
-        cpu->mri_bkp[i]=cpu->mri[i];
+    //issue queue entries invalidation
+    for (int j=0; j<cpu->iq.size;j++){
+        if(cpu->iq.issue_queue[j].is_allocated &&
+           (cpu->iq.issue_queue[j].rob_index-first+cpu->rob.size)%cpu->rob.size<squashed){
+            APEX_LOG(cpu, VERBOSITY_FULL, "IQ- I[%d] \n,", (cpu->iq.issue_queue[j].pc_value-4000)/4);
+            issue_queue_remove(&cpu->iq, j);
+        }
+    }
+    //the lsq is in program order, so everything from the oldest squashed
+    //memory instruction up to the tail goes
+    if(cpu->lsq.count){
+        int j=cpu->lsq.head;
+        do{
+            if((cpu->lsq.load_store_queue[j].rob_index-first+cpu->rob.size)%cpu->rob.size<squashed){
+                int k=j;
+                do{
+                    APEX_LOG(cpu, VERBOSITY_FULL, "LSQ- I[%d] \n,", (cpu->lsq.load_store_queue[k].pc_value-4000)/4);
+                    k=(k+1)%cpu->lsq.size;
+                }while(k!=cpu->lsq.tail);
+                lsq_truncate(&cpu->lsq, j);
+                break;
+            }
+            j=(j+1)%cpu->lsq.size;
+        }while(j!=cpu->lsq.tail);
     }
-}
 
+    //every functional unit latch that holds a squashed instruction, the
+    //branch units too since younger branches may be in flight in them
+    for (int j=0; j<cpu->fu_pool_size; j++){
+        functional_unit *fu=&cpu->fu_pool[j];
 
-//check rename table for physical register and update it with rename table backup
+        for (int k=-2; k<fu->num_stages; k++){
+            CPU_Stage *latch=k==-2?&fu->writeback:k==-1?&fu->fwd:&fu->stages[k];
 
-void update_rename_table_with_backup( APEX_CPU *cpu, int physical_register_address){
-    for (int i=0;i<ARCHITECTURAL_REGISTERS_SIZE;i++){
-        if(cpu->rnt.rename_table[i].register_source==1){
-            if(cpu->rnt.rename_table[i].mapped_to_physical_register==physical_register_address){
-                cpu->rnt.rename_table[i].mapped_to_physical_register=cpu->rnt_bkp.rename_table[i].mapped_to_physical_register;
-                cpu->rnt.rename_table[i].register_source= 1;
-                if(check_free_physical_register(cpu,cpu->rnt.rename_table[i].mapped_to_physical_register)){
-                    cpu->rnt.rename_table[i].register_source= 0;
-                }
-                
-                printf("Rename table updated with backup: R[%d]=P[%d]\n",i,cpu->rnt.rename_table[i].mapped_to_physical_register);
+            if((latch->rob_index-first+cpu->rob.size)%cpu->rob.size<squashed){
+                latch->has_insn=FALSE;
             }
         }
     }
-}
 
+    //rename goes back to the checkpoint of the branch in one step, which
+    //also frees every physical register allocated after it
+    int ckpt=rename_checkpoint_find(&cpu->checkpoints, rob_index);
+    if(ckpt!=-1){
+        rename_checkpoint_restore(&cpu->checkpoints, ckpt, &cpu->rnt, cpu->mri, &cpu->free_prf_q);
+        rename_checkpoint_release(&cpu->checkpoints, ckpt);
+        APEX_LOG(cpu, VERBOSITY_FULL, "Rename state restored from checkpoint %d\n", ckpt);
+    }
+    rename_checkpoint_squash(&cpu->checkpoints, first, squashed, cpu->rob.size);
 
-void set_mri_from_backup( APEX_CPU *cpu, int physical_register_address){
-    cpu->mri_bkp[physical_register_address]=cpu->mri[physical_register_address];
+    reorder_buffer_truncate(&cpu->rob, first);
+    APEX_LOG(cpu, VERBOSITY_FULL, "---------------------\n");
 }
 
 
 
-int check_free_physical_register(APEX_CPU *cpu, int physical_register_address){
 
-    //check free physical register queue
-        for (int i=cpu->free_prf_q.head;i!=cpu->free_prf_q.tail;i=(i+1)%PHYSICAL_REGISTERS_SIZE){
-            if(cpu->free_prf_q.free_physical_registers[i]==physical_register_address){
-                return TRUE;
-            }
-        }
-        return FALSE;
-}
\ No newline at end of file
+//JUMP and JALR is branch instruction irrespective of the instruction type
+//check if the given instruction is branch instruction
+int is_branch_instruction(int opcode){
+    if(opcode==OPCODE_BNP || opcode==OPCODE_BP || 
+       opcode==OPCODE_BNZ || opcode==OPCODE_BZ || opcode==OPCODE_JUMP || opcode==OPCODE_JALR || opcode==OPCODE_RET){
+        return TRUE;
+    }
+    return FALSE;
+}
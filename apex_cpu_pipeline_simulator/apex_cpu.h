@@ -9,6 +9,8 @@
 #ifndef _APEX_CPU_H_
 #define _APEX_CPU_H_
 
+#include <stdio.h>
+
 #ifndef _MACROS_H_
 #include "apex_macros.h"
 #endif
@@ -29,59 +31,105 @@
 #include "physical_register.h"
 #endif
 
-/* Format of an APEX instruction  */
+#ifndef _XXYZ_RENAME_CHECKPOINT_
+#include "rename_checkpoint.h"
+#endif
+
+#ifndef _XXYZ_BRANCH_PREDICTOR_
+#include "branch_predictor.h"
+#endif
+
+#ifndef _XXYZ_CACHE_
+#include "cache.h"
+#endif
+
+#ifndef _XXYZ_PREFETCH_
+#include "prefetch.h"
+#endif
+
+#ifndef _XXYZ_DRAM_
+#include "dram.h"
+#endif
+
+#ifndef _XXYZ_TLB_
+#include "tlb.h"
+#endif
+
+#ifndef _APEX_CONFIG_H_
+#include "apex_config.h"
+#endif
+
+struct CPU_Stage;
+
+/* Computes the result of an instruction in the integer or multiplication unit */
+typedef void (*APEX_Execute_fn)(struct CPU_Stage *stage);
+
+/* Format of an APEX instruction, decoded once when the program is loaded:
+ * the opcode properties below come from the table in apex_isa.c and the
+ * mnemonic is looked up from the opcode only when printing */
 typedef struct APEX_Instruction
 {
-    char opcode_str[128];
     int opcode;
     int rd;
     int rs1;
     int rs2;
     int imm;
+    signed char fu;
+    signed char is_physical_register_required;
+    signed char is_src1_register_required;
+    signed char is_src2_register_required;
+    signed char is_memory_insn;
+    signed char memory_instruction_type;
+    APEX_Execute_fn execute;
 } APEX_Instruction;
 
-/* Model of CPU stage latch */
+/* Model of CPU stage latch
+ *
+ * Every stage advances by copying its latch into the next one, so the latch
+ * only holds the micro-op itself: the opcode string stays in code memory and
+ * flags, opcodes and architectural register numbers take one byte each */
 typedef struct CPU_Stage
 {
+    branch_predictor_state bp_state; //predictor state the instruction was fetched with
     int pc;
-    char opcode_str[128];
-    int opcode;
-    int rs1;
     int phy_rs1;
     int phy_rs2;
-    int rs2;
-    int rd;
     int phy_rd; //physical register allocated from free physical list  
     int imm;
-    int rs1_ready;
-    int rs2_ready;
     int rs1_value;
     int rs2_value;
     int result_buffer;
     int memory_address;
-    int has_insn;
-    int is_physical_register_required;
-    int is_src1_register_required;
-    int is_src2_register_required;
-    int is_memory_insn;
-    int is_stage_stalled;
     int issue_queue_index;
-    int memory_instruction_type;
-    int fu;
     int rob_index;
     int lsq_index;
     int cycles;
-    int positive_flag;
-    int zero_flag;
-    int need_to_flush;
-    int insn_type;
+    int latency;                   //cycles this memory access takes, counted from
+                                   //the data of dram_request while it is pending
+    int dram_request;              //DRAM request the access waits for, -1 for none
     int pc_value_to_be_taken;
+    int predicted_pc;              //pc fetched after this instruction
 
-
-    load_store_queue_entry temp_lsq_entry;
-    reorder_buffer_entry temp_rob_entry;
-    issue_queue_entry temp_iq_entry;
-    
+    signed char opcode;
+    signed char rs1;
+    signed char rs2;
+    signed char rd;
+    signed char rs1_ready;
+    signed char rs2_ready;
+    signed char has_insn;
+    signed char is_physical_register_required;
+    signed char is_src1_register_required;
+    signed char is_src2_register_required;
+    signed char is_memory_insn;
+    signed char is_stage_stalled;
+    signed char memory_instruction_type;
+    signed char fu;
+    signed char positive_flag;
+    signed char zero_flag;
+    signed char need_to_flush;
+    signed char insn_type;
+    signed char forwarded;         //load took its data from an older store
+    signed char fault;             //FAULT_DIV_ZERO or FAULT_DIV_OVERFLOW of a DIV
 } CPU_Stage;
 
 ////////ARCHECTURAL_REGISTER_FILE///////////////
@@ -99,6 +147,79 @@ typedef struct archictectural_register_file{
 
 
 
+/* Event counters collected while the cpu runs */
+typedef struct APEX_Stats
+{
+    long rob_full_stalls;   /* Dispatch attempts without a free ROB entry */
+    long iq_full_stalls;    /* Dispatch attempts without a free IQ entry */
+    long lsq_full_stalls;   /* Dispatch attempts without a free LSQ entry */
+    long prf_empty_stalls;  /* Renames without a free physical register */
+    long checkpoint_full_stalls; /* Branch dispatches without a free rename checkpoint */
+    long fu_busy_stalls;    /* Ready IQ entries left waiting for a functional unit
+                             * or issue slot, summed over all cycles */
+    long operand_stalls;    /* IQ entries waiting for a source operand, summed
+                             * over all cycles */
+    long mshr_full_stalls;  /* Cycles an LSQ entry was ready but every memory
+                             * unit had all its accesses in flight */
+    long loads;             /* Loads sent from the LSQ to a memory unit */
+    long loads_forwarded;   /* Loads that took their data from an older store */
+    long loads_bypassed;    /* Loads that read memory ahead of an older store
+                             * still in the LSQ */
+    long loads_speculated;  /* Loads that went ahead of an older store whose
+                             * address was not known yet */
+    long memory_violations; /* Speculative loads replayed because an older
+                             * store turned out to write their address */
+    long violation_squashed; /* Instructions flushed by those replays */
+    long branches;          /* Committed branches resolved in the branch unit */
+    long branch_mispredicts; /* Committed branches that redirected fetch */
+    cache_stats caches[NUM_CACHE_LEVELS]; /* Accesses, misses, miss cycles and
+                             * writebacks of each cache level */
+    long icache_stall_cycles; /* Cycles fetch waited for an instruction cache line */
+    long fetch_buffer_occupancy; /* Fetch buffer entries in use, summed over all cycles */
+    long prefetches;        /* Lines the prefetcher brought into the cache */
+    long prefetch_hits;     /* Prefetched lines a demand access used */
+    long prefetch_late;     /* Of those, lines the access still waited for */
+    dram_stats dram;        /* Requests, row buffer outcomes and bus use of the DRAM */
+    long dtlb_accesses;     /* Loads and stores translated */
+    long dtlb_misses;
+    long l2_tlb_accesses;   /* DTLB misses looked up in the second level TLB */
+    long l2_tlb_misses;
+    long page_walks;        /* Walks finished */
+    long walk_cycles;       /* Cycles from their start to the last entry read */
+    long rob_occupancy;     /* ROB entries in use, summed over all cycles */
+    long iq_occupancy;      /* IQ entries in use, summed over all cycles */
+    long lsq_occupancy;     /* LSQ entries in use, summed over all cycles */
+    long mshr_occupancy;    /* Memory accesses in flight, summed over all cycles */
+} APEX_Stats;
+
+/* One unit of the functional unit pool. An instruction spends latency cycles
+ * in it: a pipelined unit moves it one stage a cycle and takes another one
+ * every cycle, an unpipelined unit keeps it in stages[0] until it is done.
+ * It then goes on the unit's forward bus and writeback latches.
+ *
+ * A memory unit instead has one stage per MSHR (memory_mshrs). It takes an
+ * access from the LSQ every cycle while one is free, each access counts
+ * down its own latency and the oldest finished one leaves each cycle, so
+ * accesses can finish out of order. */
+typedef struct functional_unit
+{
+    int fu_class;                  /* INT_FU, MUL_FU, BRANCH_FU or MEM_FU */
+    int index;                     /* Among the units of its class */
+    int latency;
+    int pipelined;
+    int num_stages;                /* latency when pipelined, otherwise 1;
+                                    * memory_mshrs for a memory unit */
+    CPU_Stage *stages;
+    CPU_Stage fwd;
+    CPU_Stage writeback;
+} functional_unit;
+
+struct APEX_CPU;
+
+/* Called after every simulated cycle (or skipped run of idle cycles) by
+ * APEX_cpu_run, returns APEX_STEP_CONTINUE or APEX_STEP_STOP */
+typedef int (*APEX_step_fn)(struct APEX_CPU *cpu, void *data);
+
 /* Model of APEX CPU */
 typedef struct APEX_CPU
 {
@@ -106,73 +227,86 @@ typedef struct APEX_CPU
     int clock;                     /* Clock cycles elapsed */
     int insn_completed;            /* Instructions retired */
     int code_memory_size;          /* Number of instruction in the input file */
-    APEX_Instruction *code_memory; /* Code Memory */
-    int data_memory[DATA_MEMORY_SIZE]; /* Data Memory */
+    const APEX_Instruction *code_memory; /* Code Memory */
+    int owns_code_memory;          /* Free code memory in APEX_cpu_stop */
+    int status;                    /* One of APEX_STATUS_* */
+    int *data_memory;              /* Data Memory */
+    int data_memory_size;          /* Words in data memory */
+    APEX_Config config;            /* Structure sizes of this instance */
     int mri[ARCHITECTURAL_REGISTERS_SIZE+1];
-    int mri_bkp[ARCHITECTURAL_REGISTERS_SIZE+1];
-    int single_step;               /* Wait for user input after every cycle */
+    int verbosity;                 /* One of VERBOSITY_* */
+    FILE *trace_out;               /* Sink for all messages of this cpu, stdout by default */
+    APEX_step_fn step_fn;          /* Hook run after every cycle, NULL to free run */
+    void *step_data;               /* Passed to step_fn */
     int zero_flag;                 /* {TRUE, FALSE} Used by BZ and BNZ to branch */
     int positive_flag;
     int fetch_from_next_cycle;
 
-    /* Pipeline stages */
+    /* Pipeline stages, the in order ones hold a group of instructions that
+     * fills the slots from 0, oldest first */
     CPU_Stage fetch;
-    CPU_Stage decode_rename;
-    CPU_Stage rename_dispatch;
-    CPU_Stage queue_entry;
-    CPU_Stage bu_fu;
-    CPU_Stage int_fu;
-    CPU_Stage mul1_fu;
-    CPU_Stage mul2_fu;
-    CPU_Stage mul3_fu;
-    CPU_Stage mul4_fu;
+    CPU_Stage *fetch_buffer;       /* Ring of fetch_buffer_size fetched instructions
+                                    * waiting for room in the decode group */
+    int fetch_buffer_head;         /* Oldest one */
+    int fetch_buffer_count;
+    int fetch_line;                /* Instruction cache line fetch reads from, -1 for none */
+    int fetch_line_ready;          /* Cycle fetch can read it, counted from the data
+                                    * of fetch_line_request while it is pending */
+    int fetch_line_request;        /* DRAM request the line waits for, -1 for none */
+    CPU_Stage decode_rename[MAX_MACHINE_WIDTH];
+    CPU_Stage rename_dispatch[MAX_MACHINE_WIDTH];
+    CPU_Stage queue_entry[MAX_MACHINE_WIDTH];
     CPU_Stage process_iq;
-    CPU_Stage int_writeback;
-    CPU_Stage mul_writeback;
-    CPU_Stage mem_writeback;
-    CPU_Stage branch_writeback;
-    CPU_Stage memory;
-    CPU_Stage int_fwd;
-    CPU_Stage mul_fwd;
-    CPU_Stage bu_fwd;
-    CPU_Stage rob_commit_writeback;
+    CPU_Stage rob_commit_writeback[MAX_MACHINE_WIDTH];
     CPU_Stage rob_commit;
-    CPU_Stage memory_fwd;
     CPU_Stage writeback;
 
+    /* Functional units of every class, the units of a class are adjacent */
+    functional_unit *fu_pool;
+    int fu_pool_size;
+    int fu_first[NUM_FU_CLASSES];  /* Pool index of the first unit of a class */
+    int fu_units[NUM_FU_CLASSES];
+
     physical_register_file prf;
     archictectural_register_file arf;
     free_physical_registers_queue free_prf_q;
     rename_table_mapping rnt;
-    rename_table_mapping rnt_bkp;
+    rename_checkpoint_stack checkpoints; /* One per unresolved branch or speculative load */
+    branch_predictor bp;
+    store_set_predictor ssp;        /* Memory dependence predictor of the LSQ */
+    cache caches[NUM_CACHE_LEVELS]; /* Caches in front of the data memory and, for
+                                     * the L1I, of the code memory */
+    prefetcher pf;                  /* Data prefetcher of the first data cache */
+    dram dram;                      /* Memory behind the caches */
+    mmu mmu;                        /* TLBs and page walkers of the data addresses */
     issue_queue_buffer iq;
     load_store_queue lsq;
     reorder_buffer rob;
 
+    APEX_Stats stats;
+
 
 } APEX_CPU;
 
 APEX_Instruction *create_code_memory(const char *filename, int *size);
-APEX_CPU *APEX_cpu_init(const char *filename);
-void APEX_cpu_run(APEX_CPU *cpu);
+APEX_CPU *APEX_cpu_init(const char *filename, const APEX_Config *config);
+APEX_CPU *APEX_cpu_create(const APEX_Instruction *code_memory, int code_memory_size,
+                          const APEX_Config *config);
+int APEX_cpu_step(APEX_CPU *cpu);
+int APEX_cpu_run(APEX_CPU *cpu);
+int APEX_step_interactive(APEX_CPU *cpu, void *data);
 void APEX_cpu_stop(APEX_CPU *cpu);
-void push_information_to_fu(APEX_CPU *cpu, int index, int fu);
+int APEX_cpu_save(const APEX_CPU *cpu, const char *filename);
+APEX_CPU *APEX_cpu_load(const char *filename, const APEX_Instruction *code_memory,
+                        int code_memory_size, const APEX_Config *config);
+void push_information_to_fu(APEX_CPU *cpu, int index, functional_unit *fu);
 int  APEX_rob_commit(APEX_CPU *cpu);
 
 
 void APEX_memory(APEX_CPU *cpu);
-void APEX_int_fu(APEX_CPU *cpu);
-void APEX_mul_fu_1(APEX_CPU *cpu);
-void APEX_mul_fu_2(APEX_CPU *cpu);
-void APEX_mul_fu_3(APEX_CPU *cpu);
-void APEX_mul_fu_4(APEX_CPU *cpu);
+void APEX_execute(APEX_CPU *cpu, int fu_class);
 void APEX_process_iq(APEX_CPU *cpu);
-void create_rename_table_backup( APEX_CPU *cpu);
-void create_mri_backup( APEX_CPU *cpu);
-void update_rename_table_with_backup( APEX_CPU *cpu, int physical_register_address);
-void set_mri_from_backup( APEX_CPU *cpu, int physical_register_address);
 void flush_instructions(APEX_CPU *cpu, int rob_index);
 int is_branch_instruction(int opcode);
-int check_free_physical_register(APEX_CPU *cpu, int physical_register_address);
 #endif
 
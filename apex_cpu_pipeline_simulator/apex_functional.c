@@ -0,0 +1,251 @@
+/*
+ * apex_functional.c
+ * Functional APEX simulator: executes one instruction per call directly on
+ * the architectural registers and data memory, with the same instruction
+ * semantics as the pipeline in apex_cpu.c but none of its timing
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_functional.h"
+
+/* Creates the architectural state of a program about to execute its first
+ * instruction, code memory stays owned by the caller */
+APEX_Functional *
+APEX_functional_create(const APEX_Instruction *code_memory, int code_memory_size,
+                       const APEX_Config *config)
+{
+    APEX_Functional *func;
+
+    func = calloc(1, sizeof(APEX_Functional));
+    if (!func)
+    {
+        return NULL;
+    }
+
+    func->data_memory_size = config->data_memory_size;
+    func->data_memory = calloc(func->data_memory_size, sizeof(int));
+    if (!func->data_memory)
+    {
+        free(func);
+        return NULL;
+    }
+
+    func->pc = 4000;
+    func->status = APEX_STATUS_RUNNING;
+    func->code_memory = code_memory;
+    func->code_memory_size = code_memory_size;
+    return func;
+}
+
+void
+APEX_functional_free(APEX_Functional *func)
+{
+    free(func->data_memory);
+    free(func);
+}
+
+/* Stops the program on an access the pipeline would have performed unchecked */
+static int
+functional_fault(APEX_Functional *func, const char *reason, int value)
+{
+    fprintf(stderr, "APEX_Error: %s %d at pc %d\n", reason, value, func->pc);
+    func->status = APEX_STATUS_FAULT;
+    return func->status;
+}
+
+/*
+ * Executes the instruction at pc
+ *
+ * Returns the status after it, APEX_STATUS_RUNNING until HALT executes.
+ * Arithmetic that sets flags in the pipeline records its destination as
+ * the register BZ/BNZ test, which is what the pipeline reads once that
+ * instruction has committed.
+ */
+int
+APEX_functional_step(APEX_Functional *func)
+{
+    const APEX_Instruction *ins;
+    int index = (func->pc - 4000) / 4;
+    int next_pc = func->pc + 4;
+    int address;
+
+    if (func->status != APEX_STATUS_RUNNING)
+    {
+        return func->status;
+    }
+    if (index < 0 || index >= func->code_memory_size || (func->pc - 4000) % 4)
+    {
+        return functional_fault(func, "Fetch outside code memory, pc", func->pc);
+    }
+    ins = &func->code_memory[index];
+
+    switch (ins->opcode)
+    {
+        case OPCODE_ADD:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] + func->regs[ins->rs2];
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_SUB:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] - func->regs[ins->rs2];
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_ADDL:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] + ins->imm;
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_SUBL:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] - ins->imm;
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_MUL:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] * func->regs[ins->rs2];
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_DIV:
+        {
+            if (func->regs[ins->rs2] == 0)
+            {
+                return functional_fault(func, "Division by zero in R", ins->rs2);
+            }
+            if (func->regs[ins->rs1] == INT_MIN && func->regs[ins->rs2] == -1)
+            {
+                return functional_fault(func, "Division overflow in R", ins->rs2);
+            }
+            func->regs[ins->rd] = func->regs[ins->rs1] / func->regs[ins->rs2];
+            func->ccr_register = ins->rd;
+            break;
+        }
+        case OPCODE_AND:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] & func->regs[ins->rs2];
+            break;
+        }
+        case OPCODE_OR:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] | func->regs[ins->rs2];
+            break;
+        }
+        case OPCODE_XOR:
+        {
+            func->regs[ins->rd] = func->regs[ins->rs1] ^ func->regs[ins->rs2];
+            break;
+        }
+        case OPCODE_MOVC:
+        {
+            func->regs[ins->rd] = ins->imm;
+            break;
+        }
+        case OPCODE_LOAD:
+        {
+            address = func->regs[ins->rs1] + ins->imm;
+            if (address < 0 || address >= func->data_memory_size)
+            {
+                return functional_fault(func, "Load outside data memory, address", address);
+            }
+            func->regs[ins->rd] = func->data_memory[address];
+            break;
+        }
+        case OPCODE_STORE:
+        {
+            address = func->regs[ins->rs2] + ins->imm;
+            if (address < 0 || address >= func->data_memory_size)
+            {
+                return functional_fault(func, "Store outside data memory, address", address);
+            }
+            func->data_memory[address] = func->regs[ins->rs1];
+            break;
+        }
+        case OPCODE_BZ:
+        {
+            if (func->regs[func->ccr_register] == 0)
+            {
+                next_pc = func->pc + ins->imm;
+            }
+            break;
+        }
+        case OPCODE_BNZ:
+        {
+            if (func->regs[func->ccr_register] != 0)
+            {
+                next_pc = func->pc + ins->imm;
+            }
+            break;
+        }
+        case OPCODE_JUMP:
+        {
+            next_pc = func->regs[ins->rs1] + ins->imm;
+            break;
+        }
+        case OPCODE_JALR:
+        {
+            next_pc = func->regs[ins->rs1] + ins->imm;
+            func->regs[ins->rd] = func->pc + 4;
+            break;
+        }
+        case OPCODE_RET:
+        {
+            next_pc = func->regs[ins->rs1];
+            break;
+        }
+        case OPCODE_HALT:
+        {
+            func->status = APEX_STATUS_HALTED;
+            break;
+        }
+    }
+
+    func->insn_completed++;
+    if (func->status == APEX_STATUS_RUNNING)
+    {
+        func->pc = next_pc;
+    }
+    return func->status;
+}
+
+/*
+ * Creates a pipeline cpu whose architectural state is that of func, with an
+ * empty pipeline and every register read from the architectural file, ready
+ * to fetch the next instruction of func
+ */
+APEX_CPU *
+APEX_functional_to_cpu(const APEX_Functional *func, const APEX_Config *config)
+{
+    APEX_CPU *cpu;
+    int i;
+
+    if (config->data_memory_size != func->data_memory_size)
+    {
+        return NULL;
+    }
+
+    cpu = APEX_cpu_create(func->code_memory, func->code_memory_size, config);
+    if (!cpu)
+    {
+        return NULL;
+    }
+
+    cpu->pc = func->pc;
+    for (i = 0; i < ARCHITECTURAL_REGISTERS_SIZE; ++i)
+    {
+        cpu->arf.architectural_register_file[i].value = func->regs[i];
+    }
+    cpu->arf.architectural_register_file[ARCHITECTURAL_REGISTERS_SIZE].value = func->ccr_register;
+    memcpy(cpu->data_memory, func->data_memory, func->data_memory_size * sizeof(int));
+    return cpu;
+}
@@ -0,0 +1,36 @@
+/*
+ * apex_functional.h
+ * Contains the functional (architectural only) APEX simulator used to
+ * fast-forward between detailed simulation intervals
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_FUNCTIONAL_H_
+#define _APEX_FUNCTIONAL_H_
+
+#ifndef _APEX_CPU_H_
+#include "apex_cpu.h"
+#endif
+
+/* Architectural state of a program, no pipeline and no timing */
+typedef struct APEX_Functional
+{
+    int pc;                        /* Current program counter */
+    long insn_completed;           /* Instructions executed, HALT included */
+    int status;                    /* APEX_STATUS_RUNNING, HALTED or FAULT */
+    int regs[ARCHITECTURAL_REGISTERS_SIZE];
+    int ccr_register;              /* Destination of the last ADD/ADDL/SUB/SUBL/MUL/DIV,
+                                    * BZ and BNZ test its value */
+    const APEX_Instruction *code_memory;
+    int code_memory_size;
+    int *data_memory;
+    int data_memory_size;
+} APEX_Functional;
+
+APEX_Functional *APEX_functional_create(const APEX_Instruction *code_memory,
+                                        int code_memory_size, const APEX_Config *config);
+int APEX_functional_step(APEX_Functional *func);
+void APEX_functional_free(APEX_Functional *func);
+APEX_CPU *APEX_functional_to_cpu(const APEX_Functional *func, const APEX_Config *config);
+#endif
@@ -0,0 +1,197 @@
+/*
+ * apex_isa.c
+ * Contains the opcode table of the APEX ISA: assembler mnemonic, functional
+ * unit, operands and the handler that computes the result in the integer or
+ * multiplication unit. Add a row here when adding a new instruction.
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_isa.h"
+
+/* Properties shared by every instance of an opcode */
+typedef struct APEX_Opcode_Info
+{
+    const char *name;        /* Assembler mnemonic, NULL for an unused opcode */
+    signed char assembled;   /* Accepted in input files */
+    signed char fu;          /* INT_FU, MUL_FU or BRANCH_FU */
+    signed char dest;        /* Writes rd, needs a physical register */
+    signed char src1;
+    signed char src2;
+    signed char memory;      /* Takes an LSQ entry */
+    signed char memory_type; /* LOAD_INS or STORE_INS */
+    APEX_Execute_fn execute; /* NULL when the unit computes nothing */
+} APEX_Opcode_Info;
+
+static void
+set_flags(CPU_Stage *stage)
+{
+    stage->positive_flag = (stage->result_buffer > 0) ? 1 : 0;
+    stage->zero_flag = (stage->result_buffer == 0) ? 1 : 0;
+}
+
+static void
+execute_add(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value + stage->rs2_value;
+    set_flags(stage);
+}
+
+static void
+execute_addl(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value + stage->imm;
+    set_flags(stage);
+}
+
+static void
+execute_sub(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value - stage->rs2_value;
+    set_flags(stage);
+}
+
+static void
+execute_subl(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value - stage->imm;
+    set_flags(stage);
+}
+
+static void
+execute_mul(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value * stage->rs2_value;
+    set_flags(stage);
+}
+
+/* Both cases trap on the host, the DIV may be on a wrong path so it leaves 0
+ * and only faults if it commits */
+static void
+execute_div(CPU_Stage *stage)
+{
+    if (stage->rs2_value == 0)
+    {
+        stage->result_buffer = 0;
+        stage->fault = FAULT_DIV_ZERO;
+    }
+    else if (stage->rs1_value == INT_MIN && stage->rs2_value == -1)
+    {
+        stage->result_buffer = 0;
+        stage->fault = FAULT_DIV_OVERFLOW;
+    }
+    else
+    {
+        stage->result_buffer = stage->rs1_value / stage->rs2_value;
+    }
+    set_flags(stage);
+}
+
+static void
+execute_and(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value & stage->rs2_value;
+}
+
+static void
+execute_or(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value | stage->rs2_value;
+}
+
+static void
+execute_xor(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->rs1_value ^ stage->rs2_value;
+}
+
+static void
+execute_movc(CPU_Stage *stage)
+{
+    stage->result_buffer = stage->imm;
+}
+
+static void
+execute_load(CPU_Stage *stage)
+{
+    stage->memory_address = stage->rs1_value + stage->imm;
+}
+
+static void
+execute_store(CPU_Stage *stage)
+{
+    stage->memory_address = stage->rs2_value + stage->imm;
+}
+
+/* Indexed by opcode, see apex_macros.h */
+static const APEX_Opcode_Info opcode_table[] = {
+    /*               name   asm fu        dest src1 src2 mem memory_type execute */
+    [OPCODE_ADD]   = {"ADD",    1, INT_FU,    1, 1, 1, 0, LOAD_INS,  execute_add},
+    [OPCODE_SUB]   = {"SUB",    1, INT_FU,    1, 1, 1, 0, LOAD_INS,  execute_sub},
+    [OPCODE_MUL]   = {"MUL",    1, MUL_FU,    1, 1, 1, 0, LOAD_INS,  execute_mul},
+    [OPCODE_DIV]   = {"DIV",    1, MUL_FU,    1, 1, 1, 0, LOAD_INS,  execute_div},
+    [OPCODE_AND]   = {"AND",    1, INT_FU,    1, 1, 1, 0, LOAD_INS,  execute_and},
+    [OPCODE_OR]    = {"OR",     1, INT_FU,    1, 1, 1, 0, LOAD_INS,  execute_or},
+    [OPCODE_XOR]   = {"EXOR",   1, INT_FU,    1, 1, 1, 0, LOAD_INS,  execute_xor},
+    [OPCODE_MOVC]  = {"MOVC",   1, INT_FU,    1, 0, 0, 0, LOAD_INS,  execute_movc},
+    [OPCODE_LOAD]  = {"LOAD",   1, INT_FU,    1, 1, 0, 1, LOAD_INS,  execute_load},
+    [OPCODE_STORE] = {"STORE",  1, INT_FU,    0, 1, 1, 1, STORE_INS, execute_store},
+    [OPCODE_BZ]    = {"BZ",     1, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_BNZ]   = {"BNZ",    1, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_HALT]  = {"HALT",   1, INT_FU,    0, 0, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_BP]    = {"BP",     0, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_BNP]   = {"BNP",    0, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_RET]   = {"RET",    1, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_ADDL]  = {"ADDL",   1, INT_FU,    1, 1, 0, 0, LOAD_INS,  execute_addl},
+    [OPCODE_SUBL]  = {"SUBL",   1, INT_FU,    1, 1, 0, 0, LOAD_INS,  execute_subl},
+    [OPCODE_JUMP]  = {"JUMP",   1, BRANCH_FU, 0, 1, 0, 0, LOAD_INS,  NULL},
+    [OPCODE_CMP]   = {"CMP",    0, BRANCH_FU, 0, 1, 1, 0, LOAD_INS,  NULL},
+    [OPCODE_JALR]  = {"JALR",   1, BRANCH_FU, 1, 1, 0, 0, LOAD_INS,  NULL},
+};
+
+#define OPCODE_TABLE_SIZE ((int)(sizeof(opcode_table) / sizeof(opcode_table[0])))
+
+/* Returns the opcode of an assembler mnemonic, -1 for an unknown one */
+int
+APEX_opcode_from_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < OPCODE_TABLE_SIZE; ++i)
+    {
+        if (opcode_table[i].assembled && strcmp(opcode_table[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *
+APEX_opcode_name(int opcode)
+{
+    if (opcode < 0 || opcode >= OPCODE_TABLE_SIZE || !opcode_table[opcode].name)
+    {
+        return "???";
+    }
+    return opcode_table[opcode].name;
+}
+
+/* Fills in the per-opcode fields of an instruction whose opcode is valid */
+void
+APEX_predecode_instruction(APEX_Instruction *ins)
+{
+    const APEX_Opcode_Info *info = &opcode_table[ins->opcode];
+
+    ins->fu = info->fu;
+    ins->is_physical_register_required = info->dest;
+    ins->is_src1_register_required = info->src1;
+    ins->is_src2_register_required = info->src2;
+    ins->is_memory_insn = info->memory;
+    ins->memory_instruction_type = info->memory_type;
+    ins->execute = info->execute;
+}
@@ -0,0 +1,19 @@
+/*
+ * apex_isa.h
+ * Contains the static description of every APEX opcode, used to decode each
+ * instruction once when the program is loaded
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_ISA_H_
+#define _APEX_ISA_H_
+
+#ifndef _APEX_CPU_H_
+#include "apex_cpu.h"
+#endif
+
+int APEX_opcode_from_name(const char *name);
+const char *APEX_opcode_name(int opcode);
+void APEX_predecode_instruction(APEX_Instruction *ins);
+#endif
@@ -13,12 +13,132 @@
 #define TRUE 0x1
 
 /* Integers */
-#define DATA_MEMORY_SIZE 4096
-#define PHYSICAL_REGISTERS_SIZE 20
 #define ARCHITECTURAL_REGISTERS_SIZE 16
-#define ISSUE_QUEUE_SIZE 8
-#define LSQ_SIZE 6
-#define ROB_SIZE 16
+
+/* Default structure sizes, each one can be overridden at runtime through
+ * APEX_Config (see apex_config.h) */
+#define DEFAULT_DATA_MEMORY_SIZE 4096
+#define DEFAULT_PHYSICAL_REGISTERS_SIZE 20
+#define DEFAULT_ISSUE_QUEUE_SIZE 8
+#define DEFAULT_LSQ_SIZE 6
+#define DEFAULT_ROB_SIZE 16
+#define DEFAULT_MEMORY_LATENCY 2
+#define DEFAULT_SKIP_IDLE_CYCLES 1
+#define DEFAULT_BRANCH_CHECKPOINTS 8
+#define DEFAULT_BRANCH_PREDICTOR BP_BIMODAL
+#define DEFAULT_BTB_SIZE 64
+#define DEFAULT_PREDICTOR_TABLE_SIZE 1024
+#define DEFAULT_HISTORY_LENGTH 16
+#define DEFAULT_RAS_SIZE 8
+#define DEFAULT_MACHINE_WIDTH 1
+#define DEFAULT_INT_UNITS 1
+#define DEFAULT_INT_LATENCY 1
+#define DEFAULT_MUL_UNITS 1
+#define DEFAULT_MUL_LATENCY 4
+#define DEFAULT_MUL_OPCODES ((1 << OPCODE_MUL) | (1 << OPCODE_DIV))
+#define DEFAULT_BRANCH_UNITS 1
+#define DEFAULT_BRANCH_LATENCY 1
+#define DEFAULT_MEM_UNITS 1
+#define DEFAULT_MEMORY_MSHRS 1
+#define DEFAULT_MEMORY_DEPENDENCE MD_STORE_SETS
+#define DEFAULT_SSIT_SIZE 1024
+#define DEFAULT_L1D_SIZE 0        /* words, 0 leaves the level out */
+#define DEFAULT_L1D_ASSOC 2
+#define DEFAULT_L1D_LINE_SIZE 4   /* words */
+#define DEFAULT_L1D_LATENCY 1
+#define DEFAULT_L2_SIZE 0
+#define DEFAULT_L2_ASSOC 8
+#define DEFAULT_L2_LINE_SIZE 8
+#define DEFAULT_L2_LATENCY 8
+#define DEFAULT_L1I_SIZE 0        /* instructions, 0 leaves the level out */
+#define DEFAULT_L1I_ASSOC 2
+#define DEFAULT_L1I_LINE_SIZE 4   /* instructions */
+#define DEFAULT_L1I_LATENCY 1
+#define DEFAULT_CACHE_REPLACEMENT CACHE_LRU
+#define DEFAULT_CACHE_WRITE_BACK 1
+#define DEFAULT_FETCH_BUFFER_SIZE 0
+#define DEFAULT_PREFETCHER PF_NONE
+#define DEFAULT_PREFETCH_DEGREE 1
+#define DEFAULT_PREFETCH_DISTANCE 1
+#define DEFAULT_PREFETCH_TABLE_SIZE 64
+#define DEFAULT_DRAM_CHANNELS 0   /* 0 leaves the DRAM out for memory_latency */
+#define DEFAULT_DRAM_BANKS 8
+#define DEFAULT_DRAM_ROW_SIZE 1024 /* words */
+#define DEFAULT_DRAM_ROW_HIT_LATENCY 10
+#define DEFAULT_DRAM_ROW_MISS_LATENCY 20
+#define DEFAULT_DRAM_ROW_CONFLICT_LATENCY 30
+#define DEFAULT_DRAM_BURST_CYCLES 4
+#define DEFAULT_DRAM_QUEUE_SIZE 16
+#define DEFAULT_DRAM_PAGE_POLICY DRAM_OPEN_PAGE
+#define DEFAULT_DTLB_ENTRIES 0    /* 0 leaves address translation out */
+#define DEFAULT_DTLB_ASSOC 4
+#define DEFAULT_L2_TLB_ENTRIES 0  /* 0 leaves the level out */
+#define DEFAULT_L2_TLB_ASSOC 8
+#define DEFAULT_L2_TLB_LATENCY 7
+#define DEFAULT_PAGE_SIZE PAGE_4K
+#define DEFAULT_PAGE_TABLE_LEVELS 4
+#define DEFAULT_PAGE_WALKERS 1
+
+/* Widest fetch, dispatch and commit group, sizes the front end latches */
+#define MAX_MACHINE_WIDTH 8
+
+/* Most units of one functional unit class */
+#define MAX_FU_UNITS 16
+
+/* Most ways of a cache set, the PLRU tree of a set fits one 64 bit word */
+#define MAX_CACHE_ASSOC 64
+
+/* Most lines a prefetcher asks for at once */
+#define MAX_PREFETCH_DEGREE 16
+
+/* Most DRAM channels and banks of a channel */
+#define MAX_DRAM_CHANNELS 16
+#define MAX_DRAM_BANKS 64
+
+/* Most entries of a TLB, so that one of huge pages maps less than 2^31 words */
+#define MAX_TLB_ENTRIES 2048
+
+/* Most page table levels and page walks in flight */
+#define MAX_PAGE_TABLE_LEVELS 5
+#define MAX_PAGE_WALKERS 16
+
+/* Direction predictors of the branch prediction unit */
+#define BP_NONE 0     /* always fetch sequentially, every taken branch flushes */
+#define BP_STATIC 1   /* backward taken, forward not taken */
+#define BP_BIMODAL 2  /* 2 bit counter per branch */
+#define BP_GSHARE 3   /* 2 bit counters indexed by pc xor global history */
+#define BP_TAGE 4     /* bimodal base plus tagged tables of growing history */
+
+/* Memory dependence predictors deciding whether a load may issue ahead of an
+ * older store whose address is not known yet */
+#define MD_WAIT 0        /* never, the load waits for every older store address */
+#define MD_STORE_SETS 1  /* unless a past violation put both in one store set */
+#define MD_SPECULATE 2   /* always */
+
+/* Levels of the cache hierarchy, a level of size 0 is left out. Both L1
+ * caches miss to the unified L2 */
+#define CACHE_L1D 0
+#define CACHE_L2 1
+#define CACHE_L1I 2
+#define NUM_CACHE_LEVELS 3
+
+/* Replacement policies of the caches */
+#define CACHE_LRU 0      /* least recently used line of the set */
+#define CACHE_PLRU 1     /* tree pseudo LRU */
+#define CACHE_RANDOM 2   /* pseudo random line of the set */
+
+/* Data prefetchers, trained on the loads going to memory */
+#define PF_NONE 0        /* no prefetching */
+#define PF_NEXT_LINE 1   /* the lines following the line of every load */
+#define PF_STRIDE 2      /* the next addresses of a load repeating a stride */
+
+/* Row buffer policies of the DRAM banks */
+#define DRAM_OPEN_PAGE 0   /* the row stays open for the next access */
+#define DRAM_CLOSE_PAGE 1  /* the bank precharges after every access */
+
+/* Page sizes of the data memory */
+#define PAGE_4K 0     /* 4 KB pages of 1024 words */
+#define PAGE_2M 1     /* 2 MB huge pages, a walk reads one level less */
 
 #define SOURCE_AR 0
 #define SOURCE_PR 1
@@ -30,6 +150,10 @@
 #define MUL_FU 1
 #define BRANCH_FU 2
 #define MEM_FU 3
+/* Functional unit classes the issue queue selects for, INT_FU to BRANCH_FU */
+#define NUM_ISSUE_FU 3
+/* Functional unit classes of the pool, the memory units are fed by the LSQ */
+#define NUM_FU_CLASSES 4
 
 
 /* Numeric OPCODE identifiers for instructions */
@@ -55,10 +179,49 @@
 #define OPCODE_BNP 0xe
 #define OPCODE_RET 0xf
 
-/* Set this flag to 1 to enable debug messages */
+/* Set this flag to 1 to enable debug messages, 0 compiles every debug
+ * message out of the simulator (see the Makefile DEBUG variable) */
+#ifndef ENABLE_DEBUG_MESSAGES
 #define ENABLE_DEBUG_MESSAGES 1
+#endif
+
+/* Runtime verbosity levels, selected with -v on the command line */
+#define VERBOSITY_NONE 0    /* nothing at all */
+#define VERBOSITY_SUMMARY 1 /* final cycles/instructions/IPC line */
+#define VERBOSITY_STAGE 2   /* per-cycle stage contents */
+#define VERBOSITY_FULL 3    /* every event plus register file each cycle */
 
-/* Set this flag to 1 to enable cycle single-step mode */
+/* True when debug messages of the given level should be printed for cpu */
+#define APEX_TRACE_ENABLED(cpu, level) \
+    (ENABLE_DEBUG_MESSAGES && (cpu)->verbosity >= (level))
+
+/* Prints a debug message when the cpu runs at the given verbosity level */
+#if ENABLE_DEBUG_MESSAGES
+#define APEX_LOG(cpu, level, ...)                \
+    do                                           \
+    {                                            \
+        if ((cpu)->verbosity >= (level))         \
+        {                                        \
+            fprintf((cpu)->trace_out, __VA_ARGS__); \
+        }                                        \
+    } while (0)
+#else
+#define APEX_LOG(cpu, level, ...) do { } while (0)
+#endif
+
+/* Set this flag to 1 to enable cycle single-step mode by default in apex_sim */
 #define ENABLE_SINGLE_STEP 1
 
+/* Termination status of a simulation, returned by APEX_cpu_step/APEX_cpu_run */
+#define APEX_STATUS_RUNNING 0     /* still simulating */
+#define APEX_STATUS_HALTED 1      /* HALT committed */
+#define APEX_STATUS_STOPPED 2     /* the step hook asked to stop */
+#define APEX_STATUS_CYCLE_LIMIT 3 /* max_cycles reached */
+#define APEX_STATUS_FAULT 4       /* data address outside the data memory, or division
+                                   * by zero or overflow */
+
+/* Return values of a step hook */
+#define APEX_STEP_CONTINUE 0
+#define APEX_STEP_STOP 1
+
 #endif
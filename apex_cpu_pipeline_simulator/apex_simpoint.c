@@ -0,0 +1,579 @@
+/*
+ * apex_simpoint.c
+ * Sampled simulation in the style of SimPoint:
+ *
+ *   1. the program runs once on the functional model, which records a basic
+ *      block vector (instructions executed per basic block) for every fixed
+ *      size interval of instructions
+ *   2. the vectors are randomly projected to a few dimensions and clustered
+ *      with k-means, each cluster is one phase of the program
+ *   3. the program runs again on the functional model, and only the interval
+ *      closest to the centre of each phase, after a short warm up, is
+ *      simulated on the detailed pipeline
+ *   4. the CPI of each phase, weighted by the instructions of the phase,
+ *      gives the CPI of the whole program
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_functional.h"
+#include "apex_simpoint.h"
+
+/* Dimensions of the projected basic block vectors, as SimPoint uses */
+#define SIMPOINT_DIMENSIONS 15
+#define SIMPOINT_MAX_ITERATIONS 100
+#define SIMPOINT_SEED 493575226u
+
+/* Profile of one interval of the program */
+typedef struct simpoint_interval
+{
+    double point[SIMPOINT_DIMENSIONS]; /* Projected, normalized basic block vector */
+    long start;                        /* First instruction of the interval */
+    long length;                       /* Instructions in the interval */
+    int cluster;
+} simpoint_interval;
+
+/* One phase of the program and its measurement */
+typedef struct simpoint_phase
+{
+    double centroid[SIMPOINT_DIMENSIONS];
+    long instructions;                 /* Instructions of all intervals in the phase */
+    int representative;                /* Interval simulated in detail */
+    long cycles;                       /* Measured on the representative */
+    long measured_instructions;
+} simpoint_phase;
+
+typedef struct simpoint_profile
+{
+    simpoint_interval *intervals;
+    int num_intervals;
+    int capacity;
+    long total_instructions;
+} simpoint_profile;
+
+/* Window of a detailed run, passed to the step hook */
+typedef struct simpoint_window
+{
+    long warm_end;          /* Measurement starts once this many retired */
+    long end;               /* and stops once this many retired */
+    int warm_done;
+    int warm_clock;
+    long warm_instructions;
+} simpoint_window;
+
+void
+APEX_simpoint_options_init(APEX_SimPoint_Options *options)
+{
+    options->interval = DEFAULT_SIMPOINT_INTERVAL;
+    options->max_clusters = DEFAULT_SIMPOINT_MAX_CLUSTERS;
+    options->warmup = DEFAULT_SIMPOINT_WARMUP;
+    options->bbv_file = NULL;
+}
+
+/* xorshift32, the sequence only depends on the seed so results are repeatable */
+static unsigned int
+simpoint_random(unsigned int *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double
+distance2(const double *a, const double *b)
+{
+    double sum = 0.0;
+    int d;
+
+    for (d = 0; d < SIMPOINT_DIMENSIONS; ++d)
+    {
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+    }
+    return sum;
+}
+
+/* Appends the interval whose basic block counts are in counts[touched[...]]
+ * and clears those counts for the next interval */
+static int
+close_interval(simpoint_profile *profile, long *counts, const int *touched, int num_touched,
+               const double *projection, long start, long length, FILE *bbv)
+{
+    simpoint_interval *interval;
+    int i, d;
+
+    if (profile->num_intervals == profile->capacity)
+    {
+        int capacity = profile->capacity ? 2 * profile->capacity : 64;
+        simpoint_interval *grown = realloc(profile->intervals,
+                                           capacity * sizeof(simpoint_interval));
+        if (!grown)
+        {
+            return -1;
+        }
+        profile->intervals = grown;
+        profile->capacity = capacity;
+    }
+
+    interval = &profile->intervals[profile->num_intervals++];
+    memset(interval, 0, sizeof(*interval));
+    interval->start = start;
+    interval->length = length;
+
+    if (bbv)
+    {
+        fprintf(bbv, "T");
+    }
+    for (i = 0; i < num_touched; ++i)
+    {
+        int block = touched[i];
+        double weight = (double)counts[block] / length;
+
+        for (d = 0; d < SIMPOINT_DIMENSIONS; ++d)
+        {
+            interval->point[d] += weight * projection[block * SIMPOINT_DIMENSIONS + d];
+        }
+        if (bbv)
+        {
+            fprintf(bbv, ":%d:%ld ", block + 1, counts[block]);
+        }
+        counts[block] = 0;
+    }
+    if (bbv)
+    {
+        fprintf(bbv, "\n");
+    }
+    return 0;
+}
+
+/*
+ * Runs the program on the functional model and records one projected basic
+ * block vector per interval. A basic block is identified by the index of
+ * its first instruction and ends with a control instruction.
+ */
+static int
+profile_program(const APEX_Instruction *code_memory, int code_memory_size,
+                const APEX_Config *config, const APEX_SimPoint_Options *options,
+                simpoint_profile *profile)
+{
+    APEX_Functional *func;
+    double *projection;
+    long *counts;
+    int *touched;
+    int num_touched = 0;
+    unsigned int seed = SIMPOINT_SEED;
+    long interval_start = 0;
+    int block = 0, new_block = TRUE;
+    FILE *bbv = NULL;
+    int ret = -1;
+    int i;
+
+    func = APEX_functional_create(code_memory, code_memory_size, config);
+    projection = malloc(code_memory_size * SIMPOINT_DIMENSIONS * sizeof(double));
+    counts = calloc(code_memory_size, sizeof(long));
+    touched = malloc(code_memory_size * sizeof(int));
+    if (!func || !projection || !counts || !touched)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        goto out;
+    }
+
+    if (options->bbv_file)
+    {
+        bbv = fopen(options->bbv_file, "w");
+        if (!bbv)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create %s\n", options->bbv_file);
+            goto out;
+        }
+    }
+
+    /* Uniform in [-1, 1], one row per possible basic block */
+    for (i = 0; i < code_memory_size * SIMPOINT_DIMENSIONS; ++i)
+    {
+        projection[i] = (simpoint_random(&seed) / 4294967295.0) * 2.0 - 1.0;
+    }
+
+    while (func->status == APEX_STATUS_RUNNING)
+    {
+        int index = (func->pc - 4000) / 4;
+
+        if (APEX_functional_step(func) == APEX_STATUS_FAULT)
+        {
+            goto out;
+        }
+
+        if (new_block)
+        {
+            block = index;
+        }
+        if (!counts[block]++)
+        {
+            touched[num_touched++] = block;
+        }
+        new_block = is_branch_instruction(code_memory[index].opcode);
+
+        if (func->insn_completed - interval_start == options->interval ||
+            func->status != APEX_STATUS_RUNNING)
+        {
+            if (close_interval(profile, counts, touched, num_touched, projection,
+                               interval_start, func->insn_completed - interval_start, bbv))
+            {
+                fprintf(stderr, "APEX_Error: Out of memory\n");
+                goto out;
+            }
+            num_touched = 0;
+            interval_start = func->insn_completed;
+        }
+
+        /* Every instruction takes a cycle, so a program that is still running
+         * here could never halt within max_cycles */
+        if (config->max_cycles && func->insn_completed >= config->max_cycles &&
+            func->status == APEX_STATUS_RUNNING)
+        {
+            fprintf(stderr, "APEX_Error: Program did not halt within %ld instructions\n",
+                    config->max_cycles);
+            goto out;
+        }
+    }
+
+    profile->total_instructions = func->insn_completed;
+    ret = 0;
+
+out:
+    if (bbv)
+    {
+        fclose(bbv);
+    }
+    free(touched);
+    free(counts);
+    free(projection);
+    if (func)
+    {
+        APEX_functional_free(func);
+    }
+    return ret;
+}
+
+/* Index of the phase whose centroid is closest to point */
+static int
+nearest_phase(const simpoint_phase *phases, int num_phases, const double *point)
+{
+    double best = DBL_MAX;
+    int nearest = 0;
+    int c;
+
+    for (c = 0; c < num_phases; ++c)
+    {
+        double distance = distance2(phases[c].centroid, point);
+
+        if (distance < best)
+        {
+            best = distance;
+            nearest = c;
+        }
+    }
+    return nearest;
+}
+
+/*
+ * k-means over the projected vectors, each interval weighted by its length,
+ * seeded with k-means++ from a fixed seed. Fewer than max_clusters phases
+ * are returned when the program has fewer distinct intervals.
+ */
+static int
+cluster_intervals(simpoint_profile *profile, int max_clusters, simpoint_phase *phases)
+{
+    simpoint_interval *intervals = profile->intervals;
+    int n = profile->num_intervals;
+    unsigned int seed = SIMPOINT_SEED;
+    double *nearest;
+    int num_phases = 1;
+    int changed = TRUE;
+    int iteration, i, j, c, d;
+
+    nearest = malloc(n * sizeof(double));
+    if (!nearest)
+    {
+        return -1;
+    }
+
+    memcpy(phases[0].centroid, intervals[simpoint_random(&seed) % n].point,
+           sizeof(phases[0].centroid));
+    while (num_phases < max_clusters)
+    {
+        double total = 0.0, pick;
+
+        for (i = 0; i < n; ++i)
+        {
+            double distance = distance2(intervals[i].point,
+                                        phases[nearest_phase(phases, num_phases,
+                                                             intervals[i].point)].centroid);
+            nearest[i] = distance * intervals[i].length;
+            total += nearest[i];
+        }
+        if (total <= 0.0)
+        {
+            break;
+        }
+
+        pick = (simpoint_random(&seed) / 4294967295.0) * total;
+        for (i = 0; i < n - 1 && pick >= nearest[i]; ++i)
+        {
+            pick -= nearest[i];
+        }
+        memcpy(phases[num_phases++].centroid, intervals[i].point, sizeof(phases[0].centroid));
+    }
+    free(nearest);
+
+    for (i = 0; i < n; ++i)
+    {
+        intervals[i].cluster = -1;
+    }
+
+    for (iteration = 0; changed && iteration < SIMPOINT_MAX_ITERATIONS; ++iteration)
+    {
+        changed = FALSE;
+        for (i = 0; i < n; ++i)
+        {
+            c = nearest_phase(phases, num_phases, intervals[i].point);
+            if (c != intervals[i].cluster)
+            {
+                intervals[i].cluster = c;
+                changed = TRUE;
+            }
+        }
+
+        for (c = 0; c < num_phases; ++c)
+        {
+            phases[c].instructions = 0;
+        }
+        for (i = 0; i < n; ++i)
+        {
+            phases[intervals[i].cluster].instructions += intervals[i].length;
+        }
+        for (c = 0; c < num_phases; ++c)
+        {
+            if (phases[c].instructions)
+            {
+                memset(phases[c].centroid, 0, sizeof(phases[c].centroid));
+            }
+        }
+        for (i = 0; i < n; ++i)
+        {
+            simpoint_phase *phase = &phases[intervals[i].cluster];
+            double weight = (double)intervals[i].length / phase->instructions;
+
+            for (d = 0; d < SIMPOINT_DIMENSIONS; ++d)
+            {
+                phase->centroid[d] += weight * intervals[i].point[d];
+            }
+        }
+    }
+
+    /* Drop phases that lost all their intervals, renumbering the rest */
+    for (c = 0, j = 0; c < num_phases; ++c)
+    {
+        if (phases[c].instructions)
+        {
+            for (i = 0; i < n; ++i)
+            {
+                if (intervals[i].cluster == c)
+                {
+                    intervals[i].cluster = j;
+                }
+            }
+            phases[j++] = phases[c];
+        }
+    }
+    num_phases = j;
+
+    for (c = 0; c < num_phases; ++c)
+    {
+        double best = DBL_MAX;
+
+        for (i = 0; i < n; ++i)
+        {
+            double distance = distance2(intervals[i].point, phases[c].centroid);
+
+            if (intervals[i].cluster == c && distance < best)
+            {
+                best = distance;
+                phases[c].representative = i;
+            }
+        }
+    }
+    return num_phases;
+}
+
+/* Step hook of a detailed run: notes the end of the warm up and stops at the
+ * end of the measured interval */
+static int
+simpoint_step(APEX_CPU *cpu, void *data)
+{
+    simpoint_window *window = data;
+
+    if (!window->warm_done && cpu->insn_completed >= window->warm_end)
+    {
+        window->warm_done = TRUE;
+        window->warm_clock = cpu->clock;
+        window->warm_instructions = cpu->insn_completed;
+    }
+    return cpu->insn_completed >= window->end ? APEX_STEP_STOP : APEX_STEP_CONTINUE;
+}
+
+/* Simulates warmup + length instructions from the state of func on the
+ * pipeline and measures the last length of them */
+static int
+measure_interval(const APEX_Functional *func, const APEX_Config *config, long warmup,
+                 long length, simpoint_phase *phase)
+{
+    simpoint_window window;
+    APEX_CPU *cpu;
+    int status;
+
+    cpu = APEX_functional_to_cpu(func, config);
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        return -1;
+    }
+
+    memset(&window, 0, sizeof(window));
+    window.warm_end = warmup;
+    window.end = warmup + length;
+    window.warm_done = (warmup == 0);
+
+    cpu->verbosity = VERBOSITY_NONE;
+    cpu->step_fn = simpoint_step;
+    cpu->step_data = &window;
+    status = APEX_cpu_run(cpu);
+
+    phase->cycles = cpu->clock - window.warm_clock;
+    phase->measured_instructions = cpu->insn_completed - window.warm_instructions;
+    APEX_cpu_stop(cpu);
+
+    if (status == APEX_STATUS_CYCLE_LIMIT || !window.warm_done)
+    {
+        fprintf(stderr, "APEX_Error: Interval at instruction %ld did not complete within "
+                "max_cycles\n", func->insn_completed + warmup);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Estimates the cycles of the whole program from detailed simulation of one
+ * interval per phase and prints the report to out
+ *
+ * Returns 0 on success, -1 with a message on stderr otherwise. The program
+ * has to halt on the functional model.
+ */
+int
+APEX_simpoint_run(const APEX_Instruction *code_memory, int code_memory_size,
+                  const APEX_Config *config, const APEX_SimPoint_Options *options,
+                  FILE *out)
+{
+    simpoint_profile profile;
+    simpoint_phase *phases = NULL;
+    int *order = NULL;
+    APEX_Functional *func = NULL;
+    long detailed = 0;
+    double cpi = 0.0;
+    int num_phases;
+    int ret = -1;
+    int i, j;
+
+    memset(&profile, 0, sizeof(profile));
+    if (profile_program(code_memory, code_memory_size, config, options, &profile))
+    {
+        goto out;
+    }
+
+    phases = calloc(options->max_clusters, sizeof(simpoint_phase));
+    order = calloc(options->max_clusters, sizeof(int));
+    func = APEX_functional_create(code_memory, code_memory_size, config);
+    if (!phases || !order || !func)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        goto out;
+    }
+
+    num_phases = cluster_intervals(&profile, options->max_clusters, phases);
+    if (num_phases < 0)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        goto out;
+    }
+
+    /* Visit the representatives in program order so one functional run can
+     * fast-forward to all of them */
+    for (i = 0; i < num_phases; ++i)
+    {
+        for (j = i; j > 0 && phases[order[j - 1]].representative > phases[i].representative; --j)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    for (i = 0; i < num_phases; ++i)
+    {
+        simpoint_phase *phase = &phases[order[i]];
+        const simpoint_interval *interval = &profile.intervals[phase->representative];
+        long warm_start = interval->start - options->warmup;
+
+        if (warm_start < 0)
+        {
+            warm_start = 0;
+        }
+        while (func->insn_completed < warm_start)
+        {
+            APEX_functional_step(func);
+        }
+
+        if (measure_interval(func, config, interval->start - warm_start, interval->length,
+                             phase))
+        {
+            goto out;
+        }
+        detailed += interval->start - warm_start + interval->length;
+    }
+
+    fprintf(out, "APEX_SimPoint: %ld instructions, %d intervals of %ld, %d phases\n",
+            profile.total_instructions, profile.num_intervals, options->interval, num_phases);
+    for (i = 0; i < num_phases; ++i)
+    {
+        const simpoint_phase *phase = &phases[order[i]];
+        const simpoint_interval *interval = &profile.intervals[phase->representative];
+        double weight = (double)phase->instructions / profile.total_instructions;
+        double phase_cpi = (double)phase->cycles / phase->measured_instructions;
+
+        fprintf(out, "APEX_SimPoint: phase %d, interval %d (instructions %ld-%ld), "
+                "weight = %.4f CPI = %.4f\n", i, phase->representative, interval->start,
+                interval->start + interval->length - 1, weight, phase_cpi);
+        cpi += weight * phase_cpi;
+    }
+    fprintf(out, "APEX_SimPoint: Estimated, cycles = %.0f instructions = %ld IPC = %.4f "
+            "CPI = %.4f\n", cpi * profile.total_instructions, profile.total_instructions,
+            1.0 / cpi, cpi);
+    fprintf(out, "APEX_SimPoint: %ld of %ld instructions simulated in detail (%.2f%%)\n",
+            detailed, profile.total_instructions,
+            100.0 * detailed / profile.total_instructions);
+    ret = 0;
+
+out:
+    if (func)
+    {
+        APEX_functional_free(func);
+    }
+    free(order);
+    free(phases);
+    free(profile.intervals);
+    return ret;
+}
@@ -0,0 +1,37 @@
+/*
+ * apex_simpoint.h
+ * Contains the sampled simulation driver: basic block vector profiling,
+ * phase clustering and detailed simulation of one interval per phase
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_SIMPOINT_H_
+#define _APEX_SIMPOINT_H_
+
+#include <stdio.h>
+
+#ifndef _APEX_CPU_H_
+#include "apex_cpu.h"
+#endif
+
+/* Defaults of APEX_simpoint_options_init */
+#define DEFAULT_SIMPOINT_INTERVAL 10000
+#define DEFAULT_SIMPOINT_MAX_CLUSTERS 10
+#define DEFAULT_SIMPOINT_WARMUP 1000
+
+/* Parameters of one sampled simulation */
+typedef struct APEX_SimPoint_Options
+{
+    long interval;          /* Instructions per interval */
+    int max_clusters;       /* Upper bound on the number of phases */
+    long warmup;            /* Detailed instructions simulated, but not measured,
+                             * before every representative interval */
+    const char *bbv_file;   /* Write the basic block vectors here, NULL for none */
+} APEX_SimPoint_Options;
+
+void APEX_simpoint_options_init(APEX_SimPoint_Options *options);
+int APEX_simpoint_run(const APEX_Instruction *code_memory, int code_memory_size,
+                      const APEX_Config *config, const APEX_SimPoint_Options *options,
+                      FILE *out);
+#endif
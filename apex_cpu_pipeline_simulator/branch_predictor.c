@@ -0,0 +1,298 @@
+/*
+ * branch_predictor.c
+ * Contains the branch target buffer, the static, bimodal, gshare and TAGE
+ * direction predictors and the return address stack
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "branch_predictor.h"
+#include<stdio.h>
+#include<stdlib.h>
+
+//instruction index of a pc, the low bits every table is indexed with
+#define PC_INDEX(pc) ((unsigned int)((pc)-4000)/4)
+
+int is_conditional_branch(int opcode){
+    return opcode==OPCODE_BZ || opcode==OPCODE_BNZ || opcode==OPCODE_BP || opcode==OPCODE_BNP;
+}
+
+//allocates the tables of the selected predictor, counters start weakly not taken
+int branch_predictor_init(branch_predictor *bp, int kind, int btb_size,
+                          int table_size, int history_length, int ras_size){
+    bp->kind=kind;
+    bp->btb_size=btb_size;
+    bp->table_size=table_size;
+    bp->history_length=history_length;
+    bp->history=0;
+    bp->ras_size=ras_size;
+    bp->ras_top=0;
+    bp->ras_count=0;
+    bp->btb=calloc(btb_size,sizeof(btb_entry));
+    bp->counters=malloc(table_size);
+    bp->ras=calloc(ras_size,sizeof(int));
+    if(!bp->btb || !bp->counters || !bp->ras){
+        return -1;
+    }
+    for(int i=0;i<table_size;i++){
+        bp->counters[i]=1;
+    }
+    for(int t=0;t<TAGE_TABLES;t++){
+        //geometric history lengths, the longest one is history_length
+        bp->tagged_history[t]=history_length>>(TAGE_TABLES-1-t);
+        if(bp->tagged_history[t]<1){
+            bp->tagged_history[t]=1;
+        }
+        bp->tagged[t]=NULL;
+        if(kind==BP_TAGE){
+            bp->tagged[t]=calloc(table_size,sizeof(tage_entry));
+            if(!bp->tagged[t]){
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+void branch_predictor_free(branch_predictor *bp){
+    free(bp->btb);
+    free(bp->counters);
+    free(bp->ras);
+    bp->btb=NULL;
+    bp->counters=NULL;
+    bp->ras=NULL;
+    for(int t=0;t<TAGE_TABLES;t++){
+        free(bp->tagged[t]);
+        bp->tagged[t]=NULL;
+    }
+}
+
+//xor of the last length outcomes of history, folded into bits bits
+static unsigned int fold_history(unsigned long long history, int length, int bits){
+    unsigned int folded=0;
+    if(length<64){
+        history&=(1ULL<<length)-1;
+    }
+    while(history){
+        folded^=(unsigned int)(history&((1ULL<<bits)-1));
+        history>>=bits;
+    }
+    return folded;
+}
+
+static int tagged_index(const branch_predictor *bp, int t, int pc, unsigned long long history){
+    unsigned int hash=PC_INDEX(pc)^fold_history(history,bp->tagged_history[t],16)^(t<<12);
+    return hash%bp->table_size;
+}
+
+//tags start at 1, so an entry that was never allocated matches nothing
+static unsigned short tagged_tag(const branch_predictor *bp, int t, int pc, unsigned long long history){
+    return ((PC_INDEX(pc)^fold_history(history,bp->tagged_history[t],9)^
+             (fold_history(history,bp->tagged_history[t],8)<<1))&0x1ff)+1;
+}
+
+//longest tagged table whose entry matches, -1 if only the base table does
+static int tage_provider(const branch_predictor *bp, int pc, unsigned long long history, int below){
+    for(int t=below-1;t>=0;t--){
+        const tage_entry *entry=&bp->tagged[t][tagged_index(bp,t,pc,history)];
+        if(entry->tag==tagged_tag(bp,t,pc,history)){
+            return t;
+        }
+    }
+    return -1;
+}
+
+static int base_index(const branch_predictor *bp, int pc, unsigned long long history){
+    if(bp->kind==BP_GSHARE){
+        return (PC_INDEX(pc)^fold_history(history,bp->history_length,16))%bp->table_size;
+    }
+    return PC_INDEX(pc)%bp->table_size;
+}
+
+//direction of a conditional branch, target is its btb target
+static int predict_taken(const branch_predictor *bp, int pc, int target){
+    switch(bp->kind){
+    case BP_STATIC:
+        //backward taken, forward not taken
+        return target<=pc;
+    case BP_TAGE:
+    {
+        int t=tage_provider(bp,pc,bp->history,TAGE_TABLES);
+        if(t!=-1){
+            return bp->tagged[t][tagged_index(bp,t,pc,bp->history)].counter>=0;
+        }
+        return bp->counters[base_index(bp,pc,bp->history)]>=2;
+    }
+    default:
+        return bp->counters[base_index(bp,pc,bp->history)]>=2;
+    }
+}
+
+static const btb_entry *btb_lookup(const branch_predictor *bp, int pc){
+    const btb_entry *entry=&bp->btb[PC_INDEX(pc)%bp->btb_size];
+    if(entry->valid && entry->pc_value==pc){
+        return entry;
+    }
+    return NULL;
+}
+
+static void ras_push(branch_predictor *bp, int return_address){
+    bp->ras_top=(bp->ras_top+1)%bp->ras_size;
+    bp->ras[bp->ras_top]=return_address;
+    if(bp->ras_count<bp->ras_size){
+        bp->ras_count++;
+    }
+}
+
+//returns the most recent return address, -1 when the stack is empty
+static int ras_pop(branch_predictor *bp){
+    int return_address;
+    if(!bp->ras_count){
+        return -1;
+    }
+    return_address=bp->ras[bp->ras_top];
+    bp->ras_top=(bp->ras_top-1+bp->ras_size)%bp->ras_size;
+    bp->ras_count--;
+    return return_address;
+}
+
+//copies the speculative state an instruction is fetched with
+void branch_predictor_snapshot(const branch_predictor *bp, branch_predictor_state *state){
+    state->history=bp->history;
+    state->ras_top=bp->ras_top;
+    state->ras_count=bp->ras_count;
+    state->ras_top_value=bp->ras[bp->ras_top];
+}
+
+//returns the pc to fetch after the instruction at pc, opcode comes from the
+//predecoded code memory so only branches look up the btb
+int branch_predictor_next_pc(branch_predictor *bp, int pc, int opcode){
+    const btb_entry *entry;
+    int taken;
+
+    if(bp->kind==BP_NONE){
+        return pc+4;
+    }
+    if(opcode==OPCODE_RET){
+        int return_address=ras_pop(bp);
+        return return_address==-1?pc+4:return_address;
+    }
+    if(!is_conditional_branch(opcode) && opcode!=OPCODE_JUMP && opcode!=OPCODE_JALR){
+        return pc+4;
+    }
+    entry=btb_lookup(bp,pc);
+    if(opcode==OPCODE_JALR){
+        ras_push(bp,pc+4);
+    }
+    if(!is_conditional_branch(opcode)){
+        return entry?entry->target:pc+4;
+    }
+    //a branch without a target can only fall through, and the history
+    //records the direction that was fetched
+    taken=entry && predict_taken(bp,pc,entry->target);
+    bp->history=(bp->history<<1)|taken;
+    return taken?entry->target:pc+4;
+}
+
+static void counter_update(signed char *counter, int taken, int min, int max){
+    if(taken && *counter<max){
+        (*counter)++;
+    }
+    else if(!taken && *counter>min){
+        (*counter)--;
+    }
+}
+
+//trains the tagged tables with the outcome of a branch predicted with history
+static void tage_update(branch_predictor *bp, int pc, unsigned long long history, int taken){
+    int provider=tage_provider(bp,pc,history,TAGE_TABLES);
+    signed char *base=&bp->counters[base_index(bp,pc,history)];
+    int predicted, alternate;
+
+    if(provider==-1){
+        predicted=*base>=2;
+        counter_update(base,taken,0,3);
+    }
+    else{
+        tage_entry *entry=&bp->tagged[provider][tagged_index(bp,provider,pc,history)];
+        int alt=tage_provider(bp,pc,history,provider);
+        predicted=entry->counter>=0;
+        alternate=alt==-1?*base>=2:bp->tagged[alt][tagged_index(bp,alt,pc,history)].counter>=0;
+        if(predicted!=alternate){
+            if(predicted==taken && entry->useful<3){
+                entry->useful++;
+            }
+            else if(predicted!=taken && entry->useful>0){
+                entry->useful--;
+            }
+        }
+        counter_update(&entry->counter,taken,-4,3);
+    }
+
+    //a mispredict allocates an entry with a longer history, or ages the
+    //entries that are in the way
+    if(predicted!=taken){
+        int allocated=0;
+        for(int t=provider+1;t<TAGE_TABLES;t++){
+            tage_entry *entry=&bp->tagged[t][tagged_index(bp,t,pc,history)];
+            if(entry->useful==0){
+                entry->tag=tagged_tag(bp,t,pc,history);
+                entry->counter=taken?0:-1;
+                allocated=1;
+                break;
+            }
+        }
+        for(int t=provider+1;!allocated && t<TAGE_TABLES;t++){
+            bp->tagged[t][tagged_index(bp,t,pc,history)].useful--;
+        }
+    }
+}
+
+//trains the predictor with a resolved branch, state is the one it was
+//predicted with; returns take their target from the stack, not the btb
+void branch_predictor_update(branch_predictor *bp, int pc, int opcode,
+                             const branch_predictor_state *state, int taken, int target){
+    unsigned long long history=state->history;
+
+    if(bp->kind==BP_NONE){
+        return;
+    }
+    if(taken && opcode!=OPCODE_RET){
+        btb_entry *entry=&bp->btb[PC_INDEX(pc)%bp->btb_size];
+        entry->valid=1;
+        entry->pc_value=pc;
+        entry->target=target;
+    }
+    if(!is_conditional_branch(opcode)){
+        return;
+    }
+    if(bp->kind==BP_TAGE){
+        tage_update(bp,pc,history,taken);
+    }
+    else if(bp->kind!=BP_STATIC){
+        counter_update(&bp->counters[base_index(bp,pc,history)],taken,0,3);
+    }
+}
+
+//rewinds the speculative state to right after a redirecting instruction at
+//pc, state is the one it was fetched with
+void branch_predictor_recover(branch_predictor *bp, int pc, int opcode,
+                              const branch_predictor_state *state, int taken){
+    bp->history=state->history;
+    bp->ras_top=state->ras_top;
+    bp->ras_count=state->ras_count;
+    bp->ras[bp->ras_top]=state->ras_top_value;
+    if(bp->kind==BP_NONE){
+        return;
+    }
+    if(is_conditional_branch(opcode)){
+        bp->history=(bp->history<<1)|(taken!=0);
+    }
+    else if(opcode==OPCODE_JALR){
+        ras_push(bp,pc+4);
+    }
+    else if(opcode==OPCODE_RET){
+        ras_pop(bp);
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * branch_predictor.h
+ * Contains the branch prediction unit consulted by the fetch stage: a branch
+ * target buffer, one of several direction predictors and a return address
+ * stack
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_BRANCH_PREDICTOR_
+#define _XXYZ_BRANCH_PREDICTOR_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+/* Tagged tables of the TAGE predictor, besides its bimodal base table */
+#define TAGE_TABLES 4
+
+////////////////////////BRANCH_PREDICTOR////////////////////////////////////
+
+//last target of a taken branch
+typedef struct btb_entry
+{
+    int valid;
+    int pc_value;
+    int target;
+}btb_entry;
+
+//tagged TAGE entry, counter from -4 (strongly not taken) to 3 (strongly taken)
+typedef struct tage_entry
+{
+    signed char counter;
+    unsigned char useful;
+    unsigned short tag;
+}tage_entry;
+
+//speculative state an instruction was fetched with, a mispredicted branch
+//puts it back before applying its own outcome
+typedef struct branch_predictor_state
+{
+    unsigned long long history;
+    int ras_top;
+    int ras_count;
+    int ras_top_value;              //overwritten by a wrong path call
+}branch_predictor_state;
+
+typedef struct branch_predictor
+{
+    int kind;                       //one of BP_*
+    btb_entry *btb;
+    int btb_size;
+    //2 bit counters of bimodal and gshare, base table of TAGE
+    signed char *counters;
+    int table_size;
+    tage_entry *tagged[TAGE_TABLES];
+    int tagged_history[TAGE_TABLES]; //history bits used by each tagged table
+    int history_length;
+    //global history of conditional branches, newest outcome in bit 0,
+    //updated with the prediction at fetch and repaired on a mispredict
+    unsigned long long history;
+    //return addresses pushed by JALR and popped by RET at fetch, the oldest
+    //one is overwritten when the stack is full
+    int *ras;
+    int ras_size;
+    int ras_top;
+    int ras_count;
+}branch_predictor;
+
+int branch_predictor_init(branch_predictor *bp, int kind, int btb_size,
+                          int table_size, int history_length, int ras_size);
+void branch_predictor_snapshot(const branch_predictor *bp, branch_predictor_state *state);
+void branch_predictor_free(branch_predictor *bp);
+int branch_predictor_next_pc(branch_predictor *bp, int pc, int opcode);
+void branch_predictor_update(branch_predictor *bp, int pc, int opcode,
+                             const branch_predictor_state *state, int taken, int target);
+void branch_predictor_recover(branch_predictor *bp, int pc, int opcode,
+                              const branch_predictor_state *state, int taken);
+int is_conditional_branch(int opcode);
+#endif
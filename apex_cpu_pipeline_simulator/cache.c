@@ -0,0 +1,175 @@
+/*
+ * cache.c
+ * Contains the set associative cache model with LRU, tree PLRU and random
+ * replacement
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "cache.h"
+#include<stdio.h>
+#include<stdlib.h>
+
+//allocates an empty cache of size words, disabled when size is 0. Fails
+//unless it holds at least one set and a PLRU tree has a power of two ways
+int cache_init(cache *c, int size, int assoc, int line_size, int latency, int replacement){
+    c->size=size;
+    c->assoc=assoc;
+    c->line_size=line_size;
+    c->latency=latency;
+    c->replacement=replacement;
+    c->num_sets=0;
+    c->lines=NULL;
+    c->plru=NULL;
+    c->seed=1;
+    c->accesses=0;
+    if(!size){
+        return 0;
+    }
+    if(assoc>MAX_CACHE_ASSOC || (replacement==CACHE_PLRU && (assoc&(assoc-1))) ||
+       size/line_size/assoc<1){
+        return -1;
+    }
+    c->num_sets=size/line_size/assoc;
+    c->lines=calloc((size_t)c->num_sets*assoc,sizeof(cache_line));
+    c->plru=calloc(c->num_sets,sizeof(unsigned long long));
+    if(!c->lines || !c->plru){
+        return -1;
+    }
+    return 0;
+}
+
+void cache_free(cache *c){
+    free(c->lines);
+    free(c->plru);
+    c->lines=NULL;
+    c->plru=NULL;
+}
+
+int cache_enabled(const cache *c){
+    return c->num_sets>0;
+}
+
+//line an address belongs to, the tag of its cache_line
+int cache_line_address(const cache *c, int address){
+    return (unsigned int)address/c->line_size;
+}
+
+static cache_line *cache_set(cache *c, int tag){
+    return &c->lines[(size_t)((unsigned int)tag%c->num_sets)*c->assoc];
+}
+
+//points every node on the path to way away from it
+static void plru_touch(cache *c, int tag, int way){
+    unsigned long long *bits=&c->plru[(unsigned int)tag%c->num_sets];
+    int node=0;
+
+    for(int half=c->assoc/2;half>=1;half/=2){
+        int right=(way&half)!=0;
+
+        if(right){
+            *bits&=~(1ULL<<node);
+        }
+        else{
+            *bits|=1ULL<<node;
+        }
+        node=2*node+1+right;
+    }
+}
+
+//way the PLRU tree of a set points to
+static int plru_victim(const cache *c, int tag){
+    unsigned long long bits=c->plru[(unsigned int)tag%c->num_sets];
+    int node=0, way=0;
+
+    for(int half=c->assoc/2;half>=1;half/=2){
+        int right=(bits>>node)&1;
+
+        way|=right?half:0;
+        node=2*node+1+right;
+    }
+    return way;
+}
+
+static void touch(cache *c, cache_line *set, int way){
+    set[way].last_use=++c->accesses;
+    plru_touch(c, set[way].tag, way);
+}
+
+//line holding address, NULL on a miss, without counting as a use
+cache_line *cache_probe(cache *c, int address){
+    int tag=cache_line_address(c, address);
+    cache_line *set=cache_set(c, tag);
+
+    for(int way=0;way<c->assoc;way++){
+        if(set[way].valid && set[way].tag==tag){
+            return &set[way];
+        }
+    }
+    return NULL;
+}
+
+//line holding address, NULL on a miss. A hit counts as a use for replacement;
+//the line may still be on its way if ready is in the future
+cache_line *cache_lookup(cache *c, int address){
+    cache_line *line=cache_probe(c, address);
+
+    if(line){
+        cache_line *set=cache_set(c, line->tag);
+
+        touch(c, set, (int)(line-set));
+    }
+    return line;
+}
+
+//way a new line of the set replaces, an invalid one if there is any
+static int choose_victim(cache *c, const cache_line *set, int tag){
+    int victim=0;
+
+    for(int way=0;way<c->assoc;way++){
+        if(!set[way].valid){
+            return way;
+        }
+    }
+    switch(c->replacement){
+    case CACHE_PLRU:
+        return plru_victim(c, tag);
+    case CACHE_RANDOM:
+        //xorshift, deterministic so a run can be repeated
+        c->seed^=c->seed<<13;
+        c->seed^=c->seed>>17;
+        c->seed^=c->seed<<5;
+        return c->seed%c->assoc;
+    default:
+        for(int way=1;way<c->assoc;way++){
+            if(set[way].last_use<set[victim].last_use){
+                victim=way;
+            }
+        }
+        return victim;
+    }
+}
+
+//allocates the line of address, arriving at cycle ready, clean. The line it
+//replaces is copied to victim (invalid when the way was free)
+cache_line *cache_fill(cache *c, int address, int ready, cache_line *victim){
+    int tag=cache_line_address(c, address);
+    cache_line *set=cache_set(c, tag);
+    int way=choose_victim(c, set, tag);
+
+    *victim=set[way];
+    set[way].valid=TRUE;
+    set[way].dirty=FALSE;
+    set[way].prefetched=FALSE;
+    set[way].request=-1;
+    set[way].tag=tag;
+    set[way].ready=ready;
+    touch(c, set, way);
+    return &set[way];
+}
+
+//first word of an evicted line
+int cache_victim_address(const cache *c, const cache_line *victim){
+    return victim->tag*c->line_size;
+}
@@ -0,0 +1,66 @@
+/*
+ * cache.h
+ * Contains the set associative cache model of the memory hierarchy, which
+ * only tracks which lines are held and when they arrive; the data itself
+ * stays in the data memory
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_CACHE_
+#define _XXYZ_CACHE_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+////////////////////////CACHE////////////////////////////////////
+
+//one line of a set, tag is the line address (address / line_size)
+typedef struct cache_line
+{
+    int tag;
+    int ready;                      //cycle the line arrives from the next level,
+                                    //counted from the data of request while it is pending
+    int request;                    //DRAM request the line waits for, -1 for none
+    long last_use;                  //access count of its last use, for LRU
+    signed char valid;
+    signed char dirty;              //written since it was filled, write back
+    signed char prefetched;         //filled by a prefetch, no demand access used it yet
+}cache_line;
+
+//event counters of one cache level
+typedef struct cache_stats
+{
+    long accesses;
+    long misses;
+    long miss_cycles;               //cycles the levels below took to serve the misses
+    long writebacks;                //dirty lines evicted to the level below
+}cache_stats;
+
+//num_sets sets of assoc lines, a cache of size 0 is disabled and holds no line
+typedef struct cache
+{
+    int size;                       //words
+    int assoc;
+    int line_size;                  //words
+    int latency;                    //cycles of a hit
+    int replacement;                //one of CACHE_*
+    int num_sets;
+    cache_line *lines;              //assoc lines of set s start at s*assoc
+    unsigned long long *plru;       //PLRU tree of each set, bit set points right
+    unsigned int seed;              //random replacement
+    long accesses;                  //lookups so far, ages the LRU stamps
+}cache;
+
+int cache_init(cache *c, int size, int assoc, int line_size, int latency, int replacement);
+void cache_free(cache *c);
+int cache_enabled(const cache *c);
+int cache_line_address(const cache *c, int address);
+cache_line *cache_lookup(cache *c, int address);
+cache_line *cache_probe(cache *c, int address);
+cache_line *cache_fill(cache *c, int address, int ready, cache_line *victim);
+int cache_victim_address(const cache *c, const cache_line *victim);
+#endif
@@ -0,0 +1,205 @@
+/*
+ * dram.c
+ * Contains the DRAM controller with open or closed page banks and FR-FCFS
+ * scheduling
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "dram.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+//allocates an idle controller with every bank precharged, disabled when
+//channels is 0. Fails unless an open row is the fastest to access
+int dram_init(dram *d, int channels, int banks, int row_size, int row_hit_latency,
+              int row_miss_latency, int row_conflict_latency, int burst_cycles,
+              int queue_size, int close_page){
+    d->channels=channels;
+    d->banks=banks;
+    d->row_size=row_size;
+    d->row_hit_latency=row_hit_latency;
+    d->row_miss_latency=row_miss_latency;
+    d->row_conflict_latency=row_conflict_latency;
+    d->burst_cycles=burst_cycles;
+    d->queue_size=queue_size;
+    d->close_page=close_page;
+    d->bank_state=NULL;
+    d->bus_ready=NULL;
+    d->queue=NULL;
+    d->count=0;
+    d->capacity=0;
+    d->next_id=0;
+    if(!channels){
+        return 0;
+    }
+    if(row_miss_latency<row_hit_latency || row_conflict_latency<row_hit_latency){
+        return -1;
+    }
+    d->bank_state=malloc((size_t)channels*banks*sizeof(dram_bank));
+    d->bus_ready=calloc(channels,sizeof(int));
+    if(!d->bank_state || !d->bus_ready || dram_reserve(d, queue_size)){
+        return -1;
+    }
+    for(int i=0;i<channels*banks;i++){
+        d->bank_state[i].open_row=-1;
+        d->bank_state[i].ready=0;
+    }
+    return 0;
+}
+
+void dram_free(dram *d){
+    free(d->bank_state);
+    free(d->bus_ready);
+    free(d->queue);
+    d->bank_state=NULL;
+    d->bus_ready=NULL;
+    d->queue=NULL;
+}
+
+int dram_enabled(const dram *d){
+    return d->channels>0;
+}
+
+//makes room for count requests in the queue. The caches never wait for a
+//free entry, so the queue grows beyond queue_size when it has to and only
+//the oldest queue_size entries are scheduled
+int dram_reserve(dram *d, int count){
+    dram_request *grown;
+    int capacity=d->capacity?d->capacity:1;
+
+    if(count<=d->capacity){
+        return 0;
+    }
+    while(capacity<count){
+        capacity*=2;
+    }
+    grown=realloc(d->queue, capacity*sizeof(dram_request));
+    if(!grown){
+        return -1;
+    }
+    d->queue=grown;
+    d->capacity=capacity;
+    return 0;
+}
+
+//queues a read or write of the line at address, returns its id or -1 when
+//the queue cannot grow. Consecutive rows go to consecutive channels, then
+//to consecutive banks, so a row holds row_size consecutive words
+int dram_enqueue(dram *d, int address, int words, int write, int clock){
+    unsigned int row=(unsigned int)address/d->row_size;
+    dram_request *request;
+
+    if(dram_reserve(d, d->count+1)){
+        return -1;
+    }
+    request=&d->queue[d->count++];
+    memset(request, 0, sizeof(*request));
+    request->id=d->next_id++;
+    request->address=address;
+    request->words=words;
+    request->write=write;
+    request->arrival=clock;
+    request->channel=row%d->channels;
+    request->bank=row/d->channels%d->banks;
+    request->row=row/d->channels/d->banks;
+    return request->id;
+}
+
+//queued request with id, NULL once it was scheduled
+dram_request *dram_find(dram *d, int id){
+    for(int i=0;i<d->count;i++){
+        if(d->queue[i].id==id){
+            return &d->queue[i];
+        }
+    }
+    return NULL;
+}
+
+static dram_bank *request_bank(const dram *d, const dram_request *request){
+    return &d->bank_state[request->channel*d->banks+request->bank];
+}
+
+//starts a request of channel at clock if one of the oldest queue_size has a
+//free bank, FR-FCFS: the oldest one whose row is open, or else the oldest
+//one. It leaves the queue and is copied to scheduled with the cycle its data
+//has crossed the bus in done; returns FALSE when none could start
+int dram_schedule(dram *d, int channel, int clock, dram_request *scheduled, int *done,
+                  dram_stats *stats){
+    int window=d->count<d->queue_size?d->count:d->queue_size;
+    int chosen=-1;
+    int latency;
+    dram_bank *bank;
+
+    for(int i=0;i<window;i++){
+        const dram_request *request=&d->queue[i];
+
+        bank=request_bank(d, request);
+        if(request->channel!=channel || bank->ready>clock){
+            continue;
+        }
+        if(bank->open_row==request->row){
+            chosen=i;
+            break;
+        }
+        if(chosen==-1){
+            chosen=i;
+        }
+    }
+    if(chosen==-1){
+        return FALSE;
+    }
+    *scheduled=d->queue[chosen];
+    memmove(&d->queue[chosen], &d->queue[chosen+1], (d->count-chosen-1)*sizeof(dram_request));
+    d->count--;
+
+    bank=request_bank(d, scheduled);
+    if(bank->open_row==scheduled->row){
+        latency=d->row_hit_latency;
+        stats->row_hits++;
+    }
+    else if(bank->open_row==-1){
+        latency=d->row_miss_latency;
+        stats->row_misses++;
+    }
+    else{
+        latency=d->row_conflict_latency;
+        stats->row_conflicts++;
+    }
+    //the data follows the data of earlier requests over the bus
+    *done=clock+latency;
+    if(*done<d->bus_ready[channel]+d->burst_cycles){
+        *done=d->bus_ready[channel]+d->burst_cycles;
+    }
+    d->bus_ready[channel]=*done;
+    stats->bus_cycles+=d->burst_cycles;
+    //column commands to an open row follow each other a burst apart, opening
+    //a row keeps the bank busy for the precharge and activate as well
+    bank->ready=clock+latency-d->row_hit_latency+d->burst_cycles;
+    bank->open_row=d->close_page?-1:scheduled->row;
+    if(scheduled->write){
+        stats->writes++;
+    }
+    else{
+        stats->reads++;
+        stats->read_cycles+=*done-scheduled->arrival;
+    }
+    return TRUE;
+}
+
+//first cycle a queued request may be scheduled at, -1 when the queue is empty
+int dram_next_event(const dram *d){
+    int window=d->count<d->queue_size?d->count:d->queue_size;
+    int next=-1;
+
+    for(int i=0;i<window;i++){
+        int ready=request_bank(d, &d->queue[i])->ready;
+
+        if(next==-1 || ready<next){
+            next=ready;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,88 @@
+/*
+ * dram.h
+ * Contains the DRAM controller model behind the caches: channels of banks
+ * with a row buffer each, a request queue scheduled first ready, first come
+ * first served (FR-FCFS) and a data bus per channel that limits bandwidth
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_DRAM_
+#define _XXYZ_DRAM_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+////////////////////////DRAM////////////////////////////////////
+
+//a read or write of one cache line waiting in the controller queue
+typedef struct dram_request
+{
+    int id;                         //increasing, tells requests apart after they leave
+    int address;                    //first word of the line
+    int words;                      //words of the line, the caches it fills
+    int arrival;                    //cycle it entered the queue
+    int channel;
+    int bank;                       //within the channel
+    int row;
+    int misses[NUM_CACHE_LEVELS];   //cache misses waiting for it at each level
+    long miss_cycles[NUM_CACHE_LEVELS]; //their cycles counted from its data,
+                                    //less the cycle each one missed in
+    signed char write;
+}dram_request;
+
+//row buffer of one bank
+typedef struct dram_bank
+{
+    int open_row;                   //-1 when precharged
+    int ready;                      //cycle it takes its next command
+}dram_bank;
+
+//event counters of the controller
+typedef struct dram_stats
+{
+    long reads;
+    long writes;
+    long row_hits;                  //the row was open
+    long row_misses;                //the bank was precharged
+    long row_conflicts;             //another row was open
+    long read_cycles;               //cycles from arrival to data over all reads
+    long bus_cycles;                //cycles the data buses were busy
+}dram_stats;
+
+//a DRAM with 0 channels is disabled, memory then answers in memory_latency
+typedef struct dram
+{
+    int channels;
+    int banks;                      //per channel
+    int row_size;                   //words of a row
+    int row_hit_latency;            //cycles from command to data, row open
+    int row_miss_latency;           //bank precharged, activate first
+    int row_conflict_latency;       //other row open, precharge and activate first
+    int burst_cycles;               //cycles a line takes on the data bus
+    int queue_size;                 //oldest requests the scheduler looks at
+    int close_page;                 //precharge after every access instead of
+                                    //keeping the row open
+    dram_bank *bank_state;          //banks of channel c start at c*banks
+    int *bus_ready;                 //cycle the data bus of each channel is free
+    dram_request *queue;            //oldest first
+    int count;
+    int capacity;
+    int next_id;
+}dram;
+
+int dram_init(dram *d, int channels, int banks, int row_size, int row_hit_latency,
+              int row_miss_latency, int row_conflict_latency, int burst_cycles,
+              int queue_size, int close_page);
+void dram_free(dram *d);
+int dram_enabled(const dram *d);
+int dram_reserve(dram *d, int count);
+int dram_enqueue(dram *d, int address, int words, int write, int clock);
+dram_request *dram_find(dram *d, int id);
+int dram_schedule(dram *d, int channel, int clock, dram_request *scheduled, int *done,
+                  dram_stats *stats);
+int dram_next_event(const dram *d);
+#endif
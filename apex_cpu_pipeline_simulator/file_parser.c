@@ -7,12 +7,12 @@
  * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
  * State University of New York at Binghamton
  */
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "apex_cpu.h"
+#include "apex_isa.h"
 #include "apex_macros.h"
 
 /*
@@ -36,133 +36,36 @@ get_num_from_string(const char *buffer)
     return atoi(str);
 }
 
-/*
- * This function sets the numeric opcode to an instruction based on string value
- *
- * Note : you can edit this function to add new instructions
- */
-static int
-set_opcode_str(const char *opcode_str)
-{
-    if (strcmp(opcode_str, "ADD") == 0)
-    {
-        return OPCODE_ADD;
-    }
-
-    if (strcmp(opcode_str, "SUB") == 0)
-    {
-        return OPCODE_SUB;
-    }
-    if (strcmp(opcode_str, "ADDL") == 0)
-    {
-        return OPCODE_ADDL;
-    }
-
-    if (strcmp(opcode_str, "SUBL") == 0)
-    {
-        return OPCODE_SUBL;
-    }
-
-    if (strcmp(opcode_str, "MUL") == 0)
-    {
-        return OPCODE_MUL;
-    }
-
-    if (strcmp(opcode_str, "DIV") == 0)
-    {
-        return OPCODE_DIV;
-    }
-
-    if (strcmp(opcode_str, "AND") == 0)
-    {
-        return OPCODE_AND;
-    }
-
-    if (strcmp(opcode_str, "OR") == 0)
-    {
-        return OPCODE_OR;
-    }
-
-    if (strcmp(opcode_str, "EXOR") == 0)
-    {
-        return OPCODE_XOR;
-    }
-
-    if (strcmp(opcode_str, "MOVC") == 0)
-    {
-        return OPCODE_MOVC;
-    }
-
-    if (strcmp(opcode_str, "LOAD") == 0)
-    {
-        return OPCODE_LOAD;
-    }
-
-    if (strcmp(opcode_str, "STORE") == 0)
-    {
-        return OPCODE_STORE;
-    }
-
-    if (strcmp(opcode_str, "BZ") == 0)
-    {
-        return OPCODE_BZ;
-    }
-
-    if (strcmp(opcode_str, "BNZ") == 0)
-    {
-        return OPCODE_BNZ;
-    }
-
-    if (strcmp(opcode_str, "HALT") == 0)
-    {
-        return OPCODE_HALT;
-    }
-    //JALR
-    if (strcmp(opcode_str, "JALR") == 0)
-    {
-        return OPCODE_JALR;
-    }
-    //JUMP  
-    if (strcmp(opcode_str, "JUMP") == 0)
-    {
-        return OPCODE_JUMP;
-    }
-    //RET
-    if (strcmp(opcode_str, "RET") == 0)
-    {
-        return OPCODE_RET;
-    }
-    printf("%s\n", opcode_str);
-    assert(0 && "Invalid opcode");
-    return 0;
-}
-
 static void
 split_opcode_from_insn_string(char *buffer, char tokens[2][128])
 {
     int token_num = 0;
+    char *save;
 
-    char *token = strtok(buffer, " ");
+    char *token = strtok_r(buffer, " ", &save);
 
-    while (token != NULL)
+    while (token != NULL && token_num < 2)
     {
         strcpy(tokens[token_num], token);
         token_num++;
-        token = strtok(NULL, " ");
+        token = strtok_r(NULL, " ", &save);
     }
 }
 
 /*
- * This function is related to parsing input file
+ * This function is related to parsing input file, returns -1 if the line
+ * holds an unknown opcode
  *
- * Note : you can edit this function to add new instructions
+ * Note : you can edit this function to add new instructions, along with
+ * their row in the opcode table of apex_isa.c
  */
-static void
+static int
 create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 {
     int i, token_num = 0;
     char tokens[6][128];
     char top_level_tokens[2][128];
+    char *save;
 
     for (i = 0; i < 2; ++i)
     {
@@ -171,19 +74,24 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
 
     split_opcode_from_insn_string(buffer, top_level_tokens);
 
-    char *token = strtok(top_level_tokens[1], ",");
+    char *token = strtok_r(top_level_tokens[1], ",", &save);
 
-    while (token != NULL)
+    while (token != NULL && token_num < 6)
     {
         strcpy(tokens[token_num], token);
         token_num++;
-        token = strtok(NULL, ",");
+        token = strtok_r(NULL, ",", &save);
     }
 
-    strcpy(ins->opcode_str, top_level_tokens[0]);
     //remove trailing and end newline
-    ins->opcode_str[strcspn(ins->opcode_str, "\r\n")] = 0;
-    ins->opcode = set_opcode_str(ins->opcode_str);
+    top_level_tokens[0][strcspn(top_level_tokens[0], "\r\n")] = 0;
+    ins->opcode = APEX_opcode_from_name(top_level_tokens[0]);
+    if (ins->opcode < 0)
+    {
+        fprintf(stderr, "APEX_Error: Invalid opcode %s\n", top_level_tokens[0]);
+        return -1;
+    }
+    APEX_predecode_instruction(ins);
 
     switch (ins->opcode)
     {
@@ -260,6 +168,7 @@ create_APEX_instruction(APEX_Instruction *ins, char *buffer)
         }
     }
     /* Fill in rest of the instructions accordingly */
+    return 0;
 }
 
 /*
@@ -310,7 +219,13 @@ create_code_memory(const char *filename, int *size)
     rewind(fp);
     while ((nread = getline(&line, &len, fp)) != -1)
     {
-        create_APEX_instruction(&code_memory[current_instruction], line);
+        if (create_APEX_instruction(&code_memory[current_instruction], line))
+        {
+            free(code_memory);
+            free(line);
+            fclose(fp);
+            return NULL;
+        }
         current_instruction++;
     }
 
@@ -7,19 +7,117 @@
  * State University of New York at Binghamton
  */
 #include <stdio.h>
+#include <stdlib.h>
 ////////////////////////ISSUE_QUEUE////////////////////////////////////
 #include  "issue_queue.h"
 
+#define BIT(i) (1ULL<<((i)%64))
+#define WORD(i) ((i)/64)
+
+//allocates an empty issue queue with the given number of entries
+int issue_queue_init(issue_queue_buffer *iq, int size){
+    int words=(size+63)/64;
+
+    iq->issue_queue=calloc(size,sizeof(issue_queue_entry));
+    iq->src1_wait=malloc(size*sizeof(int));
+    iq->src2_wait=malloc(size*sizeof(int));
+    //the ready vectors and the select scratch share one block
+    iq->older=calloc((size_t)size*words,sizeof(unsigned long long));
+    iq->allocated=calloc((NUM_ISSUE_FU+2)*words,sizeof(unsigned long long));
+    if(!iq->issue_queue || !iq->src1_wait || !iq->src2_wait || !iq->older || !iq->allocated){
+        issue_queue_free(iq);
+        return -1;
+    }
+    for(int fu=0;fu<NUM_ISSUE_FU;fu++){
+        iq->ready[fu]=iq->allocated+(fu+1)*words;
+    }
+    iq->candidates=iq->allocated+(NUM_ISSUE_FU+1)*words;
+    iq->size=size;
+    iq->words=words;
+    issue_queue_rebuild(iq);
+    return 0;
+}
+
+void issue_queue_free(issue_queue_buffer *iq){
+    free(iq->issue_queue);
+    free(iq->src1_wait);
+    free(iq->src2_wait);
+    free(iq->older);
+    free(iq->allocated);
+    iq->issue_queue=NULL;
+    iq->src1_wait=NULL;
+    iq->src2_wait=NULL;
+    iq->older=NULL;
+    iq->allocated=NULL;
+}
+
+//an entry becomes a select candidate of its FU once both sources are valid
+static void mark_if_ready(issue_queue_buffer *iq, int i){
+    issue_queue_entry *entry=&iq->issue_queue[i];
+
+    if(entry->is_allocated && entry->src1_valid && entry->src2_valid &&
+       entry->FU>=0 && entry->FU<NUM_ISSUE_FU){
+        iq->ready[entry->FU][WORD(i)]|=BIT(i);
+    }
+}
+
+/*
+ * Derives the wakeup tags and the select state from the entries, after they
+ * were written directly: entries are ordered by their age, which counts
+ * dispatches and is compared modulo 2^32
+ */
+void issue_queue_rebuild(issue_queue_buffer *iq){
+    int i,j;
+
+    for(i=0;i<(NUM_ISSUE_FU+1)*iq->words;i++){
+        iq->allocated[i]=0;
+    }
+    iq->next_age=0;
+    iq->count=0;
+    for(i=0;i<iq->size;i++){
+        issue_queue_entry *entry=&iq->issue_queue[i];
+        unsigned long long *row=&iq->older[(size_t)i*iq->words];
+
+        iq->src1_wait[i]=(entry->is_allocated && !entry->src1_valid)?entry->src1_tag:TAG_NONE;
+        iq->src2_wait[i]=(entry->is_allocated && !entry->src2_valid)?entry->src2_tag:TAG_NONE;
+        for(j=0;j<iq->words;j++){
+            row[j]=0;
+        }
+        if(!entry->is_allocated){
+            continue;
+        }
+        iq->allocated[WORD(i)]|=BIT(i);
+        iq->count++;
+        mark_if_ready(iq, i);
+        if((int)((unsigned int)entry->age-iq->next_age)>=0){
+            iq->next_age=(unsigned int)entry->age+1;
+        }
+        for(j=0;j<iq->size;j++){
+            if(j!=i && iq->issue_queue[j].is_allocated &&
+               (int)((unsigned int)iq->issue_queue[j].age-(unsigned int)entry->age)<0){
+                row[WORD(j)]|=BIT(j);
+            }
+        }
+    }
+}
+
+//returns the lowest free entry, -1 if the queue is full
 int issue_buffer_index_available(issue_queue_buffer *iq){
-     for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-        if(iq->issue_queue[i].is_allocated==0){
-            return i;
+    if(iq->count==iq->size){
+        return -1;
+    }
+    for(int w=0;w<iq->words;w++){
+        if(~iq->allocated[w]){
+            return w*64+__builtin_ctzll(~iq->allocated[w]);
         }
     }
     return -1;
 }
 
 void iq_entry_addition(issue_queue_buffer *iq,issue_queue_entry *iq_entry,int iq_index){
+    if(!iq->issue_queue[iq_index].is_allocated){
+        iq->count++;
+    }
     iq->issue_queue[iq_index].is_allocated=1;
     iq->issue_queue[iq_index].dest_tag=iq_entry->dest_tag;
     iq->issue_queue[iq_index].FU=iq_entry->FU;
@@ -33,71 +131,171 @@ void iq_entry_addition(issue_queue_buffer *iq,issue_queue_entry *iq_entry,int iq
     iq->issue_queue[iq_index].lsq_index=iq_entry->lsq_index;
     iq->issue_queue[iq_index].rob_index=iq_entry->rob_index;
     iq->issue_queue[iq_index].pc_value=iq_entry->pc_value;
-    iq->issue_queue[iq_index].counter=iq_entry->counter;
+    iq->issue_queue[iq_index].age=(int)iq->next_age++;
     iq->issue_queue[iq_index].opcode=iq_entry->opcode;
+    iq->issue_queue[iq_index].predicted_pc=iq_entry->predicted_pc;
+    iq->issue_queue[iq_index].bp_state=iq_entry->bp_state;
+    iq->src1_wait[iq_index]=iq_entry->src1_valid?TAG_NONE:iq_entry->src1_tag;
+    iq->src2_wait[iq_index]=iq_entry->src2_valid?TAG_NONE:iq_entry->src2_tag;
+
+    //every entry in the queue is older than the new one and none is younger
+    unsigned long long *row=&iq->older[(size_t)iq_index*iq->words];
+    for(int j=0;j<iq->words;j++){
+        row[j]=iq->allocated[j];
+    }
+    for(int i=0;i<iq->size;i++){
+        iq->older[(size_t)i*iq->words+WORD(iq_index)]&=~BIT(iq_index);
+    }
+    iq->allocated[WORD(iq_index)]|=BIT(iq_index);
+    mark_if_ready(iq, iq_index);
+}
+
+//frees an entry that issued or was flushed
+void issue_queue_remove(issue_queue_buffer *iq, int iq_index){
+    if(iq->issue_queue[iq_index].is_allocated){
+        iq->count--;
+    }
+    iq->issue_queue[iq_index].is_allocated=0;
+    iq->src1_wait[iq_index]=TAG_NONE;
+    iq->src2_wait[iq_index]=TAG_NONE;
+    iq->allocated[WORD(iq_index)]&=~BIT(iq_index);
+    for(int fu=0;fu<NUM_ISSUE_FU;fu++){
+        iq->ready[fu][WORD(iq_index)]&=~BIT(iq_index);
+    }
 }
 
+//delivers the value of physical register tag to every entry waiting for it
+void issue_queue_wakeup(issue_queue_buffer *iq, int tag, int value){
+    for(int base=0;base<iq->size;base+=TAG_MATCH_WIDTH){
+        int count=iq->size-base<TAG_MATCH_WIDTH?iq->size-base:TAG_MATCH_WIDTH;
+        unsigned long long match1=tag_match(&iq->src1_wait[base],count,tag);
+        unsigned long long match2=tag_match(&iq->src2_wait[base],count,tag);
 
-void print_iq_indexes(issue_queue_buffer *iq){
+        while(match1){
+            int i=base+__builtin_ctzll(match1);
+            match1&=match1-1;
+            iq->src1_wait[i]=TAG_NONE;
+            iq->issue_queue[i].src1_value=value;
+            iq->issue_queue[i].src1_valid=1;
+            mark_if_ready(iq, i);
+        }
+        while(match2){
+            int i=base+__builtin_ctzll(match2);
+            match2&=match2-1;
+            iq->src2_wait[i]=TAG_NONE;
+            iq->issue_queue[i].src2_value=value;
+            iq->issue_queue[i].src2_valid=1;
+            mark_if_ready(iq, i);
+        }
+    }
+}
+
+
+void print_iq_indexes(issue_queue_buffer *iq, FILE *fp){
     issue_queue_entry *temp_iq= iq->issue_queue;
-    printf("allocated indexes are:");
-    for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
+    fprintf(fp, "allocated indexes are:");
+    for(int i=0;i<iq->size;i++){
         if(temp_iq[i].is_allocated){
-            printf("%d\t",i);
+            fprintf(fp, "%d\t",i);
         }
     }
-     printf("\n");
+     fprintf(fp, "\n");
 }
 
-void print_iq_entries(issue_queue_buffer *iq){
+void print_iq_entries(issue_queue_buffer *iq, FILE *fp){
     issue_queue_entry *temp_iq= iq->issue_queue;
     int count=0;
-    printf("************************\n");
-    for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
+    fprintf(fp, "************************\n");
+    for(int i=0;i<iq->size;i++){
         if(temp_iq[i].is_allocated){
             count=count+1;;
         }
     }
-    printf("No.of issue queue entries:%d",count);
-    printf("IQ contents are as below \n:");
-    for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
+    fprintf(fp, "No.of issue queue entries:%d",count);
+    fprintf(fp, "IQ contents are as below \n:");
+    for(int i=0;i<iq->size;i++){
         //print content of iq
         if(temp_iq[i].is_allocated){
-            printf("index:%d\t |",i);
-            printf("allocate:%d\t |",temp_iq[i].is_allocated);
-            printf("FU:%d\t |",temp_iq[i].FU);
-            printf("src1_tag:%d\t |",temp_iq[i].src1_tag);
-            printf("src1_value:%d\t |",temp_iq[i].src1_value);
-            printf("src1_valid:%d\t |",temp_iq[i].src1_valid);
-            printf("src2_tag:%d\t |",temp_iq[i].src2_tag);
-            printf("src2_value:%d\t |",temp_iq[i].src2_value);
-            printf("src2_valid:%d\t |",temp_iq[i].src2_valid);
-            printf("immediate_literal:%d\t|",temp_iq[i].immediate_literal);
-            printf("dest_tag:%d\n",temp_iq[i].dest_tag);
-            printf("counter:%d\n",temp_iq[i].counter);
+            fprintf(fp, "index:%d\t |",i);
+            fprintf(fp, "allocate:%d\t |",temp_iq[i].is_allocated);
+            fprintf(fp, "FU:%d\t |",temp_iq[i].FU);
+            fprintf(fp, "src1_tag:%d\t |",temp_iq[i].src1_tag);
+            fprintf(fp, "src1_value:%d\t |",temp_iq[i].src1_value);
+            fprintf(fp, "src1_valid:%d\t |",temp_iq[i].src1_valid);
+            fprintf(fp, "src2_tag:%d\t |",temp_iq[i].src2_tag);
+            fprintf(fp, "src2_value:%d\t |",temp_iq[i].src2_value);
+            fprintf(fp, "src2_valid:%d\t |",temp_iq[i].src2_valid);
+            fprintf(fp, "immediate_literal:%d\t|",temp_iq[i].immediate_literal);
+            fprintf(fp, "dest_tag:%d\n",temp_iq[i].dest_tag);
+            fprintf(fp, "age:%d\n",temp_iq[i].age);
         }
     }
-    printf("************************\n");
+    fprintf(fp, "************************\n");
 }
 
 
 
 
-int get_iq_index_fu(issue_queue_buffer *iq, int fu){
-    int temp_index=-1;
-    int counter=-1;
-    for(int i=0;i<ISSUE_QUEUE_SIZE;i++){
-        if(iq->issue_queue[i].is_allocated ==1 && iq->issue_queue[i].FU==fu){
-            iq->issue_queue[i].counter++;
-            if (iq->issue_queue[i].src2_valid ==1 && iq->issue_queue[i].src1_valid==1)
-            {   
-                if(iq->issue_queue[i].counter>counter){
-                    temp_index=i;
-                    counter=iq->issue_queue[i].counter;
+/*
+ * Selects up to max ready entries of fu, oldest first, into selected and
+ * returns how many. An entry is the oldest candidate when its row of the age
+ * matrix has no candidate in it, so each pick costs one pass over the
+ * candidates. The entries stay allocated until issue_queue_remove.
+ */
+int issue_queue_select(issue_queue_buffer *iq, int fu, int *selected, int max){
+    unsigned long long *candidates=iq->candidates;
+    int count=0;
+
+    for(int w=0;w<iq->words;w++){
+        candidates[w]=iq->ready[fu][w];
+    }
+    while(count<max){
+        int oldest=-1;
+
+        for(int w=0;w<iq->words && oldest<0;w++){
+            unsigned long long bits=candidates[w];
+
+            while(bits){
+                int i=w*64+__builtin_ctzll(bits);
+                const unsigned long long *row=&iq->older[(size_t)i*iq->words];
+                int has_older=0;
+
+                bits&=bits-1;
+                for(int k=0;k<iq->words && !has_older;k++){
+                    has_older=(row[k]&candidates[k])!=0;
+                }
+                if(!has_older){
+                    oldest=i;
+                    break;
                 }
             }
         }
+        if(oldest<0){
+            break;
+        }
+        selected[count++]=oldest;
+        candidates[WORD(oldest)]&=~BIT(oldest);
+    }
+    return count;
+}
+
+//entries of fu with both sources valid
+int issue_queue_ready_count(const issue_queue_buffer *iq, int fu){
+    int count=0;
+    for(int w=0;w<iq->words;w++){
+        count+=__builtin_popcountll(iq->ready[fu][w]);
     }
-    return temp_index;
+    return count;
 }
 
+//true if some entry could issue this cycle
+int issue_queue_has_ready(const issue_queue_buffer *iq){
+    for(int fu=0;fu<NUM_ISSUE_FU;fu++){
+        for(int w=0;w<iq->words;w++){
+            if(iq->ready[fu][w]){
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -12,10 +12,20 @@
 
 
 
+#include <stdio.h>
+
 #ifndef _MACROS_H_
 #include "apex_macros.h"
 #endif
 
+#ifndef _XXYZ_TAG_MATCH_
+#include "tag_match.h"
+#endif
+
+#ifndef _XXYZ_BRANCH_PREDICTOR_
+#include "branch_predictor.h"
+#endif
+
 ////////////////////////ISSUE_QUEUE////////////////////////////////////
 
 typedef struct issue_queue_entry
@@ -32,19 +42,43 @@ typedef struct issue_queue_entry
     int dest_tag;
     int lsq_index;
     int rob_index;
-    int counter;
+    int age; //dispatch sequence number, only read to rebuild the age matrix
     int opcode;
     int pc_value;
+    int predicted_pc; //branches only, checked by the branch unit
+    branch_predictor_state bp_state;
 }issue_queue_entry;
 
 typedef struct issue_queue_buffer
 {
-    issue_queue_entry issue_queue[ISSUE_QUEUE_SIZE];
+    issue_queue_entry *issue_queue;
+    int size;
+    int count; //allocated entries
+    //tag each source is still waiting for, TAG_NONE once valid, kept apart
+    //from the entries so a writeback matches all of them with tag_match
+    int *src1_wait;
+    int *src2_wait;
+    //select state, bit vectors of size bits packed in words 64 bit words:
+    //row i of the age matrix holds the entries dispatched before entry i,
+    //ready holds per FU the allocated entries with both sources valid
+    int words;
+    unsigned long long *older;
+    unsigned long long *allocated;
+    unsigned long long *ready[NUM_ISSUE_FU];
+    unsigned long long *candidates;
+    unsigned int next_age;
 }issue_queue_buffer;
 
+int issue_queue_init(issue_queue_buffer *iq, int size);
+void issue_queue_free(issue_queue_buffer *iq);
 void iq_entry_addition(issue_queue_buffer *iq,issue_queue_entry *iq_entry,int iq_index);
 int issue_buffer_index_available(issue_queue_buffer *iq);
-void print_iq_indexes(issue_queue_buffer *iq);
-void print_iq_entries(issue_queue_buffer *iq);
-int get_iq_index_fu(issue_queue_buffer *iq, int fu);
+void print_iq_indexes(issue_queue_buffer *iq, FILE *fp);
+void print_iq_entries(issue_queue_buffer *iq, FILE *fp);
+int issue_queue_select(issue_queue_buffer *iq, int fu, int *selected, int max);
+int issue_queue_has_ready(const issue_queue_buffer *iq);
+int issue_queue_ready_count(const issue_queue_buffer *iq, int fu);
+void issue_queue_remove(issue_queue_buffer *iq, int iq_index);
+void issue_queue_wakeup(issue_queue_buffer *iq, int tag, int value);
+void issue_queue_rebuild(issue_queue_buffer *iq);
 #endif
@@ -1,5 +1,198 @@
 #include "lsq.h"
 #include  <stdio.h>
+#include  <stdlib.h>
+
+//allocates an empty load store queue with the given number of entries
+int lsq_init(load_store_queue *lsq, int size){
+    lsq->load_store_queue=calloc(size,sizeof(load_store_queue_entry));
+    lsq->store_wait=malloc(size*sizeof(int));
+    if(!lsq->load_store_queue || !lsq->store_wait){
+        lsq_free(lsq);
+        return -1;
+    }
+    lsq->size=size;
+    lsq->head=0;
+    lsq->tail=0;
+    lsq->is_full=0;
+    lsq_rebuild(lsq);
+    return 0;
+}
+
+void lsq_free(load_store_queue *lsq){
+    free(lsq->load_store_queue);
+    free(lsq->store_wait);
+    lsq->load_store_queue=NULL;
+    lsq->store_wait=NULL;
+}
+
+//tag a store entry waits for as its data, TAG_NONE for any other entry
+static int store_wait_tag(const load_store_queue_entry *entry){
+    if(entry->allocate && entry->OPCODE==OPCODE_STORE && !entry->data_ready){
+        return entry->src1_store;
+    }
+    return TAG_NONE;
+}
+
+//derives the wait tags and the occupancy from the entries, after they were
+//written directly
+void lsq_rebuild(load_store_queue *lsq){
+    lsq->count=0;
+    for(int i=0;i<lsq->size;i++){
+        lsq->store_wait[i]=store_wait_tag(&lsq->load_store_queue[i]);
+        lsq->count+=lsq->load_store_queue[i].allocate!=0;
+    }
+}
+
+//frees the oldest entry once it went to memory
+void lsq_remove_head(load_store_queue *lsq){
+    lsq->load_store_queue[lsq->head].allocate=0;
+    lsq->store_wait[lsq->head]=TAG_NONE;
+    lsq->head=(lsq->head+1)%lsq->size;
+    lsq->is_full=0;
+    lsq->count--;
+}
+
+/* Picks the oldest entry that can go to memory, -1 if there is none.
+ *
+ * Both wait until their address is known and translated by clock. A store
+ * goes once its data is known as well and it is the ROB head (rob_head). A
+ * load goes once no older store in the queue holds it back: the youngest
+ * older store to the same address forwards its data (*forward_from, -1 when
+ * the load reads memory) or, while that data is not ready, holds the load
+ * back. An older store of unknown address holds the load back too, unless
+ * the load is speculative and ssp lets it bypass that store. *bypassed is
+ * one of LSQ_*. */
+int lsq_select(const load_store_queue *lsq, int rob_head, const store_set_predictor *ssp,
+               int clock, int *forward_from, int *bypassed){
+    int j=lsq->head;
+
+    for(int n=0;n<lsq->count;n++,j=(j+1)%lsq->size){
+        const load_store_queue_entry *entry=&lsq->load_store_queue[j];
+        int blocked=FALSE;
+
+        if(entry->issued){
+            continue;
+        }
+        if(entry->instruction_type==1){
+            if(entry->address_valid && entry->translated<=clock && entry->data_ready &&
+               entry->rob_index==rob_head){
+                *forward_from=-1;
+                *bypassed=LSQ_IN_ORDER;
+                return j;
+            }
+            continue;
+        }
+        if(!entry->address_valid || entry->translated>clock){
+            continue;
+        }
+        //older stores from the youngest one, up to the first one to the
+        //same address
+        *forward_from=-1;
+        *bypassed=LSQ_IN_ORDER;
+        for(int k=j;k!=lsq->head && !blocked;){
+            const load_store_queue_entry *store;
+
+            k=(k-1+lsq->size)%lsq->size;
+            store=&lsq->load_store_queue[k];
+            if(store->instruction_type!=1 || store->issued){
+                continue;
+            }
+            if(!store->address_valid){
+                if(!entry->speculative || !store_set_may_bypass(ssp, entry->pc_value, store->pc_value)){
+                    blocked=TRUE;
+                }
+                *bypassed=LSQ_SPECULATE;
+            }
+            else if(store->mem_address==entry->mem_address){
+                *forward_from=k;
+                blocked=!store->data_ready;
+                break;
+            }
+            else if(*bypassed==LSQ_IN_ORDER){
+                *bypassed=LSQ_BYPASS;
+            }
+        }
+        if(!blocked){
+            return j;
+        }
+    }
+    return -1;
+}
+
+//true if an older store than lsq_index is in the queue without an address
+int lsq_unknown_store_before(const load_store_queue *lsq, int lsq_index){
+    for(int k=lsq->head;k!=lsq_index;k=(k+1)%lsq->size){
+        const load_store_queue_entry *store=&lsq->load_store_queue[k];
+
+        if(store->instruction_type==1 && !store->issued && !store->address_valid){
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Returns the oldest load younger than the store at store_index that went to
+ * memory before the store's address was known and should have read its
+ * data, -1 if there is none. A younger store to the same address hides the
+ * store from the loads after it. */
+int lsq_find_violation(const load_store_queue *lsq, int store_index){
+    const load_store_queue_entry *store=&lsq->load_store_queue[store_index];
+
+    for(int k=(store_index+1)%lsq->size;k!=lsq->tail;k=(k+1)%lsq->size){
+        const load_store_queue_entry *entry=&lsq->load_store_queue[k];
+
+        if(!entry->address_valid || entry->mem_address!=store->mem_address){
+            continue;
+        }
+        if(entry->instruction_type==1){
+            return -1;
+        }
+        if(entry->issued){
+            return k;
+        }
+    }
+    return -1;
+}
+
+//marks lsq_index as sent to memory and frees the issued entries at the head
+void lsq_issue(load_store_queue *lsq, int lsq_index){
+    lsq->load_store_queue[lsq_index].issued=1;
+    lsq->store_wait[lsq_index]=TAG_NONE;
+    while(lsq->count && lsq->load_store_queue[lsq->head].issued){
+        lsq_remove_head(lsq);
+    }
+}
+
+//frees lsq_index and every younger entry, the new tail is lsq_index
+void lsq_truncate(load_store_queue *lsq, int lsq_index){
+    int j=lsq_index;
+    do{
+        if(lsq->load_store_queue[j].allocate){
+            lsq->load_store_queue[j].allocate=0;
+            lsq->count--;
+        }
+        lsq->store_wait[j]=TAG_NONE;
+        j=(j+1)%lsq->size;
+    }while(j!=lsq->tail);
+    lsq->tail=lsq_index;
+    lsq->is_full=0;
+}
+
+//delivers the value of physical register tag to every store waiting for it
+void lsq_wakeup(load_store_queue *lsq, int tag, int value){
+    for(int base=0;base<lsq->size;base+=TAG_MATCH_WIDTH){
+        int count=lsq->size-base<TAG_MATCH_WIDTH?lsq->size-base:TAG_MATCH_WIDTH;
+        unsigned long long match=tag_match(&lsq->store_wait[base],count,tag);
+
+        while(match){
+            int i=base+__builtin_ctzll(match);
+            match&=match-1;
+            lsq->store_wait[i]=TAG_NONE;
+            lsq->load_store_queue[i].data_ready=1;
+            lsq->load_store_queue[i].value_to_be_stored=value;
+        }
+    }
+}
 
 int lsq_index_available(load_store_queue *lsq){
     if(lsq->is_full)
@@ -22,10 +215,14 @@ int  lsq_entry_addition_to_queue(load_store_queue *lsq, load_store_queue_entry *
     lsq->load_store_queue[lsq->tail].pc_value= lsq_entry->pc_value;  
     lsq->load_store_queue[lsq->tail].OPCODE= lsq_entry->OPCODE;
     lsq->load_store_queue[lsq->tail].rob_index= lsq_entry->rob_index;
+    lsq->load_store_queue[lsq->tail].issued=0;
+    lsq->load_store_queue[lsq->tail].speculative=0;
+    lsq->load_store_queue[lsq->tail].translated=0;
+    lsq->load_store_queue[lsq->tail].bp_state=lsq_entry->bp_state;
+    lsq->store_wait[lsq->tail]=store_wait_tag(&lsq->load_store_queue[lsq->tail]);
+    lsq->count++;
     lsq_index=lsq->tail;
-    printf("LSQ tail= I[%d] ", (lsq->load_store_queue[lsq->tail].pc_value-4000)/4);
-    printf("LSQ head= I[%d] \n", (lsq->load_store_queue[lsq->head].pc_value-4000)/4);
-    lsq->tail = (lsq->tail + 1) % LSQ_SIZE;
+    lsq->tail = (lsq->tail + 1) % lsq->size;
     if(lsq->tail == lsq->head)
         lsq->is_full = 1;
     return lsq_index;
@@ -33,21 +230,21 @@ int  lsq_entry_addition_to_queue(load_store_queue *lsq, load_store_queue_entry *
 }
 
 
-void print_lsq_entries(load_store_queue *lsq){
+void print_lsq_entries(load_store_queue *lsq, FILE *fp){
     int temp = lsq->head;
     int temp_tail = lsq->tail;
     
     while(temp!=temp_tail){
-        printf("mem_address: %d |", lsq->load_store_queue[temp].mem_address);
-        printf("address_valid: %d |", lsq->load_store_queue[temp].address_valid);
-        printf("allocate: %d |", lsq->load_store_queue[temp].allocate);
-        printf("instruction_type: %d |", lsq->load_store_queue[temp].instruction_type);
-        printf("destination_address_for_load: %d |", lsq->load_store_queue[temp].destination_address_for_load);
-        printf("data_ready: %d |", lsq->load_store_queue[temp].data_ready);
-        printf("src1_store: %d |", lsq->load_store_queue[temp].src1_store);
-        printf("rob_index: %d |", lsq->load_store_queue[temp].rob_index);
-        printf("value_to_be_stored: %d \n", lsq->load_store_queue[temp].value_to_be_stored);
-        temp = (temp + 1) % LSQ_SIZE;
+        fprintf(fp, "mem_address: %d |", lsq->load_store_queue[temp].mem_address);
+        fprintf(fp, "address_valid: %d |", lsq->load_store_queue[temp].address_valid);
+        fprintf(fp, "allocate: %d |", lsq->load_store_queue[temp].allocate);
+        fprintf(fp, "instruction_type: %d |", lsq->load_store_queue[temp].instruction_type);
+        fprintf(fp, "destination_address_for_load: %d |", lsq->load_store_queue[temp].destination_address_for_load);
+        fprintf(fp, "data_ready: %d |", lsq->load_store_queue[temp].data_ready);
+        fprintf(fp, "src1_store: %d |", lsq->load_store_queue[temp].src1_store);
+        fprintf(fp, "rob_index: %d |", lsq->load_store_queue[temp].rob_index);
+        fprintf(fp, "value_to_be_stored: %d \n", lsq->load_store_queue[temp].value_to_be_stored);
+        temp = (temp + 1) % lsq->size;
     }
 }
 
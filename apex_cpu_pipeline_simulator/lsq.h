@@ -9,10 +9,33 @@
 #ifndef _XXYZ_LOAD_STORE_QUEUE_
 #define _XXYZ_LOAD_STORE_QUEUE_
 
+#include <stdio.h>
+#include <limits.h>
+
 #ifndef _MACROS_H_
 #include "apex_macros.h"
 #endif
 
+#ifndef _XXYZ_TAG_MATCH_
+#include "tag_match.h"
+#endif
+
+#ifndef _XXYZ_BRANCH_PREDICTOR_
+#include "branch_predictor.h"
+#endif
+
+#ifndef _XXYZ_STORE_SET_
+#include "store_set.h"
+#endif
+
+/* How a load issued relative to the older stores in the queue */
+#define LSQ_IN_ORDER 0      /* no older store left in the queue */
+#define LSQ_BYPASS 1        /* ahead of older stores to other addresses */
+#define LSQ_SPECULATE 2     /* ahead of an older store of unknown address */
+
+/* Translation cycle of an address waiting for a page walk */
+#define TRANSLATION_PENDING INT_MAX
+
 ////////////////////////LOAD_STORE_QUEUE////////////////////////////////////
 
 typedef struct load_store_queue_entry
@@ -29,17 +52,41 @@ typedef struct load_store_queue_entry
     int rob_index;
     int OPCODE;
     int pc_value;
+    int issued;     //went to memory, a load stays until it is the oldest entry
+    //load that holds a rename checkpoint, so it may issue ahead of an older
+    //store of unknown address and replay if that store turns out to alias
+    int speculative;
+    branch_predictor_state bp_state;    //fetch state of a speculative load
+    //cycle the address is translated from, TRANSLATION_PENDING while it
+    //waits for a page walk; it goes to memory no earlier
+    int translated;
 }load_store_queue_entry;
 
 typedef struct load_store_queue
 {
-    load_store_queue_entry load_store_queue[LSQ_SIZE];
+    load_store_queue_entry *load_store_queue;
+    int size;
     int head;
     int tail;
     int is_full;
+    int count; //allocated entries
+    //physical register each store still waits for as its data, TAG_NONE
+    //otherwise, matched by tag_match on every writeback
+    int *store_wait;
 }load_store_queue;
 
+int lsq_init(load_store_queue *lsq, int size);
+void lsq_free(load_store_queue *lsq);
 int lsq_index_available(load_store_queue *lsq);
 int lsq_entry_addition_to_queue(load_store_queue *lsq, load_store_queue_entry * lsq_entry);
-void print_lsq_entries(load_store_queue *lsq);
+void print_lsq_entries(load_store_queue *lsq, FILE *fp);
+void lsq_wakeup(load_store_queue *lsq, int tag, int value);
+void lsq_remove_head(load_store_queue *lsq);
+int lsq_select(const load_store_queue *lsq, int rob_head, const store_set_predictor *ssp,
+               int clock, int *forward_from, int *bypassed);
+void lsq_issue(load_store_queue *lsq, int lsq_index);
+int lsq_unknown_store_before(const load_store_queue *lsq, int lsq_index);
+int lsq_find_violation(const load_store_queue *lsq, int store_index);
+void lsq_truncate(load_store_queue *lsq, int lsq_index);
+void lsq_rebuild(load_store_queue *lsq);
 #endif
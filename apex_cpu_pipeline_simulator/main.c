@@ -7,30 +7,227 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "apex_cpu.h"
+#include "apex_simpoint.h"
+
+/* Converts a -v argument (name or number) into a VERBOSITY_* level */
+static int
+parse_verbosity(const char *arg)
+{
+    if (strcmp(arg, "none") == 0)
+    {
+        return VERBOSITY_NONE;
+    }
+    if (strcmp(arg, "summary") == 0)
+    {
+        return VERBOSITY_SUMMARY;
+    }
+    if (strcmp(arg, "stage") == 0)
+    {
+        return VERBOSITY_STAGE;
+    }
+    if (strcmp(arg, "full") == 0)
+    {
+        return VERBOSITY_FULL;
+    }
+    if (arg[0] >= '0' && arg[0] <= '3' && arg[1] == '\0')
+    {
+        return arg[0] - '0';
+    }
+    return -1;
+}
+
+static void
+print_usage(const char *prog)
+{
+    fprintf(stderr,
+            "APEX_Help: Usage %s [-v none|summary|stage|full] [-c] "
+            "[-f config_file] [-p key=value]... [-l checkpoint] [-s checkpoint] "
+            "[-i interval [-k clusters] [-w warmup] [-b bbv_file]] <input_file>\n"
+            "  -v  verbosity level (default full)\n"
+            "  -c  run continuously instead of single stepping\n"
+            "  -f  load microarchitecture parameters from a key=value file\n"
+            "  -p  set one microarchitecture parameter, e.g. -p rob_size=64\n"
+            "  -l  resume from a checkpoint instead of starting at the first instruction\n"
+            "  -s  save a checkpoint when the simulation ends, e.g. with -p max_cycles=N\n"
+            "  -i  sampled simulation, profile the program in intervals of this many\n"
+            "      instructions and simulate one interval per phase in detail\n"
+            "  -k  maximum number of phases (default %d)\n"
+            "  -w  instructions simulated in detail before each interval (default %d)\n"
+            "  -b  write the basic block vector of every interval to a file\n",
+            prog, DEFAULT_SIMPOINT_MAX_CLUSTERS, DEFAULT_SIMPOINT_WARMUP);
+}
+
+/* Parses a positive count for -i/-k/-w, min is 0 or 1 */
+static long
+parse_count(const char *arg, long min)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+
+    if (*arg == '\0' || *end != '\0' || value < min)
+    {
+        return -1;
+    }
+    return value;
+}
 
 int
-main(int argc, char const *argv[])
+main(int argc, char *argv[])
 {
     APEX_CPU *cpu;
+    APEX_Config config;
+    APEX_SimPoint_Options simpoint;
+    int sampled = FALSE;
+    APEX_Instruction *code_memory;
+    int code_memory_size;
+    const char *load_file = NULL;
+    const char *save_file = NULL;
+    int ret = 0;
+    int verbosity = VERBOSITY_FULL;
+    int single_step = ENABLE_SINGLE_STEP;
+    int opt;
 
     fprintf(stderr, "APEX CPU Pipeline Simulator v%0.1lf\n", VERSION);
 
-    if (argc != 2)
+    APEX_config_init(&config);
+    APEX_simpoint_options_init(&simpoint);
+
+    while ((opt = getopt(argc, argv, "v:cf:p:l:s:i:k:w:b:")) != -1)
     {
-        fprintf(stderr, "APEX_Help: Usage %s <input_file>\n", argv[0]);
+        switch (opt)
+        {
+            case 'v':
+            {
+                verbosity = parse_verbosity(optarg);
+                if (verbosity < 0)
+                {
+                    print_usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            }
+            case 'c':
+            {
+                single_step = FALSE;
+                break;
+            }
+            case 'f':
+            {
+                if (APEX_config_load(&config, optarg))
+                {
+                    exit(1);
+                }
+                break;
+            }
+            case 'p':
+            {
+                if (APEX_config_parse_assignment(&config, optarg))
+                {
+                    exit(1);
+                }
+                break;
+            }
+            case 'l':
+            {
+                load_file = optarg;
+                break;
+            }
+            case 's':
+            {
+                save_file = optarg;
+                break;
+            }
+            case 'i':
+            {
+                simpoint.interval = parse_count(optarg, 1);
+                sampled = TRUE;
+                break;
+            }
+            case 'k':
+            {
+                simpoint.max_clusters = parse_count(optarg, 1);
+                break;
+            }
+            case 'w':
+            {
+                simpoint.warmup = parse_count(optarg, 0);
+                break;
+            }
+            case 'b':
+            {
+                simpoint.bbv_file = optarg;
+                break;
+            }
+            default:
+            {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        }
+    }
+
+    if (optind != argc - 1 || simpoint.interval < 0 || simpoint.max_clusters < 0 ||
+        simpoint.warmup < 0 || (sampled && (load_file || save_file)))
+    {
+        print_usage(argv[0]);
         exit(1);
     }
 
-    cpu = APEX_cpu_init(argv[1]);
+    if (sampled)
+    {
+        code_memory = create_code_memory(argv[optind], &code_memory_size);
+        if (!code_memory)
+        {
+            fprintf(stderr, "APEX_Error: Unable to load %s\n", argv[optind]);
+            exit(1);
+        }
+        if (APEX_simpoint_run(code_memory, code_memory_size, &config, &simpoint, stdout))
+        {
+            ret = 1;
+        }
+        free(code_memory);
+        return ret;
+    }
+
+    if (load_file)
+    {
+        code_memory = create_code_memory(argv[optind], &code_memory_size);
+        cpu = code_memory ? APEX_cpu_load(load_file, code_memory, code_memory_size, &config)
+                          : NULL;
+        if (cpu)
+        {
+            cpu->owns_code_memory = TRUE;
+        }
+        else
+        {
+            free(code_memory);
+        }
+    }
+    else
+    {
+        cpu = APEX_cpu_init(argv[optind], &config);
+    }
     if (!cpu)
     {
         fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
         exit(1);
     }
+    cpu->verbosity = verbosity;
+    if (single_step)
+    {
+        cpu->step_fn = APEX_step_interactive;
+        cpu->step_data = stdin;
+    }
 
     APEX_cpu_run(cpu);
+    if (save_file && APEX_cpu_save(cpu, save_file))
+    {
+        ret = 1;
+    }
     APEX_cpu_stop(cpu);
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
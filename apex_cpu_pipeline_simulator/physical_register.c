@@ -9,17 +9,88 @@
 
 #include "physical_register.h"
 #include<stdio.h>
+#include<stdlib.h>
+
+int physical_register_file_init(physical_register_file *prf, int size){
+    prf->physical_register=calloc(size+1,sizeof(physical_register_content));
+    if(!prf->physical_register){
+        return -1;
+    }
+    prf->size=size;
+    return 0;
+}
+
+void physical_register_file_free(physical_register_file *prf){
+    free(prf->physical_register);
+    prf->physical_register=NULL;
+}
+
+#define BIT(i) (1ULL<<((i)%64))
+#define WORD(i) ((i)/64)
+
+//every physical register starts out free
+int free_physical_registers_init(free_physical_registers_queue *fpq, int size){
+    fpq->free_physical_registers=calloc(size,sizeof(int));
+    fpq->is_free=calloc((size+63)/64,sizeof(unsigned long long));
+    if(!fpq->free_physical_registers || !fpq->is_free){
+        free_physical_registers_free(fpq);
+        return -1;
+    }
+    for (int i=0;i<size;i++){
+        fpq->free_physical_registers[i]=i;
+    }
+    fpq->size=size;
+    fpq->head=0;
+    fpq->tail=size-1;
+    fpq->is_empty=0;
+    fpq->pops=0;
+    free_physical_registers_rebuild(fpq);
+    return 0;
+}
+
+void free_physical_registers_free(free_physical_registers_queue *fpq){
+    free(fpq->free_physical_registers);
+    free(fpq->is_free);
+    fpq->free_physical_registers=NULL;
+    fpq->is_free=NULL;
+}
+
+//derives the count and the free bits from the queue, after it was written directly
+void free_physical_registers_rebuild(free_physical_registers_queue *fpq){
+    for(int i=0;i<(fpq->size+63)/64;i++){
+        fpq->is_free[i]=0;
+    }
+    fpq->count=0;
+    if(fpq->is_empty){
+        return;
+    }
+    for(int i=fpq->head;;i=(i+1)%fpq->size){
+        int reg=fpq->free_physical_registers[i];
+        fpq->is_free[WORD(reg)]|=BIT(reg);
+        fpq->count++;
+        if(i==fpq->tail){
+            break;
+        }
+    }
+}
+
+int is_physical_register_free(const free_physical_registers_queue *fpq, int physical_register){
+    if(physical_register<0 || physical_register>=fpq->size){
+        return 0;
+    }
+    return (fpq->is_free[WORD(physical_register)]&BIT(physical_register))!=0;
+}
 
 
-void print_prf_q(free_physical_registers_queue *a){
+void print_prf_q(free_physical_registers_queue *a, FILE *fp){
     int temp_head=a->head;
     int temp_tail=a->tail;
     int i=temp_head;
     while(i!=temp_tail){
-        printf("%d\t,",a->free_physical_registers[i]);
-        i=(i+1)%PHYSICAL_REGISTERS_SIZE;
+        fprintf(fp, "%d\t,",a->free_physical_registers[i]);
+        i=(i+1)%a->size;
     }
-    printf("%d\n",a->free_physical_registers[temp_tail]);
+    fprintf(fp, "%d\n",a->free_physical_registers[temp_tail]);
 }
 
 int pop_free_physical_registers(free_physical_registers_queue *fpq){
@@ -27,17 +98,38 @@ int pop_free_physical_registers(free_physical_registers_queue *fpq){
         return -1;
     }
     else{
-        int temp= fpq->head;
+        int temp= fpq->free_physical_registers[fpq->head];
         if (fpq->head==fpq->tail)
             fpq->is_empty=1;
-        fpq->head=(fpq->head+1)%PHYSICAL_REGISTERS_SIZE;
+        fpq->is_free[WORD(temp)]&=~BIT(temp);
+        fpq->count--;
+        fpq->pops++;
+        fpq->head=(fpq->head+1)%fpq->size;
         return temp;
     }
 }
 
 void push_free_physical_registers(free_physical_registers_queue *fpq, int physical_register){
-    printf("PRF reg Freed: P[%d]\n",physical_register);
-    fpq->tail=(fpq->tail+1)%PHYSICAL_REGISTERS_SIZE;
+    fpq->tail=(fpq->tail+1)%fpq->size;
     fpq->free_physical_registers[fpq->tail]=physical_register;
+    fpq->is_empty=0;
+    fpq->is_free[WORD(physical_register)]|=BIT(physical_register);
+    fpq->count++;
     return;
-}
\ No newline at end of file
+}
+
+//hands back every register popped since head and pops were read from the
+//queue: they are still stored from head on, in the order they were popped
+void restore_free_physical_registers(free_physical_registers_queue *fpq, int head, unsigned int pops){
+    unsigned int popped=fpq->pops-pops;
+    for(unsigned int i=0;i<popped;i++){
+        int reg=fpq->free_physical_registers[(head+i)%fpq->size];
+        fpq->is_free[WORD(reg)]|=BIT(reg);
+    }
+    if(popped){
+        fpq->is_empty=0;
+    }
+    fpq->count+=popped;
+    fpq->head=head;
+    fpq->pops=pops;
+}
@@ -9,6 +9,8 @@
 #ifndef _XXYZ_PHY_REG_
 #define _XXYZ_PHY_REG_
 
+#include <stdio.h>
+
 #ifndef _MACROS_H_
 #include "apex_macros.h"
 #endif
@@ -26,15 +28,21 @@ typedef struct physical_register_content
 
 typedef struct  physical_register_file
 {
-    physical_register_content physical_register[PHYSICAL_REGISTERS_SIZE+1];
+    //one extra entry past size is reserved for the CCR written by CMP
+    physical_register_content *physical_register;
+    int size;
 }physical_register_file;
 
 typedef struct free_physical_registers_queue
 {
     int head;
     int tail;
-    int free_physical_registers[PHYSICAL_REGISTERS_SIZE];
+    int *free_physical_registers;
+    int size;
     int is_empty;
+    int count; //registers in the queue
+    unsigned long long *is_free; //bit per physical register, set while queued
+    unsigned int pops; //registers handed out so far, wraps around
 }free_physical_registers_queue;
 
 
@@ -50,7 +58,14 @@ typedef struct rename_table_mapping
     rename_table_content rename_table[ARCHITECTURAL_REGISTERS_SIZE+1];
 }rename_table_mapping;
 
-void print_prf_q(free_physical_registers_queue *a);
+int physical_register_file_init(physical_register_file *prf, int size);
+void physical_register_file_free(physical_register_file *prf);
+int free_physical_registers_init(free_physical_registers_queue *fpq, int size);
+void free_physical_registers_free(free_physical_registers_queue *fpq);
+void print_prf_q(free_physical_registers_queue *a, FILE *fp);
 int pop_free_physical_registers(free_physical_registers_queue *fpq);
 void push_free_physical_registers(free_physical_registers_queue *fpq, int physical_register);
+void restore_free_physical_registers(free_physical_registers_queue *fpq, int head, unsigned int pops);
+int is_physical_register_free(const free_physical_registers_queue *fpq, int physical_register);
+void free_physical_registers_rebuild(free_physical_registers_queue *fpq);
 #endif
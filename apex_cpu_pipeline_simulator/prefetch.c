@@ -0,0 +1,97 @@
+/*
+ * prefetch.c
+ * Contains the next line and the pc indexed stride prefetchers
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "prefetch.h"
+#include<stdio.h>
+#include<stdlib.h>
+
+//instruction index of a pc, the low bits the table is indexed with
+#define PC_INDEX(pc) ((unsigned int)((pc)-4000)/4)
+
+//confidence a stride needs before it is prefetched, once repeated, and the
+//most it builds up
+#define STRIDE_CONFIDENT 1
+#define STRIDE_MAX_CONFIDENCE 3
+
+//allocates an empty table, no load has a stride yet
+int prefetcher_init(prefetcher *pf, int kind, int degree, int distance, int table_size){
+    pf->kind=kind;
+    pf->degree=degree;
+    pf->distance=distance;
+    pf->table_size=table_size;
+    pf->table=calloc(table_size,sizeof(stride_entry));
+    if(!pf->table){
+        return -1;
+    }
+    return 0;
+}
+
+void prefetcher_free(prefetcher *pf){
+    free(pf->table);
+    pf->table=NULL;
+}
+
+//learns the stride of the load at pc, returning it once it repeated often
+//enough to be trusted and 0 otherwise
+static int stride_train(prefetcher *pf, int pc, int address){
+    stride_entry *entry=&pf->table[PC_INDEX(pc)%pf->table_size];
+    int stride=address-entry->last_address;
+
+    if(entry->pc!=pc){
+        entry->pc=pc;
+        entry->stride=0;
+        entry->confidence=0;
+    }
+    else if(stride==entry->stride){
+        if(entry->confidence<STRIDE_MAX_CONFIDENCE){
+            entry->confidence++;
+        }
+    }
+    else{
+        entry->stride=stride;
+        entry->confidence=0;
+    }
+    entry->last_address=address;
+    return entry->confidence>=STRIDE_CONFIDENT?entry->stride:0;
+}
+
+//trains the prefetcher on a load of address at pc and writes the addresses
+//to prefetch to addresses, at most degree of them and each in a line of its
+//own other than the line of the load. Returns how many there are
+int prefetcher_train(prefetcher *pf, int pc, int address, int line_size, int *addresses){
+    int line=(unsigned int)address/line_size;
+    int last_line=line;
+    int count=0;
+    int stride;
+
+    switch(pf->kind){
+    case PF_NEXT_LINE:
+        for(int i=0;i<pf->degree;i++){
+            addresses[count++]=(line+pf->distance+i)*line_size;
+        }
+        return count;
+    case PF_STRIDE:
+        stride=stride_train(pf, pc, address);
+        if(!stride){
+            return 0;
+        }
+        for(int i=0;i<pf->degree;i++){
+            int target=address+stride*(pf->distance+i);
+            int target_line=(unsigned int)target/line_size;
+
+            //strides shorter than a line land in the same line again
+            if(target_line!=last_line){
+                addresses[count++]=target;
+                last_line=target_line;
+            }
+        }
+        return count;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ * prefetch.h
+ * Contains the data prefetchers, which watch the loads going to memory and
+ * pick the lines to bring into the data cache before they are asked for
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_PREFETCH_
+#define _XXYZ_PREFETCH_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+////////////////////////PREFETCHER////////////////////////////////////
+
+//reference prediction table entry of the stride prefetcher, indexed and
+//tagged by the pc of a load
+typedef struct stride_entry
+{
+    int pc;                         //load owning the entry, 0 when empty
+    int last_address;
+    int stride;                     //words between its last two addresses
+    int confidence;                 //times in a row the stride repeated
+}stride_entry;
+
+typedef struct prefetcher
+{
+    int kind;                       //one of PF_*
+    int degree;                     //prefetches per trained load
+    int distance;                   //lines (next line) or strides ahead
+    stride_entry *table;
+    int table_size;
+}prefetcher;
+
+int prefetcher_init(prefetcher *pf, int kind, int degree, int distance, int table_size);
+void prefetcher_free(prefetcher *pf);
+int prefetcher_train(prefetcher *pf, int pc, int address, int line_size, int *addresses);
+#endif
@@ -0,0 +1,128 @@
+/*
+ * rename_checkpoint.c
+ * Contains the rename checkpoints taken by every unresolved branch
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "rename_checkpoint.h"
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+//allocates size free checkpoints, the number of branches that may be in flight
+int rename_checkpoint_init(rename_checkpoint_stack *stack, int size){
+    stack->checkpoints=calloc(size,sizeof(rename_checkpoint));
+    if(!stack->checkpoints){
+        return -1;
+    }
+    stack->size=size;
+    stack->count=0;
+    return 0;
+}
+
+void rename_checkpoint_free(rename_checkpoint_stack *stack){
+    free(stack->checkpoints);
+    stack->checkpoints=NULL;
+}
+
+//returns a free checkpoint or -1 when every one belongs to an unresolved branch
+int rename_checkpoint_available(const rename_checkpoint_stack *stack){
+    if(stack->count>=stack->size){
+        return -1;
+    }
+    for(int i=0;i<stack->size;i++){
+        if(!stack->checkpoints[i].is_allocated){
+            return i;
+        }
+    }
+    return -1;
+}
+
+//saves the rename table, mri and free list head for the branch at rob_index
+int rename_checkpoint_take(rename_checkpoint_stack *stack, int rob_index,
+                           const rename_table_mapping *rnt, const int *mri,
+                           const free_physical_registers_queue *fpq){
+    int index=rename_checkpoint_available(stack);
+    if(index==-1){
+        return -1;
+    }
+    rename_checkpoint *ckpt=&stack->checkpoints[index];
+    ckpt->is_allocated=1;
+    ckpt->rob_index=rob_index;
+    ckpt->rnt=*rnt;
+    memcpy(ckpt->mri,mri,sizeof(ckpt->mri));
+    ckpt->free_head=fpq->head;
+    ckpt->free_pops=fpq->pops;
+    stack->count++;
+    return index;
+}
+
+//returns the checkpoint of the branch at rob_index, -1 if it has none
+int rename_checkpoint_find(const rename_checkpoint_stack *stack, int rob_index){
+    for(int i=0;i<stack->size;i++){
+        if(stack->checkpoints[i].is_allocated && stack->checkpoints[i].rob_index==rob_index){
+            return i;
+        }
+    }
+    return -1;
+}
+
+//puts rename back in the state it had when the checkpoint was taken: every
+//register allocated since returns to the free list, and a mapping to a
+//register that committed in the meantime reads the architectural register
+void rename_checkpoint_restore(const rename_checkpoint_stack *stack, int index,
+                               rename_table_mapping *rnt, int *mri,
+                               free_physical_registers_queue *fpq){
+    const rename_checkpoint *ckpt=&stack->checkpoints[index];
+
+    restore_free_physical_registers(fpq,ckpt->free_head,ckpt->free_pops);
+    *rnt=ckpt->rnt;
+    memcpy(mri,ckpt->mri,sizeof(ckpt->mri));
+    for(int i=0;i<ARCHITECTURAL_REGISTERS_SIZE+1;i++){
+        if(rnt->rename_table[i].register_source &&
+           is_physical_register_free(fpq,rnt->rename_table[i].mapped_to_physical_register)){
+            rnt->rename_table[i].register_source=0;
+        }
+    }
+}
+
+//frees the checkpoint of a branch that resolved
+void rename_checkpoint_release(rename_checkpoint_stack *stack, int index){
+    if(stack->checkpoints[index].is_allocated){
+        stack->checkpoints[index].is_allocated=0;
+        stack->count--;
+    }
+}
+
+//frees the checkpoints of branches squashed by a flush, which are the
+//squashed rob entries starting at first
+void rename_checkpoint_squash(rename_checkpoint_stack *stack, int first, int squashed, int rob_size){
+    for(int i=0;i<stack->size;i++){
+        if(stack->checkpoints[i].is_allocated &&
+           (stack->checkpoints[i].rob_index-first+rob_size)%rob_size<squashed){
+            rename_checkpoint_release(stack,i);
+        }
+    }
+}
+
+//a committed physical register is freed, so a checkpoint still mapping the
+//register to it must read the architectural register file after a restore
+void rename_checkpoint_commit(rename_checkpoint_stack *stack, int register_address, int physical_register){
+    for(int i=0;i<stack->size;i++){
+        rename_table_content *entry=&stack->checkpoints[i].rnt.rename_table[register_address];
+        if(stack->checkpoints[i].is_allocated && entry->register_source &&
+           entry->mapped_to_physical_register==physical_register){
+            entry->register_source=0;
+        }
+    }
+}
+
+//derives the count from the checkpoints, after they were written directly
+void rename_checkpoint_rebuild(rename_checkpoint_stack *stack){
+    stack->count=0;
+    for(int i=0;i<stack->size;i++){
+        stack->count+=stack->checkpoints[i].is_allocated==1;
+    }
+}
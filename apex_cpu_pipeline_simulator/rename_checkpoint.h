@@ -0,0 +1,56 @@
+/*
+ * rename_checkpoint.h
+ * Contains the rename checkpoints taken by every unresolved branch, a
+ * mispredicted branch restores the rename state from its own checkpoint
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_RENAME_CHECKPOINT_
+#define _XXYZ_RENAME_CHECKPOINT_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+#ifndef _XXYZ_PHY_REG_
+#include "physical_register.h"
+#endif
+
+////////////////////////RENAME_CHECKPOINT////////////////////////////////////
+
+//rename state right after a branch dispatched
+typedef struct rename_checkpoint
+{
+    int is_allocated;
+    int rob_index;                  //branch that owns the checkpoint
+    rename_table_mapping rnt;
+    int mri[ARCHITECTURAL_REGISTERS_SIZE+1];
+    int free_head;                  //free list head and pops when it was taken
+    unsigned int free_pops;
+}rename_checkpoint;
+
+typedef struct rename_checkpoint_stack
+{
+    rename_checkpoint *checkpoints;
+    int size;
+    int count;                      //checkpoints held by unresolved branches
+}rename_checkpoint_stack;
+
+int rename_checkpoint_init(rename_checkpoint_stack *stack, int size);
+void rename_checkpoint_free(rename_checkpoint_stack *stack);
+int rename_checkpoint_available(const rename_checkpoint_stack *stack);
+int rename_checkpoint_take(rename_checkpoint_stack *stack, int rob_index,
+                           const rename_table_mapping *rnt, const int *mri,
+                           const free_physical_registers_queue *fpq);
+int rename_checkpoint_find(const rename_checkpoint_stack *stack, int rob_index);
+void rename_checkpoint_restore(const rename_checkpoint_stack *stack, int index,
+                               rename_table_mapping *rnt, int *mri,
+                               free_physical_registers_queue *fpq);
+void rename_checkpoint_release(rename_checkpoint_stack *stack, int index);
+void rename_checkpoint_squash(rename_checkpoint_stack *stack, int first, int squashed, int rob_size);
+void rename_checkpoint_commit(rename_checkpoint_stack *stack, int register_address, int physical_register);
+void rename_checkpoint_rebuild(rename_checkpoint_stack *stack);
+#endif
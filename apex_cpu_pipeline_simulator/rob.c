@@ -8,7 +8,26 @@
  */
  #include"rob.h"
  #include<stdio.h>
+ #include<stdlib.h>
 
+//allocates an empty reorder buffer with the given number of entries
+int reorder_buffer_init(reorder_buffer *rob, int size){
+    rob->reorder_buffer_queue=calloc(size,sizeof(reorder_buffer_entry));
+    if(!rob->reorder_buffer_queue){
+        return -1;
+    }
+    rob->size=size;
+    rob->head=0;
+    rob->tail=0;
+    rob->is_full=0;
+    rob->count=0;
+    return 0;
+}
+
+void reorder_buffer_free(reorder_buffer *rob){
+    free(rob->reorder_buffer_queue);
+    rob->reorder_buffer_queue=NULL;
+}
 
 
 int reorder_buffer_available(reorder_buffer *rob){
@@ -21,17 +40,31 @@ int reorder_buffer_available(reorder_buffer *rob){
 }
 
 int is_rob_full(reorder_buffer *rob){
-    int count=0;
-    for(int i=0;i<ROB_SIZE;i++){
-        if(rob->reorder_buffer_queue[i].is_allocated==1){
-            count++;
-        }
+    return rob->count>=rob->size-1;
+}
+
+//frees an entry that committed or was flushed
+void reorder_buffer_release(reorder_buffer *rob, int rob_index){
+    if(rob->reorder_buffer_queue[rob_index].is_allocated){
+        rob->reorder_buffer_queue[rob_index].is_allocated=0;
+        rob->count--;
+        rob->is_full=0;
     }
-    if(count<ROB_SIZE-1){
-        return 0;
+}
+
+//frees the flushed entries from rob_index up to the tail, rob_index becomes the tail
+void reorder_buffer_truncate(reorder_buffer *rob, int rob_index){
+    for(int i=rob_index;i!=rob->tail;i=(i+1)%rob->size){
+        reorder_buffer_release(rob,i);
     }
-    else{
-        return 1;
+    rob->tail=rob_index;
+}
+
+//derives the occupancy from the entries, after they were written directly
+void reorder_buffer_rebuild(reorder_buffer *rob){
+    rob->count=0;
+    for(int i=0;i<rob->size;i++){
+        rob->count+=rob->reorder_buffer_queue[i].is_allocated==1;
     }
 }
 
@@ -48,30 +81,33 @@ int reorder_buffer_entry_addition_to_queue(reorder_buffer *rob, reorder_buffer_e
     rob->reorder_buffer_queue[rob->tail].insn_type=rob_entry->insn_type;
     rob->reorder_buffer_queue[rob->tail].pc_value=rob_entry->pc_value;
     rob->reorder_buffer_queue[rob->tail].opcode=rob_entry->opcode;
+    rob->reorder_buffer_queue[rob->tail].mispredicted=rob_entry->mispredicted;
+    if(!rob->reorder_buffer_queue[rob->tail].is_allocated){
+        rob->count++;
+    }
     rob->reorder_buffer_queue[rob->tail].is_allocated=1;
     int rob_index=rob->tail;
-    printf("ROB entry created for I[%d] \n", (rob->reorder_buffer_queue[rob->tail].pc_value-4000)/4);
 
-    rob->tail=(rob->tail+1)%ROB_SIZE;
+    rob->tail=(rob->tail+1)%rob->size;
     rob->is_full=is_rob_full(rob);
     return rob_index;
 }
 
 
-void print_rob_entries(reorder_buffer *rob){
+void print_rob_entries(reorder_buffer *rob, FILE *fp){
     int i;
     i=rob->head;
-    printf("ROB contents are as below:\n");
-    printf("***********************\n");
+    fprintf(fp, "ROB contents are as below:\n");
+    fprintf(fp, "***********************\n");
     while(i!=rob->tail){
-        printf("pc_value: %d |",rob->reorder_buffer_queue[i].pc_value);
-        printf("destination_address: %d |",rob->reorder_buffer_queue[i].destination_address);
-        printf("result_value: %d |",rob->reorder_buffer_queue[i].result_value);
-        printf("store_value: %d |",rob->reorder_buffer_queue[i].store_value);
-        printf("store_value_valid: %d\n",rob->reorder_buffer_queue[i].store_value_valid);
-        printf("status_bit: %d|",rob->reorder_buffer_queue[i].status_bit);
-        printf("insn_type: %d\n",rob->reorder_buffer_queue[i].insn_type);
-        i=(i+1)%ROB_SIZE;
+        fprintf(fp, "pc_value: %d |",rob->reorder_buffer_queue[i].pc_value);
+        fprintf(fp, "destination_address: %d |",rob->reorder_buffer_queue[i].destination_address);
+        fprintf(fp, "result_value: %d |",rob->reorder_buffer_queue[i].result_value);
+        fprintf(fp, "store_value: %d |",rob->reorder_buffer_queue[i].store_value);
+        fprintf(fp, "store_value_valid: %d\n",rob->reorder_buffer_queue[i].store_value_valid);
+        fprintf(fp, "status_bit: %d|",rob->reorder_buffer_queue[i].status_bit);
+        fprintf(fp, "insn_type: %d\n",rob->reorder_buffer_queue[i].insn_type);
+        i=(i+1)%rob->size;
     }
-    printf("***********************\n");
+    fprintf(fp, "***********************\n");
 }
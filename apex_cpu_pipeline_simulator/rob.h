@@ -10,12 +10,20 @@
 #define _XXYZ_REORDER_BUFFER_
 
 
+#include <stdio.h>
+
 #ifndef _MACROS_H_
 #include "apex_macros.h"
 #endif
 
 ////////////////////////REORDER_BUFFER////////////////////////////////////
 
+//fault of a reorder buffer entry
+#define FAULT_NONE 0
+#define FAULT_ADDRESS 1      //load or store outside the data memory
+#define FAULT_DIV_ZERO 2     //DIV by zero
+#define FAULT_DIV_OVERFLOW 3 //DIV of INT_MIN by -1
+
 typedef struct reorder_buffer_entry
 {
 int is_allocated;
@@ -37,18 +45,32 @@ int opcode;
 //branch 3
 int positive_flag;
 int zero_flag;
+//branch that redirected fetch when it resolved
+int mispredicted;
+//why the instruction stops the simulation once it reaches commit, FAULT_NONE
+//for most. A load or store whose address (fault_address) lies outside the
+//data memory skips the access, a faulting DIV leaves 0 in its destination
+int fault;
+int fault_address;
 }reorder_buffer_entry;
 
 typedef struct reorder_buffer
 {
-    reorder_buffer_entry reorder_buffer_queue[ROB_SIZE];
+    reorder_buffer_entry *reorder_buffer_queue;
+    int size;
     int head;
     int tail;
     int is_full;
+    int count; //allocated entries, one slot always stays empty
 }reorder_buffer;
 
+int reorder_buffer_init(reorder_buffer *rob, int size);
+void reorder_buffer_free(reorder_buffer *rob);
 int reorder_buffer_available(reorder_buffer *rob);
 int reorder_buffer_entry_addition_to_queue(reorder_buffer *rob, reorder_buffer_entry * rob_entry);
-void print_rob_entries(reorder_buffer *rob);
+void print_rob_entries(reorder_buffer *rob, FILE *fp);
 int is_rob_full(reorder_buffer *rob);
+void reorder_buffer_release(reorder_buffer *rob, int rob_index);
+void reorder_buffer_truncate(reorder_buffer *rob, int rob_index);
+void reorder_buffer_rebuild(reorder_buffer *rob);
 #endif
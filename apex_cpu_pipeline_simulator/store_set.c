@@ -0,0 +1,76 @@
+/*
+ * store_set.c
+ * Contains the store set memory dependence predictor
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "store_set.h"
+#include<stdio.h>
+#include<stdlib.h>
+
+//instruction index of a pc, the low bits the table is indexed with
+#define PC_INDEX(pc) ((unsigned int)((pc)-4000)/4)
+
+//allocates an empty table, no load belongs to a store set yet
+int store_set_init(store_set_predictor *ssp, int kind, int ssit_size){
+    ssp->kind=kind;
+    ssp->ssit_size=ssit_size;
+    ssp->next_set=0;
+    ssp->ssit=malloc(ssit_size*sizeof(int));
+    if(!ssp->ssit){
+        return -1;
+    }
+    for(int i=0;i<ssit_size;i++){
+        ssp->ssit[i]=-1;
+    }
+    return 0;
+}
+
+void store_set_free(store_set_predictor *ssp){
+    free(ssp->ssit);
+    ssp->ssit=NULL;
+}
+
+//true if the load at load_pc may issue ahead of the older store at store_pc
+//whose address is not known yet
+int store_set_may_bypass(const store_set_predictor *ssp, int load_pc, int store_pc){
+    int load_set;
+
+    switch(ssp->kind){
+    case MD_STORE_SETS:
+        load_set=ssp->ssit[PC_INDEX(load_pc)%ssp->ssit_size];
+        return load_set==-1 || load_set!=ssp->ssit[PC_INDEX(store_pc)%ssp->ssit_size];
+    case MD_SPECULATE:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+//puts a load that read memory before the older store at store_pc wrote it
+//in one store set with that store: a new set when neither has one, the set
+//of the one that has, the smaller set when both have
+void store_set_violation(store_set_predictor *ssp, int load_pc, int store_pc){
+    int *load_set=&ssp->ssit[PC_INDEX(load_pc)%ssp->ssit_size];
+    int *store_set=&ssp->ssit[PC_INDEX(store_pc)%ssp->ssit_size];
+
+    if(ssp->kind!=MD_STORE_SETS){
+        return;
+    }
+    if(*load_set==-1 && *store_set==-1){
+        *load_set=ssp->next_set;
+        *store_set=ssp->next_set;
+        ssp->next_set=(ssp->next_set+1)%ssp->ssit_size;
+    }
+    else if(*load_set==-1){
+        *load_set=*store_set;
+    }
+    else if(*store_set==-1 || *load_set<*store_set){
+        *store_set=*load_set;
+    }
+    else{
+        *load_set=*store_set;
+    }
+}
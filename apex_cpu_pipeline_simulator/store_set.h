@@ -0,0 +1,35 @@
+/*
+ * store_set.h
+ * Contains the store set memory dependence predictor, which decides whether
+ * a load may issue ahead of an older store whose address is not known yet
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_STORE_SET_
+#define _XXYZ_STORE_SET_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+////////////////////////STORE_SET_PREDICTOR////////////////////////////////////
+
+//store set identifier table indexed by the pc of a load or store: the loads
+//and stores that once conflicted share a store set, and a load waits for
+//every older store of its set
+typedef struct store_set_predictor
+{
+    int kind;                       //one of MD_*
+    int *ssit;                      //store set of each entry, -1 for none
+    int ssit_size;
+    int next_set;                   //next store set handed out, wraps around
+}store_set_predictor;
+
+int store_set_init(store_set_predictor *ssp, int kind, int ssit_size);
+void store_set_free(store_set_predictor *ssp);
+int store_set_may_bypass(const store_set_predictor *ssp, int load_pc, int store_pc);
+void store_set_violation(store_set_predictor *ssp, int load_pc, int store_pc);
+#endif
@@ -0,0 +1,460 @@
+/*
+ * sweep.c
+ * Design space sweep driver: runs one program on every point of a grid of
+ * microarchitecture parameters, one APEX_CPU per point, spread over a pool
+ * of host threads, and collects the results into a CSV file
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+
+/* Cycle limit applied unless the sweep sets max_cycles itself, so that a
+ * design point which deadlocks cannot stall the whole sweep */
+#define SWEEP_DEFAULT_MAX_CYCLES 10000000
+
+#define SWEEP_MAX_AXES 16
+#define SWEEP_MAX_VALUES 256
+
+/* One swept parameter with the list of values it takes */
+typedef struct sweep_axis
+{
+    char key[64];
+    char values[SWEEP_MAX_VALUES][32];
+    int num_values;
+} sweep_axis;
+
+/* Outcome of simulating one design point */
+typedef struct sweep_result
+{
+    int valid;
+    int status;
+    int cycles;
+    int instructions;
+    APEX_Stats stats;
+} sweep_result;
+
+/* State shared by the worker threads, everything but next_point is read only */
+typedef struct sweep_state
+{
+    const APEX_Instruction *code_memory;
+    int code_memory_size;
+    const char *checkpoint;         /* Every point resumes from here if set */
+    APEX_Config base_config;
+    sweep_axis axes[SWEEP_MAX_AXES];
+    int num_axes;
+    long num_points;
+    sweep_result *results;
+
+    pthread_mutex_t lock;
+    long next_point;
+} sweep_state;
+
+static void
+print_usage(const char *prog)
+{
+    fprintf(stderr,
+            "APEX_Help: Usage %s [-j threads] [-o output.csv] [-f config_file] "
+            "[-p key=value]... [-l checkpoint] <input_file> key=v1,v2,... "
+            "[key=v1,v2,...]...\n"
+            "  -j  number of host threads (default: all online cores)\n"
+            "  -o  CSV output file (default: stdout)\n"
+            "  -f  base microarchitecture parameters for every point\n"
+            "  -p  set one base parameter, e.g. -p max_cycles=100000\n"
+            "  -l  resume every point from a checkpoint saved by apex_sim -s\n",
+            prog);
+}
+
+/* Parses "key=v1,v2,..." into one axis of the grid */
+static int
+parse_axis(sweep_axis *axis, const char *arg)
+{
+    char buffer[4096];
+    char *values;
+    char *token;
+    char *save;
+
+    if (strlen(arg) >= sizeof(buffer))
+    {
+        return -1;
+    }
+    strcpy(buffer, arg);
+
+    values = strchr(buffer, '=');
+    if (!values || values == buffer || values - buffer >= (long)sizeof(axis->key))
+    {
+        return -1;
+    }
+    *values++ = '\0';
+    strcpy(axis->key, buffer);
+
+    axis->num_values = 0;
+    for (token = strtok_r(values, ",", &save); token; token = strtok_r(NULL, ",", &save))
+    {
+        if (axis->num_values == SWEEP_MAX_VALUES || strlen(token) >= sizeof(axis->values[0]))
+        {
+            return -1;
+        }
+        strcpy(axis->values[axis->num_values++], token);
+    }
+    return axis->num_values ? 0 : -1;
+}
+
+/* Returns the value index of the given axis for a point of the grid, the
+ * last axis varies fastest */
+static int
+point_value_index(const sweep_state *sweep, long point, int axis)
+{
+    int i;
+
+    for (i = sweep->num_axes - 1; i > axis; --i)
+    {
+        point /= sweep->axes[i].num_values;
+    }
+    return (int)(point % sweep->axes[axis].num_values);
+}
+
+/* Builds the configuration of one point, returns 0 on success */
+static int
+point_config(const sweep_state *sweep, long point, APEX_Config *config)
+{
+    int i;
+
+    *config = sweep->base_config;
+    for (i = 0; i < sweep->num_axes; ++i)
+    {
+        const sweep_axis *axis = &sweep->axes[i];
+
+        if (APEX_config_set(config, axis->key, axis->values[point_value_index(sweep, point, i)]))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Simulates one design point to completion */
+static void
+run_point(const sweep_state *sweep, long point, sweep_result *result)
+{
+    APEX_Config config;
+    APEX_CPU *cpu;
+
+    memset(result, 0, sizeof(*result));
+
+    /* Every value was validated before the workers started */
+    point_config(sweep, point, &config);
+
+    if (sweep->checkpoint)
+    {
+        cpu = APEX_cpu_load(sweep->checkpoint, sweep->code_memory, sweep->code_memory_size,
+                            &config);
+    }
+    else
+    {
+        cpu = APEX_cpu_create(sweep->code_memory, sweep->code_memory_size, &config);
+    }
+    if (!cpu)
+    {
+        return;
+    }
+    cpu->verbosity = VERBOSITY_NONE;
+
+    APEX_cpu_run(cpu);
+
+    result->valid = TRUE;
+    result->status = cpu->status;
+    result->cycles = cpu->clock;
+    result->instructions = cpu->insn_completed;
+    result->stats = cpu->stats;
+
+    APEX_cpu_stop(cpu);
+}
+
+static void *
+sweep_worker(void *arg)
+{
+    sweep_state *sweep = arg;
+    long point;
+
+    while (TRUE)
+    {
+        pthread_mutex_lock(&sweep->lock);
+        point = sweep->next_point++;
+        pthread_mutex_unlock(&sweep->lock);
+
+        if (point >= sweep->num_points)
+        {
+            break;
+        }
+        run_point(sweep, point, &sweep->results[point]);
+    }
+    return NULL;
+}
+
+/* Fraction of the accesses of a cache level that hit */
+static double
+hit_rate(const cache_stats *stats)
+{
+    return stats->accesses ? (double)(stats->accesses - stats->misses) / stats->accesses : 0.0;
+}
+
+/* Average cycles the levels below took to serve a miss */
+static double
+miss_latency(const cache_stats *stats)
+{
+    return stats->misses ? (double)stats->miss_cycles / stats->misses : 0.0;
+}
+
+/* Fraction of the misses of the cache the prefetcher fills, the L1D or
+ * without one the L2, that prefetches turned into hits */
+static double
+prefetch_coverage(const APEX_Stats *stats)
+{
+    const cache_stats *level = &stats->caches[stats->caches[CACHE_L1D].accesses ? CACHE_L1D : CACHE_L2];
+
+    return stats->prefetch_hits + level->misses ?
+           (double)stats->prefetch_hits / (stats->prefetch_hits + level->misses) : 0.0;
+}
+
+static void
+write_csv(const sweep_state *sweep, FILE *fp)
+{
+    long point;
+    int i;
+
+    for (i = 0; i < sweep->num_axes; ++i)
+    {
+        fprintf(fp, "%s,", sweep->axes[i].key);
+    }
+    fprintf(fp, "status,cycles,instructions,ipc,rob_full_stalls,iq_full_stalls,"
+                "lsq_full_stalls,prf_empty_stalls,checkpoint_full_stalls,fu_busy_stalls,operand_stalls,"
+                "mshr_full_stalls,avg_rob,avg_iq,avg_lsq,avg_mshr,"
+                "loads,load_forward_rate,load_bypass_rate,speculated_loads,"
+                "memory_violations,violation_squashed,"
+                "l1d_accesses,l1d_hit_rate,l1d_miss_latency,l2_accesses,l2_hit_rate,l2_miss_latency,"
+                "l1i_accesses,l1i_hit_rate,l1i_miss_latency,icache_stall_cycles,avg_fetch_buffer,"
+                "prefetches,prefetch_accuracy,prefetch_coverage,prefetch_timely,"
+                "dram_row_hit_rate,dram_read_latency,dram_bus_utilization,"
+                "dtlb_miss_rate,l2_tlb_miss_rate,page_walks,avg_walk_cycles,"
+                "branches,branch_mispredicts,mpki\n");
+
+    for (point = 0; point < sweep->num_points; ++point)
+    {
+        const sweep_result *result = &sweep->results[point];
+        const dram_stats *dram = &result->stats.dram;
+        APEX_Config config;
+
+        point_config(sweep, point, &config);
+        for (i = 0; i < sweep->num_axes; ++i)
+        {
+            fprintf(fp, "%s,", sweep->axes[i].values[point_value_index(sweep, point, i)]);
+        }
+        fprintf(fp, "%s,%d,%d,%.4f,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.2f,%.2f,%.2f,%.2f,%ld,%.4f,%.4f,%ld,%ld,%ld,%ld,%.4f,%.2f,%ld,%.4f,%.2f,%ld,%.4f,%.2f,%ld,%.2f,%ld,%.4f,%.4f,%.4f,%.4f,%.2f,%.4f,%.4f,%.4f,%ld,%.2f,%ld,%ld,%.2f\n",
+                !result->valid ? "error" :
+                result->status == APEX_STATUS_HALTED ? "halted" :
+                result->status == APEX_STATUS_FAULT ? "fault" : "cycle_limit",
+                result->cycles, result->instructions,
+                result->cycles ? (double)result->instructions / result->cycles : 0.0,
+                result->stats.rob_full_stalls, result->stats.iq_full_stalls,
+                result->stats.lsq_full_stalls, result->stats.prf_empty_stalls,
+                result->stats.checkpoint_full_stalls,
+                result->stats.fu_busy_stalls, result->stats.operand_stalls,
+                result->stats.mshr_full_stalls,
+                result->cycles ? (double)result->stats.rob_occupancy / result->cycles : 0.0,
+                result->cycles ? (double)result->stats.iq_occupancy / result->cycles : 0.0,
+                result->cycles ? (double)result->stats.lsq_occupancy / result->cycles : 0.0,
+                result->cycles ? (double)result->stats.mshr_occupancy / result->cycles : 0.0,
+                result->stats.loads,
+                result->stats.loads ? (double)result->stats.loads_forwarded / result->stats.loads : 0.0,
+                result->stats.loads ? (double)result->stats.loads_bypassed / result->stats.loads : 0.0,
+                result->stats.loads_speculated, result->stats.memory_violations,
+                result->stats.violation_squashed,
+                result->stats.caches[CACHE_L1D].accesses, hit_rate(&result->stats.caches[CACHE_L1D]),
+                miss_latency(&result->stats.caches[CACHE_L1D]),
+                result->stats.caches[CACHE_L2].accesses, hit_rate(&result->stats.caches[CACHE_L2]),
+                miss_latency(&result->stats.caches[CACHE_L2]),
+                result->stats.caches[CACHE_L1I].accesses, hit_rate(&result->stats.caches[CACHE_L1I]),
+                miss_latency(&result->stats.caches[CACHE_L1I]),
+                result->stats.icache_stall_cycles,
+                result->cycles ? (double)result->stats.fetch_buffer_occupancy / result->cycles : 0.0,
+                result->stats.prefetches,
+                result->stats.prefetches ? (double)result->stats.prefetch_hits / result->stats.prefetches : 0.0,
+                prefetch_coverage(&result->stats),
+                result->stats.prefetch_hits ?
+                    (double)(result->stats.prefetch_hits - result->stats.prefetch_late) / result->stats.prefetch_hits : 0.0,
+                dram->reads + dram->writes ? (double)dram->row_hits / (dram->reads + dram->writes) : 0.0,
+                dram->reads ? (double)dram->read_cycles / dram->reads : 0.0,
+                result->cycles && config.dram_channels ?
+                    (double)dram->bus_cycles / ((double)result->cycles * config.dram_channels) : 0.0,
+                result->stats.dtlb_accesses ?
+                    (double)result->stats.dtlb_misses / result->stats.dtlb_accesses : 0.0,
+                result->stats.l2_tlb_accesses ?
+                    (double)result->stats.l2_tlb_misses / result->stats.l2_tlb_accesses : 0.0,
+                result->stats.page_walks,
+                result->stats.page_walks ? (double)result->stats.walk_cycles / result->stats.page_walks : 0.0,
+                result->stats.branches, result->stats.branch_mispredicts,
+                result->instructions ? 1000.0 * result->stats.branch_mispredicts / result->instructions : 0.0);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    sweep_state sweep;
+    APEX_Instruction *code_memory;
+    APEX_Config check;
+    pthread_t *threads;
+    const char *output = NULL;
+    FILE *fp = stdout;
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long point;
+    long i;
+    int opt;
+
+    memset(&sweep, 0, sizeof(sweep));
+    APEX_config_init(&sweep.base_config);
+    sweep.base_config.max_cycles = SWEEP_DEFAULT_MAX_CYCLES;
+
+    while ((opt = getopt(argc, argv, "j:o:f:p:l:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j':
+            {
+                num_threads = atol(optarg);
+                break;
+            }
+            case 'o':
+            {
+                output = optarg;
+                break;
+            }
+            case 'f':
+            {
+                if (APEX_config_load(&sweep.base_config, optarg))
+                {
+                    exit(1);
+                }
+                break;
+            }
+            case 'p':
+            {
+                if (APEX_config_parse_assignment(&sweep.base_config, optarg))
+                {
+                    exit(1);
+                }
+                break;
+            }
+            case 'l':
+            {
+                sweep.checkpoint = optarg;
+                break;
+            }
+            default:
+            {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        }
+    }
+
+    if (optind >= argc || num_threads < 1)
+    {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    sweep.num_points = 1;
+    for (i = optind + 1; i < argc; ++i)
+    {
+        if (sweep.num_axes == SWEEP_MAX_AXES || parse_axis(&sweep.axes[sweep.num_axes], argv[i]))
+        {
+            fprintf(stderr, "APEX_Error: Invalid sweep axis %s\n", argv[i]);
+            exit(1);
+        }
+        sweep.num_points *= sweep.axes[sweep.num_axes].num_values;
+        sweep.num_axes++;
+    }
+
+    /* Reject bad keys or values before any simulation starts */
+    for (point = 0; point < sweep.num_points; ++point)
+    {
+        if (point_config(&sweep, point, &check) || APEX_config_check(&check))
+        {
+            exit(1);
+        }
+    }
+
+    code_memory = create_code_memory(argv[optind], &sweep.code_memory_size);
+    if (!code_memory)
+    {
+        fprintf(stderr, "APEX_Error: Unable to load %s\n", argv[optind]);
+        exit(1);
+    }
+    sweep.code_memory = code_memory;
+
+    sweep.results = calloc(sweep.num_points, sizeof(sweep_result));
+    if (num_threads > sweep.num_points)
+    {
+        num_threads = sweep.num_points;
+    }
+    threads = calloc(num_threads, sizeof(pthread_t));
+    if (!sweep.results || !threads)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory\n");
+        exit(1);
+    }
+
+    fprintf(stderr, "APEX_Sweep: %ld design points on %ld threads\n", sweep.num_points,
+            num_threads);
+
+    /* Workers take points from a shared counter, the threads that did start
+     * run the points of any that failed to */
+    pthread_mutex_init(&sweep.lock, NULL);
+    for (i = 0; i < num_threads; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, sweep_worker, &sweep))
+        {
+            fprintf(stderr, "APEX_Error: Unable to start sweep thread %ld of %ld\n",
+                    i + 1, num_threads);
+            break;
+        }
+    }
+    if (i == 0)
+    {
+        exit(1);
+    }
+    num_threads = i;
+    for (i = 0; i < num_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&sweep.lock);
+
+    if (output)
+    {
+        fp = fopen(output, "w");
+        if (!fp)
+        {
+            fprintf(stderr, "APEX_Error: Unable to open %s\n", output);
+            exit(1);
+        }
+    }
+    write_csv(&sweep, fp);
+    if (output)
+    {
+        fclose(fp);
+    }
+
+    free(threads);
+    free(sweep.results);
+    free(code_memory);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * tag_match.c
+ * Compares a broadcast physical register tag against the wait tags of up to
+ * TAG_MATCH_WIDTH queue entries at once. Builds with AVX2 (-mavx2 or
+ * -march=native) compare eight tags per instruction, x86-64 builds four,
+ * anything else falls back to a scalar loop.
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "tag_match.h"
+
+/*
+ * Returns a mask with bit i set when tags[i] equals tag, for the first
+ * count entries of tags, count at most TAG_MATCH_WIDTH
+ */
+unsigned long long
+tag_match(const int *tags, int count, int tag)
+{
+    unsigned long long mask = 0;
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i broadcast = _mm256_set1_epi32(tag);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)&tags[i]),
+                                           broadcast);
+        mask |= (unsigned long long)_mm256_movemask_ps(_mm256_castsi256_ps(equal)) << i;
+    }
+#elif defined(__SSE2__)
+    __m128i broadcast = _mm_set1_epi32(tag);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&tags[i]), broadcast);
+        mask |= (unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(equal)) << i;
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        if (tags[i] == tag)
+        {
+            mask |= 1ULL << i;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,18 @@
+/*
+ * tag_match.h
+ * Contains the tag broadcast used to wake up issue queue and lsq entries
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_TAG_MATCH_
+#define _XXYZ_TAG_MATCH_
+
+/* Wait tag of an entry that is not waiting for any physical register */
+#define TAG_NONE -1
+
+/* Entries matched by one call of tag_match */
+#define TAG_MATCH_WIDTH 64
+
+unsigned long long tag_match(const int *tags, int count, int tag);
+#endif
@@ -0,0 +1,110 @@
+/*
+ * tlb.c
+ * Contains the TLBs and page walkers translating the data addresses
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+
+#include "tlb.h"
+#include<stdio.h>
+#include<stdlib.h>
+
+//words of a 4 KB page and of a 2 MB huge page
+#define PAGE_4K_WORDS 1024
+#define PAGE_2M_WORDS (1 << 19)
+
+//the page table is a radix tree of 512 entries per node, each entry two
+//words (8 bytes). The entries of a level are laid out by the page bits they
+//translate, from a word above every data word and below the code the caches
+//hold, so walks of neighbouring pages share cache lines
+#define PAGE_TABLE_BITS 9
+#define PTE_WORDS 2
+#define PAGE_TABLE_ADDRESS (1 << 29)
+#define PAGE_TABLE_LEVEL_WORDS (1 << 22)
+
+//allocates empty TLBs and idle walkers, translation is left out when
+//dtlb_entries is 0. A walk of a huge page ends a level early, at the entry
+//that maps all of it
+int mmu_init(mmu *m, int dtlb_entries, int dtlb_assoc, int l2_tlb_entries, int l2_tlb_assoc,
+             int l2_tlb_latency, int page_size, int page_table_levels, int walkers){
+    m->page_size=page_size==PAGE_2M?PAGE_2M_WORDS:PAGE_4K_WORDS;
+    m->levels=page_size==PAGE_2M?page_table_levels-1:page_table_levels;
+    m->walks=NULL;
+    m->num_walkers=0;
+    if(cache_init(&m->dtlb, dtlb_entries*m->page_size, dtlb_assoc, m->page_size, 0, CACHE_LRU) ||
+       cache_init(&m->l2_tlb, dtlb_entries?l2_tlb_entries*m->page_size:0, l2_tlb_assoc,
+                  m->page_size, l2_tlb_latency, CACHE_LRU)){
+        return -1;
+    }
+    if(!dtlb_entries){
+        return 0;
+    }
+    m->walks=malloc(walkers*sizeof(page_walk));
+    if(!m->walks){
+        return -1;
+    }
+    m->num_walkers=walkers;
+    for(int i=0;i<walkers;i++){
+        m->walks[i].page=-1;
+        m->walks[i].request=-1;
+    }
+    return 0;
+}
+
+void mmu_free(mmu *m){
+    cache_free(&m->dtlb);
+    cache_free(&m->l2_tlb);
+    free(m->walks);
+    m->walks=NULL;
+}
+
+int mmu_enabled(const mmu *m){
+    return cache_enabled(&m->dtlb);
+}
+
+//virtual page of a data address. Only addresses inside the data memory are
+//translated, the pipeline faults the others before they reach the TLB, so
+//pages, and page*page_size, are never negative
+int mmu_page(const mmu *m, int address){
+    return address/m->page_size;
+}
+
+//address of the page table entry a walk of page reads at level, the leaf
+//entries at the last level are indexed by the page itself and every level
+//above by 9 bits less of it. Huge page numbers are 9 bits shorter than those
+//of 4 KB pages, so from the root down both read the same entries
+int mmu_entry_address(const mmu *m, int page, int level){
+    int index=page>>(PAGE_TABLE_BITS*(m->levels-1-level));
+
+    return PAGE_TABLE_ADDRESS+level*PAGE_TABLE_LEVEL_WORDS+index*PTE_WORDS;
+}
+
+//walker walking page, NULL if none is
+page_walk *mmu_find_walk(mmu *m, int page){
+    for(int i=0;i<m->num_walkers;i++){
+        if(m->walks[i].page==page){
+            return &m->walks[i];
+        }
+    }
+    return NULL;
+}
+
+page_walk *mmu_idle_walker(mmu *m){
+    return mmu_find_walk(m, -1);
+}
+
+//first cycle a walker reads its next entry or finishes, -1 when none will
+//before a DRAM request is scheduled
+int mmu_next_event(const mmu *m){
+    int next=-1;
+
+    for(int i=0;i<m->num_walkers;i++){
+        const page_walk *walk=&m->walks[i];
+
+        if(walk->page!=-1 && walk->request==-1 && (next==-1 || walk->ready<next)){
+            next=walk->ready;
+        }
+    }
+    return next;
+}
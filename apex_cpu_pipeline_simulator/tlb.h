@@ -0,0 +1,57 @@
+/*
+ * tlb.h
+ * Contains the address translation of the data accesses: a data TLB, an
+ * optional second level TLB behind it and the page walkers that read the
+ * page table through the caches when both miss
+ *
+ * Author:
+ * State University of New York at Binghamton
+ */
+#ifndef _XXYZ_TLB_
+#define _XXYZ_TLB_
+
+#include <stdio.h>
+
+#ifndef _MACROS_H_
+#include "apex_macros.h"
+#endif
+
+#ifndef _XXYZ_CACHE_
+#include "cache.h"
+#endif
+
+////////////////////////TLB////////////////////////////////////
+
+//a walk reading the page table entries of a page one level after the other
+typedef struct page_walk
+{
+    int page;                       //virtual page walked, -1 when the walker is idle
+    int level;                      //page table level read next, 0 the root
+    int ready;                      //cycle the entry read last arrives, counted
+                                    //from the data of request while it is pending
+    int request;                    //DRAM request of that entry, -1 for none
+    int start;                      //cycle the walk started
+}page_walk;
+
+//translation is left out without a DTLB. The TLBs are caches whose lines
+//are pages, the line address of a word being its virtual page number
+typedef struct mmu
+{
+    cache dtlb;
+    cache l2_tlb;                   //disabled when left out
+    int page_size;                  //words
+    int levels;                     //page table entries a walk reads
+    page_walk *walks;
+    int num_walkers;
+}mmu;
+
+int mmu_init(mmu *m, int dtlb_entries, int dtlb_assoc, int l2_tlb_entries, int l2_tlb_assoc,
+             int l2_tlb_latency, int page_size, int page_table_levels, int walkers);
+void mmu_free(mmu *m);
+int mmu_enabled(const mmu *m);
+int mmu_page(const mmu *m, int address);
+int mmu_entry_address(const mmu *m, int page, int level);
+page_walk *mmu_find_walk(mmu *m, int page);
+page_walk *mmu_idle_walker(mmu *m);
+int mmu_next_event(const mmu *m);
+#endif